@@ -0,0 +1,155 @@
+/**********
+ * 合成图的扩展性测试
+ *   按不同节点数生成图，在不同 bthread_concurrency 下并发执行，输出每一组的吞吐和延迟
+ *   xmake run graph_benchmark --node_counts=50,100,200,500 --concurrency_list=4,8,16
+ *   --emit=graph.json 只生成图
+ * **********
+*/
+#include "bench/synthetic_graph.h"
+#include "bench/load_generator.h"
+
+#include <gflags/gflags.h>
+#include <fstream>
+#include <sstream>
+
+DEFINE_string(node_counts, "50,100,200,500", "图的节点数，逗号分隔。宽度 = 节点数 / depth");
+DEFINE_int32(depth, 10, "图的层数");
+DEFINE_int32(fan_in, 2, "最大入度，1 到 3");
+DEFINE_int32(fan_out, 2, "最大出度，1 到 3");
+DEFINE_bool(random, true, "入度出度随机，false 时都取最大值");
+DEFINE_int64(stream_length, 8, "源节点产生的元素个数");
+DEFINE_int64(payload_bytes, 64, "元素大小");
+DEFINE_int64(cpu_us, 0, "每个元素的计算时间");
+DEFINE_int64(latency_us, 0, "每个节点开始时的等待时间");
+DEFINE_string(cost_distribution, "fixed", "每个节点的 cpu_us、latency_us 怎么抽取: fixed / uniform / exponential，平均值是上面两个参数");
+DEFINE_uint64(seed, 1, "随机种子");
+DEFINE_string(concurrency_list, "4,8,16", "bthread_concurrency，逗号分隔。只能递增");
+DEFINE_int64(requests, 1000, "每一组执行的请求数");
+DEFINE_int64(parallel, 64, "同时执行的请求数");
+DEFINE_string(emit, "", "只把第一个节点数的图写到这个文件");
+
+using namespace stream_dag;
+
+static std::vector<int64_t> parse_list(const std::string& text) {
+    std::vector<int64_t> result;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            result.push_back(std::stoll(item));
+        }
+    }
+    return result;
+}
+
+static GraphShape make_shape(int64_t nodes) {
+    GraphShape shape;
+    shape.depth = FLAGS_depth;
+    shape.width = std::max<int64_t>(1, nodes / FLAGS_depth);
+    shape.fan_in = FLAGS_fan_in;
+    shape.fan_out = FLAGS_fan_out;
+    shape.random = FLAGS_random;
+    shape.stream_length = FLAGS_stream_length;
+    shape.payload_bytes = FLAGS_payload_bytes;
+    shape.cpu_us = FLAGS_cpu_us;
+    shape.latency_us = FLAGS_latency_us;
+    shape.cost_distribution = FLAGS_cost_distribution;
+    shape.seed = FLAGS_seed;
+    return shape;
+}
+
+// 闭环并发执行 requests 个请求，同时最多 parallel 个
+static json run_graph(StreamGraph& g) {
+    std::atomic<int64_t> next{0}, errors{0};
+    bthread::Mutex mutex;
+    std::vector<int64_t> latency;
+    latency.reserve(FLAGS_requests);
+
+    int64_t start = butil::gettimeofday_us();
+    std::vector<BThread> workers;
+    for (int64_t i = 0; i < FLAGS_parallel; i++) {
+        workers.emplace_back([&] {
+            while (next.fetch_add(1) < FLAGS_requests) {
+                int64_t begin = butil::gettimeofday_us();
+                BaseContext ctx;
+                BthreadExecutor executor;
+                if (!executor.run(g, ctx).ok()) {
+                    errors.fetch_add(1);
+                }
+                int64_t cost = butil::gettimeofday_us() - begin;
+                std::unique_lock<bthread::Mutex> lock_(mutex);
+                latency.push_back(cost);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    int64_t elapsed = butil::gettimeofday_us() - start;
+
+    json result;
+    result["requests"] = FLAGS_requests;
+    result["errors"] = errors.load();
+    result["elapsed_ms"] = elapsed / 1000.0;
+    result["throughput"] = FLAGS_requests * 1000000.0 / std::max<int64_t>(elapsed, 1);
+    result["latency_us"] = LatencySummary::from(latency).to_json();
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    auto node_counts = parse_list(FLAGS_node_counts);
+    auto concurrency_list = parse_list(FLAGS_concurrency_list);
+    if (node_counts.empty()) {
+        printf("empty node_counts\n");
+        return -1;
+    }
+
+    if (!FLAGS_emit.empty()) {
+        json graph;
+        Status status = generate_graph(make_shape(node_counts[0]), &graph);
+        if (!status.ok()) {
+            printf("generate graph failed: %s\n", status.error_cstr());
+            return -1;
+        }
+        std::ofstream out(FLAGS_emit);
+        out << graph.dump(4);
+        return 0;
+    }
+
+    // 图只加载一次，不同并发度共用
+    std::vector<std::unique_ptr<StreamGraph>> graphs;
+    for (int64_t nodes : node_counts) {
+        std::string path = "/tmp/synthetic_graph_" + std::to_string(nodes) + ".json";
+        json graph;
+        Status status = generate_graph(make_shape(nodes), &graph);
+        if (!status.ok()) {
+            printf("generate graph failed: %s\n", status.error_cstr());
+            return -1;
+        }
+        {
+            std::ofstream out(path);
+            out << graph;
+        }
+        auto g = std::make_unique<StreamGraph>();
+        status = g->load(path);
+        if (!status.ok()) {
+            printf("load %s failed: %s\n", path.c_str(), status.error_cstr());
+            return -1;
+        }
+        graphs.push_back(std::move(g));
+    }
+
+    // 每组结果输出一行 json
+    for (int64_t concurrency : concurrency_list) {
+        // bthread_concurrency 只能调大，所以按递增顺序测
+        bthread_setconcurrency(concurrency);
+        for (size_t i = 0; i < graphs.size(); i++) {
+            json result = run_graph(*graphs[i]);
+            result["nodes"] = graphs[i]->list_node().size();
+            result["bthread_concurrency"] = concurrency;
+            printf("%s\n", result.dump().c_str());
+        }
+    }
+    return 0;
+}
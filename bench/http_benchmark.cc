@@ -0,0 +1,246 @@
+/**********
+ * 端到端压测: 请求模拟模型服务，得到可复现的吞吐和 TTFT
+ *   --mode=http   source -> HttpNode -> 读完 body
+ *   --mode=graph  source -> HttpNode -> SseParserNode -> 读完 token，sink 是 token 流
+ *   不指定 --url 时在进程内启动 MockLlmServer
+ *   xmake run http_benchmark --mode=graph --qps=200 --mock_config='{"tokens":32,"tokens_per_second":100}'
+ * **********
+*/
+#include "bench/mock_llm_server.h"
+#include "bench/load_generator.h"
+#include "include/http.h"
+#include "include/sse.h"
+
+#include <gflags/gflags.h>
+
+DEFINE_string(mode, "both", "http / graph / both");
+DEFINE_string(url, "", "模型服务地址，为空时在进程内启动模拟服务");
+DEFINE_int32(port, 8765, "进程内模拟服务的端口");
+DEFINE_string(mock_config, "", "模拟服务的配置，见 MockLlmOptions");
+DEFINE_int32(timeout_ms, 3000, "单个 http 请求的超时");
+DEFINE_double(qps, 100, "到达率");
+DEFINE_bool(poisson, true, "到达间隔服从指数分布");
+DEFINE_int64(duration_ms, 10000, "每一档的发压时长");
+DEFINE_bool(sweep, false, "从 qps 开始逐档加压，找饱和拐点");
+DEFINE_double(sweep_max_qps, 100000, "加压的上限");
+DEFINE_double(sweep_step, 1.5, "每一档乘以的倍数");
+DEFINE_double(knee_factor, 3, "p99 超过第一档的这么多倍认为饱和");
+
+using namespace stream_dag;
+
+// 请求是否成功，由图里最后的节点写出，执行结束后从 ctx 里取
+struct BenchOutcome {
+    int code = 0;
+    std::string msg;
+
+    json to_json() const {
+        return json({{"code", code}, {"msg", msg}});
+    }
+};
+
+class MockRequestSource : public BaseNode {
+public:
+    Status init(json& option) {
+        url_ = option.value("url", "");
+        stream_ = option.value("stream", true);
+        timeout_ms_ = option.value("timeout_ms", 3000);
+        return Status::OK();
+    }
+
+    Status run(Stream<HttpRequest>& request) {
+        request.append(HttpRequest {
+            .method = "POST",
+            .url = url_,
+            .data = json({{"inputs", "hello"}}),
+            .stream = stream_,
+            .timeout_ms = timeout_ms_,
+        });
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(request, Stream<HttpRequest>),
+    );
+
+private:
+    std::string url_;
+    bool stream_ = true;
+    int timeout_ms_ = 3000;
+};
+REGISTER_CLASS(MockRequestSource);
+
+// 检查响应状态，并读完原始 body
+class BodyDrain : public BaseNode {
+public:
+    Status run(Stream<HttpResponse>& response, ByteStream& body, Stream<BenchOutcome>& outcome) {
+        HttpResponse rsp;
+        response.read(rsp);
+        butil::IOBuf all;
+        body.read_all(all);
+        outcome.append(check_response(rsp));
+        return Status::OK();
+    }
+
+    static BenchOutcome check_response(const HttpResponse& rsp) {
+        if (rsp.error_code != 0) {
+            return BenchOutcome{rsp.error_code, rsp.error_text};
+        }
+        if (rsp.status_code != 200) {
+            return BenchOutcome{-1, "http status " + std::to_string(rsp.status_code)};
+        }
+        return BenchOutcome{};
+    }
+
+    DECLARE_PARAMS (
+        INPUT(response, Stream<HttpResponse>),
+        INPUT(body, ByteStream),
+        OUTPUT(outcome, Stream<BenchOutcome>),
+    );
+};
+REGISTER_CLASS(BodyDrain);
+
+class ResponseCheck : public BaseNode {
+public:
+    Status run(Stream<HttpResponse>& response, Stream<BenchOutcome>& outcome) {
+        HttpResponse rsp;
+        response.read(rsp);
+        outcome.append(BodyDrain::check_response(rsp));
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(response, Stream<HttpResponse>),
+        OUTPUT(outcome, Stream<BenchOutcome>),
+    );
+};
+REGISTER_CLASS(ResponseCheck);
+
+// 读完 token 流，没有收到结束 token 说明流被中途断开
+class TokenDrain : public BaseNode {
+public:
+    Status run(Stream<LLMToken>& tokens, Stream<BenchOutcome>& outcome) {
+        LLMToken token;
+        bool finished = false;
+        while (tokens.read(token).ok()) {
+            finished = finished || token.finished;
+        }
+        outcome.append(finished ? BenchOutcome{} : BenchOutcome{-1, "stream not finished"});
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(tokens, Stream<LLMToken>),
+        OUTPUT(outcome, Stream<BenchOutcome>),
+    );
+};
+REGISTER_CLASS(TokenDrain);
+
+static Status read_outcome(BaseContext& ctx, NodeOutputWrppper<Stream<BenchOutcome>>& wrapper) {
+    BenchOutcome outcome;
+    Status status = ctx.get(wrapper).read(outcome);
+    if (!status.ok()) {
+        return Status(-1, "no outcome");
+    }
+    return outcome.code == 0 ? Status::OK() : Status(outcome.code, "%s", outcome.msg.c_str());
+}
+
+static void run_load(const std::string& mode, LoadGenerator& generator) {
+    LoadOptions options;
+    options.qps = FLAGS_qps;
+    options.poisson = FLAGS_poisson;
+    options.duration_ms = FLAGS_duration_ms;
+
+    json report;
+    report["mode"] = mode;
+    if (!FLAGS_sweep) {
+        report["result"] = generator.run(options).to_json();
+    } else {
+        int knee = -1;
+        auto results = generator.sweep(options, FLAGS_qps, FLAGS_sweep_max_qps, FLAGS_sweep_step, FLAGS_knee_factor, &knee);
+        for (auto& result : results) {
+            report["levels"].push_back(result.to_json());
+        }
+        report["knee_qps"] = knee >= 0 ? results[knee].offered_qps : 0;
+    }
+    printf("%s\n", report.dump().c_str());
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    json config = json::object();
+    if (!FLAGS_mock_config.empty()) {
+        config = json::parse(FLAGS_mock_config, nullptr, false);
+        if (config.is_discarded()) {
+            printf("invalid mock_config: %s\n", FLAGS_mock_config.c_str());
+            return -1;
+        }
+    }
+    MockLlmOptions mock_options = MockLlmOptions::from_json(config);
+
+    std::unique_ptr<MockLlmServer> server;
+    std::string url = FLAGS_url;
+    if (url.empty()) {
+        server = std::make_unique<MockLlmServer>(mock_options);
+        Status status = server->start(FLAGS_port);
+        if (!status.ok()) {
+            printf("%s\n", status.error_cstr());
+            return -1;
+        }
+        url = "http://127.0.0.1:" + std::to_string(FLAGS_port) + "/generate_stream";
+        printf("%s\n", json({{"mock", mock_options.to_json()}}).dump().c_str());
+    }
+
+    json source_option = {{"url", url}, {"stream", true}, {"timeout_ms", FLAGS_timeout_ms}};
+    json http_option = {{"host", url}, {"timeout_ms", FLAGS_timeout_ms}, {"max_retry", 0}};
+
+    if (FLAGS_mode == "http" || FLAGS_mode == "both") {
+        StreamGraph g;
+        g.set_name("http_benchmark");
+        MockRequestSource* source = g.add_node<MockRequestSource>("source");
+        HttpNode* http = g.add_node<HttpNode>("http_node");
+        BodyDrain* drain = g.add_node<BodyDrain>("drain");
+        source->configure(source_option);
+        http->configure(http_option);
+        g.add_edge(source->request, http->request_);
+        g.add_edge(http->response_, drain->response);
+        g.add_edge(http->stream_body, drain->body);
+        g.mark_sink(http->stream_body);
+
+        LoadGenerator generator([&](BaseContext& ctx) {
+            BthreadExecutor executor;
+            Status status = executor.run(g, ctx);
+            return status.ok() ? read_outcome(ctx, drain->outcome) : status;
+        });
+        run_load("http", generator);
+    }
+
+    if (FLAGS_mode == "graph" || FLAGS_mode == "both") {
+        StreamGraph g;
+        g.set_name("stream_benchmark");
+        MockRequestSource* source = g.add_node<MockRequestSource>("source");
+        HttpNode* http = g.add_node<HttpNode>("http_node");
+        ResponseCheck* check = g.add_node<ResponseCheck>("check");
+        SseParserNode* parser = g.add_node<SseParserNode>("parser");
+        TokenDrain* drain = g.add_node<TokenDrain>("drain");
+        source->configure(source_option);
+        http->configure(http_option);
+        g.add_edge(source->request, http->request_);
+        g.add_edge(http->response_, check->response);
+        g.add_edge(http->stream_body, parser->body);
+        g.add_edge(parser->tokens, drain->tokens);
+        g.mark_sink(parser->tokens);
+
+        LoadGenerator generator([&](BaseContext& ctx) {
+            BthreadExecutor executor;
+            Status status = executor.run(g, ctx);
+            if (!status.ok()) {
+                return status;
+            }
+            status = read_outcome(ctx, check->outcome);
+            return status.ok() ? read_outcome(ctx, drain->outcome) : status;
+        });
+        run_load("graph", generator);
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+#include "include/stream-dag.h"
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 开环压测配置
+//   qps          目标到达率
+//   poisson      true 时到达间隔服从指数分布，否则固定间隔
+//   duration_ms  发压时长，之后等待所有请求结束
+//   max_inflight 在途请求上限，超过时丢弃并计入 dropped，防止过载时内存无限增长
+struct LoadOptions {
+    double qps = 1000;
+    bool poisson = true;
+    int64_t duration_ms = 10000;
+    int64_t max_inflight = 100000;
+    uint64_t seed = 1;
+};
+
+// 一组延迟样本的分位数，单位 us
+struct LatencySummary {
+    int64_t count = 0;
+    int64_t avg = 0;
+    int64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+
+    static LatencySummary from(std::vector<int64_t>& samples) {
+        LatencySummary result;
+        result.count = samples.size();
+        if (samples.empty()) {
+            return result;
+        }
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double ratio) {
+            return samples[std::min(samples.size() - 1, (size_t) (ratio * samples.size()))];
+        };
+        int64_t sum = 0;
+        for (int64_t v : samples) {
+            sum += v;
+        }
+        result.avg = sum / (int64_t) samples.size();
+        result.p50 = at(0.5);
+        result.p90 = at(0.9);
+        result.p99 = at(0.99);
+        result.p999 = at(0.999);
+        result.max = samples.back();
+        return result;
+    }
+
+    json to_json() const {
+        return json({{"count", count}, {"avg", avg}, {"p50", p50}, {"p90", p90},
+                     {"p99", p99}, {"p999", p999}, {"max", max}});
+    }
+};
+
+struct LoadResult {
+    double offered_qps = 0;
+    double throughput = 0;   // 完成的请求数 / 发压时长
+    int64_t sent = 0;
+    int64_t completed = 0;
+    int64_t errors = 0;
+    int64_t dropped = 0;
+    LatencySummary total;
+    LatencySummary ttft;
+
+    json to_json() const {
+        return json({
+            {"offered_qps", offered_qps},
+            {"throughput", throughput},
+            {"sent", sent},
+            {"completed", completed},
+            {"errors", errors},
+            {"dropped", dropped},
+            {"total_us", total.to_json()},
+            {"ttft_us", ttft.to_json()},
+        });
+    }
+};
+
+// 开环压测: 按到达时间表发请求，不等上一个请求结束
+//   延迟从计划发送时间开始算，发送被推迟的时间也计入，避免 coordinated omission
+//   ttft 取 ctx.latency()，需要图里标记了 sink 流
+class LoadGenerator {
+public:
+    using Request = std::function<Status(BaseContext&)>;
+
+    LoadGenerator(Request request) : request_(request) {}
+
+    LoadResult run(const LoadOptions& options) {
+        state_ = std::make_unique<RunState>();
+        std::mt19937_64 rng(options.seed);
+        std::exponential_distribution<double> interval(options.qps);
+        double fixed_interval_us = 1000000.0 / options.qps;
+
+        int64_t start = butil::gettimeofday_us();
+        int64_t stop = start + options.duration_ms * 1000;
+        double next = start;
+        while (next < stop) {
+            int64_t now = butil::gettimeofday_us();
+            if (next > now) {
+                bthread_usleep((int64_t) next - now);
+            }
+            launch((int64_t) next, options.max_inflight);
+            next += options.poisson ? interval(rng) * 1000000.0 : fixed_interval_us;
+        }
+        while (state_->inflight.load() != 0) {
+            bthread_usleep(1000);
+        }
+
+        LoadResult result;
+        result.offered_qps = options.qps;
+        result.sent = state_->sent;
+        result.dropped = state_->dropped;
+        result.errors = state_->errors.load();
+        result.completed = state_->total.size();
+        result.throughput = (result.completed - result.errors) * 1000.0 / options.duration_ms;
+        result.total = LatencySummary::from(state_->total);
+        result.ttft = LatencySummary::from(state_->ttft);
+        return result;
+    }
+
+    // 从 start_qps 开始每次乘以 step 加压，直到 max_qps 或者越过拐点
+    //   拐点: 吞吐低于发压的 95%，或者 p99 超过最低档的 knee_factor 倍
+    //   返回每一档的结果，knee 是最后一个没有饱和的档位下标，-1 表示第一档就饱和了
+    std::vector<LoadResult> sweep(LoadOptions options, double start_qps, double max_qps,
+                                  double step, double knee_factor, int* knee) {
+        std::vector<LoadResult> results;
+        *knee = -1;
+        int64_t base_p99 = 0;
+        for (double qps = start_qps; qps <= max_qps; qps *= step) {
+            options.qps = qps;
+            LoadResult result = run(options);
+            results.push_back(result);
+            if (results.size() == 1) {
+                base_p99 = std::max<int64_t>(result.total.p99, 1);
+            }
+            bool saturated = result.throughput < qps * 0.95 || result.total.p99 > base_p99 * knee_factor;
+            if (saturated) {
+                break;
+            }
+            *knee = results.size() - 1;
+        }
+        return results;
+    }
+
+private:
+    struct RunState {
+        std::atomic<int64_t> inflight{0};
+        std::atomic<int64_t> errors{0};
+        int64_t sent = 0;
+        int64_t dropped = 0;
+        bthread::Mutex mutex;
+        std::vector<int64_t> total;
+        std::vector<int64_t> ttft;
+    };
+
+    struct Task {
+        LoadGenerator* self;
+        int64_t scheduled_us;
+    };
+
+    void launch(int64_t scheduled_us, int64_t max_inflight) {
+        if (state_->inflight.load() >= max_inflight) {
+            state_->dropped += 1;
+            return;
+        }
+        state_->sent += 1;
+        state_->inflight.fetch_add(1);
+        bthread_t tid;
+        Task* task = new Task{this, scheduled_us};
+        int rc = bthread_start_background(&tid, nullptr, [](void* arg) -> void* {
+            std::unique_ptr<Task> task((Task*) arg);
+            task->self->execute(task->scheduled_us);
+            return nullptr;
+        }, task);
+        if (rc != 0) {
+            // 没启动起来的请求算失败，和执行失败的请求一样计入 total
+            delete task;
+            state_->errors.fetch_add(1);
+            {
+                std::unique_lock<bthread::Mutex> lock_(state_->mutex);
+                state_->total.push_back(butil::gettimeofday_us() - scheduled_us);
+            }
+            state_->inflight.fetch_sub(1);
+        }
+    }
+
+    void execute(int64_t scheduled_us) {
+        BaseContext ctx;
+        ctx.latency().admit(scheduled_us);
+        Status status = request_(ctx);
+        int64_t total = butil::gettimeofday_us() - scheduled_us;
+        int64_t ttft = ctx.latency().ttft_us();
+        if (!status.ok()) {
+            state_->errors.fetch_add(1);
+        }
+        {
+            std::unique_lock<bthread::Mutex> lock_(state_->mutex);
+            state_->total.push_back(total);
+            if (status.ok() && ttft >= 0) {
+                state_->ttft.push_back(ttft);
+            }
+        }
+        state_->inflight.fetch_sub(1);
+    }
+
+    Request request_;
+    std::unique_ptr<RunState> state_;
+};
+
+}
@@ -0,0 +1,399 @@
+/**********
+ * 核心组件的微基准
+ *   xmake run micro_benchmark --benchmark_format=json --benchmark_out=micro.json
+ * 输出格式由 google benchmark 的参数控制，json 可以直接用来对比两次结果
+ * **********
+*/
+#include "include/stream-dag.h"
+#include "include/static_graph.h"
+#include "include/graph_binary.h"
+
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <fstream>
+
+using namespace stream_dag;
+using json = nlohmann::json;
+
+struct Item {
+    int64_t value = 0;
+
+    json to_json() const {
+        return json(value);
+    }
+};
+
+class BenchSource : public BaseNode {
+public:
+    Status run(Stream<Item>& out) {
+        out.append(Item{1});
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS(
+        OUTPUT(out, Stream<Item>),
+    )
+};
+REGISTER_CLASS(BenchSource);
+
+// 把输入原样转发到输出，直到输入结束
+class BenchPass : public BaseNode {
+public:
+    Status run(Stream<Item>& in, Stream<Item>& out) {
+        Item item;
+        while (in.read(item).ok()) {
+            out.append(item);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS(
+        INPUT(in, Stream<Item>),
+        OUTPUT(out, Stream<Item>),
+    )
+};
+REGISTER_CLASS(BenchPass);
+
+// Node<T>::Call 的被调用方，只处理一个元素
+class BenchEcho : public BaseNode {
+public:
+    Status run(Stream<Item>& in, Stream<Item>& out) {
+        Item item;
+        Status status = in.read(item);
+        if (!status.ok()) {
+            return status;
+        }
+        item.value += 1;
+        out.append(item);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS(
+        INPUT(in, Stream<Item>),
+        OUTPUT(out, Stream<Item>),
+    )
+};
+REGISTER_CLASS(BenchEcho);
+
+// source -> pass -> pass ... 的链
+static void build_chain(StreamGraph& g, int length) {
+    BenchSource* source = g.add_node<BenchSource>("source");
+    auto* prev = &source->out;
+    for (int i = 0; i < length - 1; i++) {
+        BenchPass* pass = g.add_node<BenchPass>("pass_" + std::to_string(i));
+        g.add_edge(*prev, pass->in);
+        prev = &pass->out;
+    }
+}
+
+static constexpr int kBatch = 1024;
+
+// 单线程先写后读
+static void BM_PipeStream_AppendRead(benchmark::State& state) {
+    BaseContext ctx;
+    for (auto _ : state) {
+        PipeStream<Item> stream(ctx, "bench/stream", "Item");
+        Item item;
+        for (int i = 0; i < kBatch; i++) {
+            stream.append(Item{i});
+        }
+        for (int i = 0; i < kBatch; i++) {
+            stream.read(item);
+        }
+        benchmark::DoNotOptimize(item);
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_PipeStream_AppendRead);
+
+// N 个写者一个读者，写读并发
+static void BM_PipeStream_Writers(benchmark::State& state) {
+    int writers = state.range(0);
+    int per_writer = kBatch / writers;
+    BaseContext ctx;
+    for (auto _ : state) {
+        PipeStream<Item> stream(ctx, "bench/stream", "Item");
+        std::vector<BThread> threads;
+        for (int w = 0; w < writers; w++) {
+            threads.emplace_back([&stream, per_writer] {
+                for (int i = 0; i < per_writer; i++) {
+                    stream.append(Item{i});
+                }
+            });
+        }
+        Item item;
+        for (int i = 0; i < per_writer * writers; i++) {
+            stream.read(item);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * per_writer * writers);
+}
+BENCHMARK(BM_PipeStream_Writers)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+// N 对写者读者，各用一个流. PipeStream 是单读者，多读者就是多个流同时读
+static void BM_PipeStream_Pairs(benchmark::State& state) {
+    int pairs = state.range(0);
+    BaseContext ctx;
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<PipeStream<Item>>> streams;
+        for (int p = 0; p < pairs; p++) {
+            streams.push_back(std::make_unique<PipeStream<Item>>(ctx, "bench/stream", "Item"));
+        }
+        std::vector<BThread> threads;
+        for (int p = 0; p < pairs; p++) {
+            PipeStream<Item>* stream = streams[p].get();
+            threads.emplace_back([stream] {
+                Item item;
+                for (int i = 0; i < kBatch; i++) {
+                    stream->read(item);
+                }
+            });
+            threads.emplace_back([stream] {
+                for (int i = 0; i < kBatch; i++) {
+                    stream->append(Item{i});
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * pairs * kBatch);
+}
+BENCHMARK(BM_PipeStream_Pairs)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+// trace 开关对流读写的影响
+static void BM_PipeStream_Trace(benchmark::State& state) {
+    bool trace = state.range(0) != 0;
+    for (auto _ : state) {
+        BaseContext ctx;
+        ctx.enable_trace(trace);
+        PipeStream<Item> stream(ctx, "bench/stream", "Item");
+        Item item;
+        for (int i = 0; i < 64; i++) {
+            stream.append(Item{i});
+            stream.read(item);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_PipeStream_Trace)->Arg(0)->Arg(1);
+
+// 一个流有数据时 when_any 的延迟
+static void BM_WhenAny(benchmark::State& state) {
+    BaseContext ctx;
+    PipeStream<Item> s1(ctx, "bench/s1", "Item");
+    PipeStream<Item> s2(ctx, "bench/s2", "Item");
+    for (auto _ : state) {
+        s1.append(Item{1});
+        auto [r1, r2] = when_any(s1, s2);
+        benchmark::DoNotOptimize(r1);
+    }
+}
+BENCHMARK(BM_WhenAny)->UseRealTime();
+
+// 创建 ctx 并对每个节点 init_ctx
+static void BM_Context_InitCtx(benchmark::State& state) {
+    StreamGraph g;
+    build_chain(g, state.range(0));
+    for (auto _ : state) {
+        BaseContext ctx;
+        for (auto node : g.list_node()) {
+            node->init_ctx(ctx);
+        }
+        for (auto& [out, in] : g.list_edge()) {
+            ctx.init_input(out, in);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Context_InitCtx)->Arg(5)->Arg(50)->Arg(500);
+
+static void BM_NodeFactory_Create(benchmark::State& state) {
+    std::string type = typeid(BenchPass).name();
+    std::string name = "pass";
+    for (auto _ : state) {
+        auto node = NodeFactory::CreateInstanceByName(type, name, type);
+        benchmark::DoNotOptimize(node);
+    }
+}
+BENCHMARK(BM_NodeFactory_Create);
+
+// 加载 N 个节点的链式图
+static void BM_StreamGraph_Load(benchmark::State& state) {
+    int length = state.range(0);
+    std::string path = "/tmp/micro_benchmark_graph_" + std::to_string(length) + ".json";
+    {
+        StreamGraph g;
+        build_chain(g, length);
+        g.dump(path);
+    }
+    for (auto _ : state) {
+        StreamGraph g;
+        Status status = g.load(path);
+        if (!status.ok()) {
+            state.SkipWithError(status.error_cstr());
+            break;
+        }
+    }
+    std::remove(path.c_str());
+    state.SetItemsProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_StreamGraph_Load)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// 动态调用一个节点: 写入输入、执行、读出输出
+static void BM_Node_Call(benchmark::State& state) {
+    BenchEcho echo("echo", typeid(BenchEcho).name());
+    BaseContext ctx;
+    for (auto _ : state) {
+        Node<BenchEcho> node(echo, ctx);
+        Item in{1}, out;
+        node.Call(in, out);
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_Node_Call);
+
+// 异步调用再 join，比同步调用多一次 bthread 创建和切换
+static void BM_Node_CallAsync(benchmark::State& state) {
+    BenchEcho echo("echo", typeid(BenchEcho).name());
+    BaseContext ctx;
+    for (auto _ : state) {
+        Node<BenchEcho> node(echo, ctx);
+        Item in{1}, out;
+        node.CallAsync(in, out).join();
+        benchmark::DoNotOptimize(out);
+    }
+}
+BENCHMARK(BM_Node_CallAsync)->UseRealTime();
+
+// 整图执行，作为上面各项的参照. 第二个参数是否启用 ctx arena
+//   heap_allocs 是每个请求经由 arena 向堆申请的次数，关闭 arena 时就是 ctx 内的全部分配次数
+static void BM_Executor_Run(benchmark::State& state) {
+    StreamGraph g;
+    build_chain(g, state.range(0));
+    BthreadExecutor executor;
+    RequestArena::enable(state.range(1) != 0);
+    int64_t arena_allocs = 0, heap_allocs = 0;
+    for (auto _ : state) {
+        BaseContext ctx;
+        Status status = executor.run(g, ctx);
+        if (!status.ok()) {
+            state.SkipWithError(status.error_cstr());
+            break;
+        }
+        arena_allocs += ctx.arena().allocations();
+        heap_allocs += ctx.arena().heap_allocations();
+    }
+    RequestArena::enable(true);
+    state.counters["arena_allocs"] = benchmark::Counter(arena_allocs, benchmark::Counter::kAvgIterations);
+    state.counters["heap_allocs"] = benchmark::Counter(heap_allocs, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_Executor_Run)->ArgsProduct({{5, 50}, {0, 1}})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// 从 ContextPool 取 ctx，复用上一个请求的表和流. 稳定后 heap_allocs 为 0
+static void BM_Executor_Pool(benchmark::State& state) {
+    StreamGraph g;
+    build_chain(g, state.range(0));
+    BthreadExecutor executor;
+    ContextPool pool(g);
+    int64_t arena_allocs = 0, heap_allocs = 0;
+    for (auto _ : state) {
+        auto ctx = pool.acquire();
+        Status status = executor.run(g, *ctx);
+        if (!status.ok()) {
+            state.SkipWithError(status.error_cstr());
+            break;
+        }
+        arena_allocs += ctx->arena().allocations();
+        heap_allocs += ctx->arena().heap_allocations();
+    }
+    state.counters["arena_allocs"] = benchmark::Counter(arena_allocs, benchmark::Counter::kAvgIterations);
+    state.counters["heap_allocs"] = benchmark::Counter(heap_allocs, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_Executor_Pool)->Arg(5)->Arg(50)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// 加载一张图. 第二个参数 0 为 JSON 文本（解析 + load_json），1 为二进制
+static void BM_Graph_Load(benchmark::State& state) {
+    StreamGraph source;
+    build_chain(source, state.range(0));
+    json graph = source.to_json();
+    std::string text = graph.dump();
+    std::string binary;
+    Status status = GraphBinary::from_json(graph, &binary);
+    if (!status.ok()) {
+        state.SkipWithError(status.error_cstr());
+        return;
+    }
+    bool use_binary = state.range(1) != 0;
+    for (auto _ : state) {
+        StreamGraph g;
+        if (use_binary) {
+            status = GraphBinary::load(g, binary.data(), binary.size());
+        } else {
+            status = g.load_json(json::parse(text));
+        }
+        if (!status.ok()) {
+            state.SkipWithError(status.error_cstr());
+            break;
+        }
+    }
+    state.counters["bytes"] = use_binary ? binary.size() : text.size();
+}
+BENCHMARK(BM_Graph_Load)->ArgsProduct({{50, 500}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+// 和 BM_Executor_Run/5 同样的 5 个节点的链，编译期连线
+using StaticChain = StaticGraph<
+    Nodes<BenchSource, BenchPass, BenchPass, BenchPass, BenchPass>,
+    Edge<0, BenchSource::ports::out, 1, BenchPass::ports::in>,
+    Edge<1, BenchPass::ports::out, 2, BenchPass::ports::in>,
+    Edge<2, BenchPass::ports::out, 3, BenchPass::ports::in>,
+    Edge<3, BenchPass::ports::out, 4, BenchPass::ports::in>>;
+
+static void BM_StaticGraph_Run(benchmark::State& state) {
+    StaticChain g({"source", "pass_0", "pass_1", "pass_2", "pass_3"});
+    int64_t arena_allocs = 0;
+    for (auto _ : state) {
+        BaseContext ctx;
+        StaticChain::Streams streams(ctx, g);
+        Status status = g.run(ctx, streams);
+        if (!status.ok()) {
+            state.SkipWithError(status.error_cstr());
+            break;
+        }
+        arena_allocs += ctx.arena().allocations();
+    }
+    state.counters["arena_allocs"] = benchmark::Counter(arena_allocs, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_StaticGraph_Run)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// source -> 转换 -> pass. 0: 转换是一个 BenchPass 节点，1: 转换边，少一个节点、流和 bthread
+static void BM_Convertor(benchmark::State& state) {
+    StreamGraph g;
+    BenchSource* source = g.add_node<BenchSource>("source");
+    BenchPass* pass = g.add_node<BenchPass>("pass");
+    if (state.range(0)) {
+        g.add_edge(source->out, pass->in, [](const Item& item) { return Item{item.value + 1}; });
+    } else {
+        BenchPass* convert = g.add_node<BenchPass>("convert");
+        g.add_edge(source->out, convert->in);
+        g.add_edge(convert->out, pass->in);
+    }
+    BthreadExecutor executor;
+    ContextPool pool(g);
+    for (auto _ : state) {
+        auto ctx = pool.acquire();
+        Status status = executor.run(g, *ctx);
+        if (!status.ok()) {
+            state.SkipWithError(status.error_cstr());
+            break;
+        }
+    }
+}
+BENCHMARK(BM_Convertor)->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
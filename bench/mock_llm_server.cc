@@ -0,0 +1,40 @@
+/**********
+ * 模拟模型服务，替代 test_http_simple2 / bing 测试里的外部服务
+ *   xmake run mock_llm_server --port=8765 --config='{"tokens_per_second":50,"first_token":{"dist":"lognormal","mean_ms":200,"stddev_ms":100}}'
+ *   curl -N -d '{"inputs":"hi","mock":{"tokens":8}}' http://127.0.0.1:8765/generate_stream
+ * **********
+*/
+#include "bench/mock_llm_server.h"
+
+#include <gflags/gflags.h>
+
+DEFINE_int32(port, 8765, "监听端口");
+DEFINE_string(config, "", "MockLlmOptions 的 json 配置");
+
+using namespace stream_dag;
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    json config = json::object();
+    if (!FLAGS_config.empty()) {
+        config = json::parse(FLAGS_config, nullptr, false);
+        if (config.is_discarded()) {
+            printf("invalid config: %s\n", FLAGS_config.c_str());
+            return -1;
+        }
+    }
+    MockLlmOptions options = MockLlmOptions::from_json(config);
+
+    MockLlmServer server(options);
+    Status status = server.start(FLAGS_port);
+    if (!status.ok()) {
+        printf("%s\n", status.error_cstr());
+        return -1;
+    }
+    printf("mock llm server listening on %d, options: %s\n", FLAGS_port, options.to_json().dump().c_str());
+    while (!brpc::IsAskedToQuit()) {
+        bthread_usleep(100000);
+    }
+    return 0;
+}
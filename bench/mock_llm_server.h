@@ -0,0 +1,307 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <string>
+#include "include/stream-dag.h"
+#include <brpc/server.h>
+#include <brpc/progressive_attachment.h>
+#include "mock_llm.pb.h"
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 一段延迟的分布，单位 ms
+//   fixed        固定 mean_ms
+//   uniform      [mean_ms - stddev_ms, mean_ms + stddev_ms] 均匀分布
+//   exponential  均值 mean_ms 的指数分布
+//   lognormal    均值 mean_ms、标准差 stddev_ms 的对数正态分布，长尾
+// 配置可以是一个数字（固定值），也可以是 {"dist": "lognormal", "mean_ms": 20, "stddev_ms": 10}
+struct LatencyDist {
+    std::string dist = "fixed";
+    double mean_ms = 0;
+    double stddev_ms = 0;
+
+    static LatencyDist fixed(double ms) {
+        LatencyDist result;
+        result.mean_ms = ms;
+        return result;
+    }
+
+    static LatencyDist from_json(const json& option, LatencyDist result) {
+        if (option.is_number()) {
+            return fixed(option.get<double>());
+        }
+        if (option.is_object()) {
+            result.dist = option.value("dist", result.dist);
+            result.mean_ms = option.value("mean_ms", result.mean_ms);
+            result.stddev_ms = option.value("stddev_ms", result.stddev_ms);
+        }
+        return result;
+    }
+
+    template<class Rng>
+    int64_t sample_us(Rng& rng) const {
+        double ms = mean_ms;
+        if (dist == "uniform") {
+            ms = std::uniform_real_distribution<double>(mean_ms - stddev_ms, mean_ms + stddev_ms)(rng);
+        } else if (dist == "exponential" && mean_ms > 0) {
+            ms = std::exponential_distribution<double>(1.0 / mean_ms)(rng);
+        } else if (dist == "lognormal" && mean_ms > 0) {
+            double sigma2 = std::log(1 + stddev_ms * stddev_ms / (mean_ms * mean_ms));
+            double mu = std::log(mean_ms) - sigma2 / 2;
+            ms = std::lognormal_distribution<double>(mu, std::sqrt(sigma2))(rng);
+        }
+        return std::max<int64_t>(0, (int64_t) (ms * 1000));
+    }
+
+    json to_json() const {
+        return json({{"dist", dist}, {"mean_ms", mean_ms}, {"stddev_ms", stddev_ms}});
+    }
+};
+
+// 模拟模型服务的配置，请求 body 里的 "mock" 字段可以覆盖其中任意一项
+//   format            tgi / openai 为 SSE，和 SseParserNode 支持的格式一致; raw 为 chunked 纯文本
+//   first_token       首 token 延迟
+//   token_interval    token 间隔. tokens_per_second 大于 0 时覆盖它的均值
+//   tokens            输出的 token 个数
+//   token_bytes       每个 token 的字节数
+//   error_rate        直接返回 error_status 的比例
+//   timeout_rate      挂住 hang_ms 再返回 504 的比例，用来触发客户端超时
+//   truncate_rate     输出一半后正常结束响应、不发结束事件的比例. 连接不断开，客户端读到的是正常的 EOF
+//   seed              随机种子. 第 n 个请求用 seed + n，同样的请求顺序结果可复现
+struct MockLlmOptions {
+    std::string format = "tgi";
+    LatencyDist first_token = LatencyDist::fixed(50);
+    LatencyDist token_interval = LatencyDist::fixed(20);
+    double tokens_per_second = 0;
+    int64_t tokens = 64;
+    int64_t token_bytes = 4;
+    double error_rate = 0;
+    int error_status = 500;
+    double timeout_rate = 0;
+    int64_t hang_ms = 60000;
+    double truncate_rate = 0;
+    uint64_t seed = 1;
+
+    static MockLlmOptions from_json(const json& option) {
+        return from_json(option, MockLlmOptions());
+    }
+
+    static MockLlmOptions from_json(const json& option, MockLlmOptions result) {
+        if (!option.is_object()) {
+            return result;
+        }
+        result.format = option.value("format", result.format);
+        if (option.contains("first_token")) {
+            result.first_token = LatencyDist::from_json(option["first_token"], result.first_token);
+        }
+        if (option.contains("token_interval")) {
+            result.token_interval = LatencyDist::from_json(option["token_interval"], result.token_interval);
+        }
+        result.tokens_per_second = option.value("tokens_per_second", result.tokens_per_second);
+        if (result.tokens_per_second > 0) {
+            result.token_interval.mean_ms = 1000.0 / result.tokens_per_second;
+        }
+        result.tokens = option.value("tokens", result.tokens);
+        result.token_bytes = option.value("token_bytes", result.token_bytes);
+        result.error_rate = option.value("error_rate", result.error_rate);
+        result.error_status = option.value("error_status", result.error_status);
+        result.timeout_rate = option.value("timeout_rate", result.timeout_rate);
+        result.hang_ms = option.value("hang_ms", result.hang_ms);
+        result.truncate_rate = option.value("truncate_rate", result.truncate_rate);
+        result.seed = option.value("seed", result.seed);
+        return result;
+    }
+
+    json to_json() const {
+        return json({
+            {"format", format},
+            {"first_token", first_token.to_json()},
+            {"token_interval", token_interval.to_json()},
+            {"tokens_per_second", tokens_per_second},
+            {"tokens", tokens},
+            {"token_bytes", token_bytes},
+            {"error_rate", error_rate},
+            {"error_status", error_status},
+            {"timeout_rate", timeout_rate},
+            {"hang_ms", hang_ms},
+            {"truncate_rate", truncate_rate},
+            {"seed", seed},
+        });
+    }
+};
+
+// 模拟模型服务. 按配置的延迟分布逐个写出 token，供压测和 CI 使用，不依赖外部服务
+class MockLlmService : public mock::MockLLMService {
+public:
+    MockLlmService(const MockLlmOptions& options) : options_(options) {}
+
+    void generate_stream(google::protobuf::RpcController* cntl_base, const mock::MockRequest*,
+                         mock::MockResponse*, google::protobuf::Closure* done) override {
+        handle(static_cast<brpc::Controller*>(cntl_base), done, true);
+    }
+
+    void generate(google::protobuf::RpcController* cntl_base, const mock::MockRequest*,
+                  mock::MockResponse*, google::protobuf::Closure* done) override {
+        handle(static_cast<brpc::Controller*>(cntl_base), done, false);
+    }
+
+    // 第 index 个 token 的文本
+    static std::string token_text(int64_t index, int64_t bytes) {
+        std::string text(std::max<int64_t>(bytes, 1), ' ');
+        for (size_t i = 0; i + 1 < text.size(); i++) {
+            text[i] = 'a' + (index + i) % 26;
+        }
+        return text;
+    }
+
+    // 一个 token 的事件. index == tokens 时是结束事件
+    static std::string format_event(const MockLlmOptions& options, int64_t index, const std::string& generated) {
+        bool last = index + 1 == options.tokens;
+        if (options.format == "raw") {
+            return token_text(index, options.token_bytes);
+        }
+        if (options.format == "openai") {
+            if (index == options.tokens) {
+                return "data: [DONE]\n\n";
+            }
+            json event = {{"choices", {{
+                {"delta", {{"content", token_text(index, options.token_bytes)}}},
+                {"finish_reason", last ? json("stop") : json(nullptr)},
+            }}}};
+            return "data: " + event.dump() + "\n\n";
+        }
+        json event = {
+            {"token", {{"id", index}, {"text", token_text(index, options.token_bytes)}, {"special", false}}},
+            {"generated_text", last ? json(generated) : json(nullptr)},
+        };
+        return "data:" + event.dump() + "\n\n";
+    }
+
+private:
+    struct StreamTask {
+        butil::intrusive_ptr<brpc::ProgressiveAttachment> pa;
+        MockLlmOptions options;
+        std::mt19937_64 rng;
+        bool truncate = false;
+    };
+
+    void handle(brpc::Controller* cntl, google::protobuf::Closure* done, bool stream) {
+        brpc::ClosureGuard done_guard(done);
+        MockLlmOptions options = options_;
+        json body = json::parse(cntl->request_attachment().to_string(), nullptr, false);
+        if (!body.is_discarded() && body.contains("mock")) {
+            options = MockLlmOptions::from_json(body["mock"], options);
+        }
+
+        std::mt19937_64 rng(options.seed + counter_.fetch_add(1));
+        double dice = std::uniform_real_distribution<double>(0, 1)(rng);
+        if (dice < options.error_rate) {
+            cntl->http_response().set_status_code(options.error_status);
+            cntl->response_attachment().append(R"({"error":"injected error"})");
+            return;
+        }
+        dice -= options.error_rate;
+        if (dice < options.timeout_rate) {
+            bthread_usleep(options.hang_ms * 1000);
+            cntl->http_response().set_status_code(504);
+            return;
+        }
+        dice -= options.timeout_rate;
+        bool truncate = dice < options.truncate_rate;
+
+        if (!stream) {
+            // 一次性返回，总耗时和流式一样
+            int64_t sleep_us = options.first_token.sample_us(rng);
+            std::string generated;
+            for (int64_t i = 0; i < options.tokens; i++) {
+                if (i > 0) {
+                    sleep_us += options.token_interval.sample_us(rng);
+                }
+                generated += token_text(i, options.token_bytes);
+            }
+            bthread_usleep(sleep_us);
+            cntl->http_response().set_content_type("application/json");
+            cntl->response_attachment().append(json({{"generated_text", generated}}).dump());
+            return;
+        }
+
+        cntl->http_response().set_content_type(options.format == "raw" ? "text/plain" : "text/event-stream");
+        StreamTask* task = new StreamTask{cntl->CreateProgressiveAttachment(), options, rng, truncate};
+        bthread_t tid;
+        bthread_start_background(&tid, nullptr, [](void* arg) -> void* {
+            std::unique_ptr<StreamTask> task((StreamTask*) arg);
+            write_stream(*task);
+            return nullptr;
+        }, task);
+        // done_guard 析构时发出响应头，之后 pa 写出的内容以 chunked 方式发送
+    }
+
+    static void write_stream(StreamTask& task) {
+        const MockLlmOptions& options = task.options;
+        int64_t stop = task.truncate ? options.tokens / 2 : options.tokens;
+        std::string generated;
+        bthread_usleep(options.first_token.sample_us(task.rng));
+        for (int64_t i = 0; i < stop; i++) {
+            if (i > 0) {
+                bthread_usleep(options.token_interval.sample_us(task.rng));
+            }
+            generated += token_text(i, options.token_bytes);
+            butil::IOBuf buf;
+            buf.append(format_event(options, i, generated));
+            if (task.pa->Write(buf) != 0) {
+                return; // 客户端断开
+            }
+        }
+        if (!task.truncate && options.format == "openai") {
+            butil::IOBuf buf;
+            buf.append(format_event(options, options.tokens, generated));
+            task.pa->Write(buf);
+        }
+        // pa 释放时结束 chunked 响应
+    }
+
+    MockLlmOptions options_;
+    std::atomic<uint64_t> counter_{0};
+};
+
+// 进程内启动的模拟服务，压测程序可以直接带起来
+//   路径和 TGI 一致: /generate_stream /generate
+class MockLlmServer {
+public:
+    MockLlmServer(const MockLlmOptions& options) : service_(options) {}
+
+    ~MockLlmServer() {
+        stop();
+    }
+
+    Status start(int port) {
+        if (server_.AddService(&service_, brpc::SERVER_DOESNT_OWN_SERVICE,
+                               "/generate_stream => generate_stream, /generate => generate") != 0) {
+            return Status(-1, "fail to add mock llm service");
+        }
+        brpc::ServerOptions options;
+        if (server_.Start(port, &options) != 0) {
+            return Status(-1, "fail to start mock llm server on port %d", port);
+        }
+        started_ = true;
+        return Status::OK();
+    }
+
+    void stop() {
+        if (started_) {
+            server_.Stop(0);
+            server_.Join();
+            started_ = false;
+        }
+    }
+
+private:
+    MockLlmService service_;
+    brpc::Server server_;
+    bool started_ = false;
+};
+
+}
@@ -0,0 +1,229 @@
+#pragma once
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include "include/stream-dag.h"
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 合成节点之间传递的数据
+struct SynPayload {
+    std::string data;
+
+    size_t size() const { return data.size(); }
+
+    json to_json() const {
+        return json({{"size", data.size()}});
+    }
+};
+
+using SynStream = Stream<SynPayload>;
+
+// 合成节点的代价，由配置决定
+//   latency_us    开始时等待的时间，模拟一次远程调用
+//   cpu_us        每个元素的计算时间，忙等
+//   stream_length 没有输入时产生的元素个数
+//   payload_bytes 产生的元素大小
+// 有输入时依次读完每个输入，每个元素复制到所有输出
+// DECLARE_PARAMS 只能继承 BaseNode 的构造函数，所以这里不是 BaseNode 的子类
+class SyntheticCost {
+public:
+    Status init_cost(json& option) {
+        latency_us_ = option.value("latency_us", latency_us_);
+        cpu_us_ = option.value("cpu_us", cpu_us_);
+        stream_length_ = option.value("stream_length", stream_length_);
+        payload_bytes_ = option.value("payload_bytes", payload_bytes_);
+        return Status::OK();
+    }
+
+    Status process(const std::vector<SynStream*>& ins, const std::vector<SynStream*>& outs) {
+        if (latency_us_ > 0) {
+            bthread_usleep(latency_us_);
+        }
+        auto emit = [&](SynPayload& payload) {
+            burn(cpu_us_);
+            for (auto out : outs) {
+                SynPayload copy = payload;
+                out->append(copy);
+            }
+        };
+        if (ins.empty()) {
+            for (int64_t i = 0; i < stream_length_; i++) {
+                SynPayload payload;
+                payload.data.assign(payload_bytes_, 'x');
+                emit(payload);
+            }
+            return Status::OK();
+        }
+        for (auto in : ins) {
+            SynPayload payload;
+            while (in->read(payload).ok()) {
+                emit(payload);
+            }
+        }
+        return Status::OK();
+    }
+
+private:
+    static void burn(int64_t us) {
+        if (us <= 0) {
+            return;
+        }
+        int64_t stop = butil::gettimeofday_us() + us;
+        while (butil::gettimeofday_us() < stop) {
+        }
+    }
+
+    int64_t latency_us_ = 0;
+    int64_t cpu_us_ = 0;
+    int64_t stream_length_ = 8;
+    int64_t payload_bytes_ = 64;
+};
+
+// SYNTHETIC_NODE(类名, run 的参数列表, 输入列表, 输出列表, 端口声明...)
+// 列表里有逗号，需要用括号包起来
+#define SYNTHETIC_NODE(NAME, PARAMS, INS, OUTS, ...) \
+    class NAME : public BaseNode, public SyntheticCost { \
+    public: \
+        Status init(json& option) { return init_cost(option); } \
+        Status run PARAMS { return process(std::vector<SynStream*> INS, std::vector<SynStream*> OUTS); } \
+        DECLARE_PARAMS(__VA_ARGS__) \
+    }; \
+    REGISTER_CLASS(NAME);
+
+#define SYN_IN(i) INPUT(in##i, SynStream)
+#define SYN_OUT(i) OUTPUT(out##i, SynStream)
+
+SYNTHETIC_NODE(SynNode_0_1, (SynStream& out0), ({}), ({&out0}), SYN_OUT(0))
+SYNTHETIC_NODE(SynNode_0_2, (SynStream& out0, SynStream& out1), ({}), ({&out0, &out1}), SYN_OUT(0), SYN_OUT(1))
+SYNTHETIC_NODE(SynNode_0_3, (SynStream& out0, SynStream& out1, SynStream& out2), ({}), ({&out0, &out1, &out2}),
+               SYN_OUT(0), SYN_OUT(1), SYN_OUT(2))
+SYNTHETIC_NODE(SynNode_1_1, (SynStream& in0, SynStream& out0), ({&in0}), ({&out0}), SYN_IN(0), SYN_OUT(0))
+SYNTHETIC_NODE(SynNode_1_2, (SynStream& in0, SynStream& out0, SynStream& out1), ({&in0}), ({&out0, &out1}),
+               SYN_IN(0), SYN_OUT(0), SYN_OUT(1))
+SYNTHETIC_NODE(SynNode_1_3, (SynStream& in0, SynStream& out0, SynStream& out1, SynStream& out2), ({&in0}),
+               ({&out0, &out1, &out2}), SYN_IN(0), SYN_OUT(0), SYN_OUT(1), SYN_OUT(2))
+SYNTHETIC_NODE(SynNode_2_1, (SynStream& in0, SynStream& in1, SynStream& out0), ({&in0, &in1}), ({&out0}),
+               SYN_IN(0), SYN_IN(1), SYN_OUT(0))
+SYNTHETIC_NODE(SynNode_2_2, (SynStream& in0, SynStream& in1, SynStream& out0, SynStream& out1), ({&in0, &in1}),
+               ({&out0, &out1}), SYN_IN(0), SYN_IN(1), SYN_OUT(0), SYN_OUT(1))
+SYNTHETIC_NODE(SynNode_2_3, (SynStream& in0, SynStream& in1, SynStream& out0, SynStream& out1, SynStream& out2),
+               ({&in0, &in1}), ({&out0, &out1, &out2}), SYN_IN(0), SYN_IN(1), SYN_OUT(0), SYN_OUT(1), SYN_OUT(2))
+SYNTHETIC_NODE(SynNode_3_1, (SynStream& in0, SynStream& in1, SynStream& in2, SynStream& out0), ({&in0, &in1, &in2}),
+               ({&out0}), SYN_IN(0), SYN_IN(1), SYN_IN(2), SYN_OUT(0))
+SYNTHETIC_NODE(SynNode_3_2, (SynStream& in0, SynStream& in1, SynStream& in2, SynStream& out0, SynStream& out1),
+               ({&in0, &in1, &in2}), ({&out0, &out1}), SYN_IN(0), SYN_IN(1), SYN_IN(2), SYN_OUT(0), SYN_OUT(1))
+SYNTHETIC_NODE(SynNode_3_3, (SynStream& in0, SynStream& in1, SynStream& in2, SynStream& out0, SynStream& out1, SynStream& out2),
+               ({&in0, &in1, &in2}), ({&out0, &out1, &out2}),
+               SYN_IN(0), SYN_IN(1), SYN_IN(2), SYN_OUT(0), SYN_OUT(1), SYN_OUT(2))
+
+static constexpr int kSynMaxFan = 3;
+
+// k 个输入 m 个输出的合成节点类型名
+inline std::string synthetic_type(int k, int m) {
+    static const std::string types[kSynMaxFan + 1][kSynMaxFan + 1] = {
+        {"", typeid(SynNode_0_1).name(), typeid(SynNode_0_2).name(), typeid(SynNode_0_3).name()},
+        {"", typeid(SynNode_1_1).name(), typeid(SynNode_1_2).name(), typeid(SynNode_1_3).name()},
+        {"", typeid(SynNode_2_1).name(), typeid(SynNode_2_2).name(), typeid(SynNode_2_3).name()},
+        {"", typeid(SynNode_3_1).name(), typeid(SynNode_3_2).name(), typeid(SynNode_3_3).name()},
+    };
+    return types[k][m];
+}
+
+// 合成图的形状
+//   分 depth 层，每层 width 个节点，第一层是源节点
+//   random 为 true 时每个节点的入度、出度在 [1, max] 里随机，否则都取 max. max 在 [1, kSynMaxFan] 里，超出时报错
+//   cpu_us、latency_us 是平均值，每个节点的值按 cost_distribution 抽取:
+//     fixed       都取平均值
+//     uniform     [0, 2 * 平均值] 均匀分布
+//     exponential 指数分布，少数节点很慢
+//   每个输出只能连一个输入，可用的输出不够时入度会变小；没有被连接的输出留在流里
+//   最后一层的输出标记为 sink
+struct GraphShape {
+    int width = 10;
+    int depth = 5;
+    int fan_in = 2;
+    int fan_out = 2;
+    bool random = true;
+    int64_t stream_length = 8;
+    int64_t payload_bytes = 64;
+    int64_t cpu_us = 0;
+    int64_t latency_us = 0;
+    std::string cost_distribution = "fixed";
+    uint64_t seed = 1;
+};
+
+// 生成 StreamGraph::load 可以加载的图
+inline Status generate_graph(const GraphShape& shape, json* out) {
+    if (shape.fan_in < 1 || shape.fan_in > kSynMaxFan || shape.fan_out < 1 || shape.fan_out > kSynMaxFan) {
+        return Status(-1, "fan_in %d / fan_out %d out of [1, %d]", shape.fan_in, shape.fan_out, kSynMaxFan);
+    }
+    const std::string& dist = shape.cost_distribution;
+    if (dist != "fixed" && dist != "uniform" && dist != "exponential") {
+        return Status(-1, "unknown cost_distribution %s", dist.c_str());
+    }
+    std::mt19937_64 rng(shape.seed);
+    auto uniform = [&](int lo, int hi) {
+        return std::uniform_int_distribution<int>(lo, hi)(rng);
+    };
+    auto draw_cost = [&](int64_t mean) -> int64_t {
+        if (mean <= 0 || dist == "fixed") {
+            return mean;
+        }
+        if (dist == "uniform") {
+            return std::uniform_int_distribution<int64_t>(0, 2 * mean)(rng);
+        }
+        return std::llround(std::exponential_distribution<double>(1.0 / mean)(rng));
+    };
+    int max_in = shape.fan_in;
+    int max_out = shape.fan_out;
+
+    json& graph = *out;
+    graph = json::object();
+    graph["name"] = "synthetic";
+    graph["nodes"] = json::array();
+    graph["edges"] = json::array();
+    graph["sinks"] = json::array();
+
+    // 没有被连接的输出，previous 是上一层的
+    std::vector<std::string> previous, older;
+    for (int layer = 0; layer < shape.depth; layer++) {
+        std::vector<std::string> current;
+        for (int w = 0; w < shape.width; w++) {
+            std::string name = "n" + std::to_string(layer) + "_" + std::to_string(w);
+            int available = previous.size() + older.size();
+            int k = layer == 0 ? 0 : std::min(shape.random ? uniform(1, max_in) : max_in, available);
+            int m = shape.random ? uniform(1, max_out) : max_out;
+
+            for (int i = 0; i < k; i++) {
+                // 优先连上一层，保证图的深度
+                auto& pool = previous.empty() ? older : previous;
+                int index = uniform(0, pool.size() - 1);
+                graph["edges"].push_back({{"from", pool[index]}, {"to", name + "/in" + std::to_string(i)}});
+                pool[index] = pool.back();
+                pool.pop_back();
+            }
+            for (int j = 0; j < m; j++) {
+                current.push_back(name + "/out" + std::to_string(j));
+            }
+            json option = {
+                {"cpu_us", draw_cost(shape.cpu_us)},
+                {"latency_us", draw_cost(shape.latency_us)},
+                {"stream_length", shape.stream_length},
+                {"payload_bytes", shape.payload_bytes},
+            };
+            graph["nodes"].push_back({{"name", name}, {"type", synthetic_type(k, m)}, {"option", option}});
+        }
+        older.insert(older.end(), previous.begin(), previous.end());
+        previous = std::move(current);
+    }
+    for (auto& sink : previous) {
+        graph["sinks"].push_back(sink);
+    }
+    return Status::OK();
+}
+
+}
@@ -15,6 +15,9 @@
 #include "safety.h"
 #include "llm_model.h"
 #include "output.h"
+#include "bench/load_generator.h"
+#include "include/graph_registry.h"
+#include <thread>
 
 DEFINE_string(input, "", "input file");
 DEFINE_int64(loop_cnt, 1000, "loop count");
@@ -27,6 +30,16 @@ DEFINE_bool(both_run, false, "  创建图并运行");
 
 DEFINE_bool(paralize_exe, true, " 多个图并行执行");
 
+DEFINE_bool(open_loop, false, " 开环压测，按固定到达率发请求");
+DEFINE_double(qps, 1000, " 开环压测的到达率");
+DEFINE_bool(poisson, true, " 到达间隔服从指数分布，false 时固定间隔");
+DEFINE_int64(duration_ms, 10000, " 每一档的发压时长");
+DEFINE_bool(sweep, false, " 从 qps 开始逐档加压，找饱和拐点");
+DEFINE_double(sweep_max_qps, 1000000, " 加压的上限");
+DEFINE_double(sweep_step, 1.5, " 每一档乘以的倍数");
+DEFINE_double(knee_factor, 3, " p99 超过第一档的这么多倍认为饱和");
+DEFINE_int64(reload_ms, 0, " 开环压测时每隔这么久重新发布一次图，看热更新对时延的影响. 0 不更新");
+
 using namespace stream_dag;
 using json = nlohmann::json;
 
@@ -105,6 +118,7 @@ int only_excute() {
     g.add_edge(split->out2, model_node->req);
     g.add_edge(safe_node->out, output_node->presafety);
     g.add_edge(model_node->rsp, output_node->llm_stream);
+    g.mark_sink(output_node->out);
     // g.dump("./graph.json");
     // g2.load("./graph.json");
 
@@ -112,6 +126,7 @@ int only_excute() {
 
     auto t1 = std::chrono::high_resolution_clock::now();
 
+    int64_t ttft_sum = 0, ttft_cnt = 0, itl_p99_max = 0;
     for (int i = 0; i < FLAGS_loop_cnt; i++) {
         BaseContext ctx;
         ctx.enable_trace(FLAGS_trace);
@@ -120,6 +135,13 @@ int only_excute() {
             printf("run err: %s\n", status.error_cstr());
             return -1;
         }
+        // 没有输出 token 的请求 ttft 是 -1，不算在平均里
+        int64_t ttft = ctx.latency().ttft_us();
+        if (ttft >= 0) {
+            ttft_sum += ttft;
+            ttft_cnt++;
+        }
+        itl_p99_max = std::max(itl_p99_max, ctx.latency().itl_percentile(0.99));
         // if (FLAGS_dump) {
         //     ctx.dump(fmt::format("running-{}.json", i));
         // }
@@ -129,6 +151,7 @@ int only_excute() {
     auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
     std::chrono::duration<double, std::milli> ms_double = t2 - t1;
     printf("run fin %s cost %ldns %lfms \n", "ok", cost, ms_double);
+    printf("ttft avg %ldus over %ld requests, itl p99 max %ldus\n", ttft_sum / std::max<int64_t>(ttft_cnt, 1), ttft_cnt, itl_p99_max);
     return 0;
 }
 
@@ -215,8 +238,98 @@ int paralize_exe() {
     return 0;
 }
 
+int open_loop() {
+    StreamGraph g;
+    Source* source = g.add_node<Source>("source_node");
+    Split* split = g.add_node<Split>("split_node");
+    PreSafety* safe_node = g.add_node<PreSafety>("safe_node");
+    LLMModel* model_node = g.add_node<LLMModel>("model_node");
+    OutputNode* output_node = g.add_node<OutputNode>("output_node");
+    g.add_edge(source->input, split->in);
+    g.add_edge(split->out1, safe_node->start);
+    g.add_edge(split->out2, model_node->req);
+    g.add_edge(safe_node->out, output_node->presafety);
+    g.add_edge(model_node->rsp, output_node->llm_stream);
+    g.mark_sink(output_node->out);
+
+    // 热更新: 请求从注册表取当前版本，后台线程定期重新发布，发布之间只有 safe_node 的配置变化
+    GraphRegistry& registry = GraphRegistry::instance();
+    std::atomic<bool> reloading{FLAGS_reload_ms > 0};
+    std::thread reloader;
+    if (FLAGS_reload_ms > 0) {
+        json definition = g.to_json();
+        // 和不热更新时执行的图一样，不做 finalize 优化
+        GraphOptimizeOptions options;
+        options.eliminate_dead_nodes = false;
+        options.discard_unused_outputs = false;
+        Status status = registry.publish("open_loop", definition, options);
+        if (!status.ok()) {
+            printf("publish err: %s\n", status.error_cstr());
+            return -1;
+        }
+        reloader = std::thread([&reloading, &registry, definition, options] () mutable {
+            for (int64_t round = 1; reloading.load(); round++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_reload_ms));
+                for (auto& node : definition["nodes"]) {
+                    if (node["name"] == "safe_node") {
+                        node["option"]["reload_round"] = round;
+                    }
+                }
+                Status status = registry.publish("open_loop", definition, options);
+                if (!status.ok()) {
+                    printf("reload round %ld err: %s\n", round, status.error_cstr());
+                }
+            }
+        });
+    }
+
+    LoadGenerator generator([&g, &registry](BaseContext& ctx) {
+        ctx.enable_trace(FLAGS_trace);
+        BthreadExecutor executor;
+        if (FLAGS_reload_ms > 0) {
+            auto version = registry.get("open_loop");
+            return executor.run(version->graph(), ctx);
+        }
+        return executor.run(g, ctx);
+    });
+    struct StopReload {
+        std::atomic<bool>& reloading;
+        std::thread& reloader;
+        ~StopReload() {
+            reloading = false;
+            if (reloader.joinable()) {
+                reloader.join();
+            }
+        }
+    } stop_reload{reloading, reloader};
+
+    LoadOptions options;
+    options.qps = FLAGS_qps;
+    options.poisson = FLAGS_poisson;
+    options.duration_ms = FLAGS_duration_ms;
+
+    if (!FLAGS_sweep) {
+        LoadResult result = generator.run(options);
+        printf("%s\n", result.to_json().dump(4).c_str());
+        return 0;
+    }
+
+    int knee = -1;
+    auto results = generator.sweep(options, FLAGS_qps, FLAGS_sweep_max_qps, FLAGS_sweep_step, FLAGS_knee_factor, &knee);
+    json report;
+    for (auto& result : results) {
+        report["levels"].push_back(result.to_json());
+    }
+    report["knee_qps"] = knee >= 0 ? results[knee].offered_qps : 0;
+    printf("%s\n", report.dump(4).c_str());
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, true);
+    if (FLAGS_open_loop) {
+        return open_loop();
+    }
     if (FLAGS_both_run) {
         return both_run();
     }
@@ -0,0 +1,210 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "bthread/execution_queue.h"
+#include "stream-dag.h"
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+struct ActorOptions {
+    int workers = 1;        // 常驻 worker 数
+    size_t max_batch = 16;  // 一次交给 process 的元素数上限
+
+    static ActorOptions from_json(const json& option) {
+        ActorOptions opt;
+        opt.workers = std::max(option.value("workers", opt.workers), 1);
+        opt.max_batch = std::max<size_t>(option.value("max_batch", opt.max_batch), 1);
+        return opt;
+    }
+};
+
+// 一个请求在 actor 上的会话，在代理节点的栈上. 这个请求的元素都处理完之前代理节点不返回
+template<class Out>
+class ActorSession {
+public:
+    ActorSession(uint64_t id, Stream<Out>& out) : id_(id), out_(out) {}
+
+    uint64_t id() const { return id_; }
+    Stream<Out>& out() { return out_; }
+    BaseContext& context() { return out_.context(); }
+
+    void submit() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        pending_++;
+    }
+
+    void done(const Status& status) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (status_.ok() && !status.ok()) {
+            status_ = status;
+        }
+        if (--pending_ == 0) {
+            cond_.notify_all();
+        }
+    }
+
+    // 返回第一个失败元素的状态
+    Status wait() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        while (pending_ > 0) {
+            cond_.wait(lock_);
+        }
+        return status_;
+    }
+
+private:
+    uint64_t id_;
+    Stream<Out>& out_;
+    bthread::Mutex mutex_;
+    bthread::ConditionVariable cond_;
+    int pending_ = 0;
+    Status status_;
+};
+
+// mailbox 里的一个元素，带着它所属的请求
+template<class In, class Out>
+class ActorItem {
+public:
+    ActorItem() = default;
+    ActorItem(In&& input, ActorSession<Out>* session) : input_(std::move(input)), session_(session) {}
+
+    In& input() { return input_; }
+    uint64_t request_id() const { return session_->id(); }
+    BaseContext& context() { return session_->context(); }
+
+    // 给所属请求的输出流写一个元素，可以调用多次
+    Status reply(Out& value) { return session_->out().append(value); }
+    Status reply(Out&& value) { return session_->out().append(std::move(value)); }
+
+    // 这个元素处理失败，代理节点返回第一个失败的状态
+    void fail(const Status& status) { status_ = status; }
+
+private:
+    template<class, class> friend class ActorNode;
+
+    void finish(const Status& batch_status) {
+        session_->done(status_.ok() ? batch_status : status_);
+    }
+
+    In input_;
+    ActorSession<Out>* session_ = nullptr;
+    Status status_;
+};
+
+// 常驻的 actor 节点
+//   普通节点每个请求在自己的 bthread 里执行一次 run，有状态的节点（tokenizer、本地模型、长连接）每次都是冷的
+//   actor 节点的元素交给常驻 worker 处理，每个 worker 一个 mailbox（bthread::ExecutionQueue），在所有请求间共用
+//   worker 每次从 mailbox 取出最多 max_batch 个元素交给 process，元素可以来自不同请求，天然跨请求攒批
+//   图里的 run 只是代理: 读输入发给 worker，worker 用 reply 写回这个请求的输出流，全部处理完后返回
+//   同一个请求的元素发给同一个 worker，按输入顺序处理. 同一个 worker 上的 process 不会并发，workers > 1 时不同 worker 并发
+//
+//   class Tokenizer : public ActorNode<std::string, Tokens> {
+//   public:
+//       using ActorNode::ActorNode;
+//       Status process(std::vector<Item>& batch) {
+//           for (auto& item : batch) {
+//               item.reply(encode(item.input()));
+//           }
+//           return Status::OK();
+//       }
+//   };
+//   REGISTER_CLASS(Tokenizer);
+// 配置: workers / max_batch
+template<class In, class Out>
+class ActorNode : public BaseNode {
+public:
+    using Item = ActorItem<In, Out>;
+
+    ~ActorNode() {
+        for (auto& queue : queues_) {
+            bthread::execution_queue_stop(queue);
+            bthread::execution_queue_join(queue);
+        }
+    }
+
+    // 处理一批元素. 返回失败时这一批里没有单独 fail 的元素都按这个状态失败
+    virtual Status process(std::vector<Item>& batch) = 0;
+
+    Status run(Stream<In>& in, Stream<Out>& out) {
+        std::call_once(start_once_, [this] { start_status_ = start(); });
+        if (!start_status_.ok()) {
+            return start_status_;
+        }
+        ActorSession<Out> session(next_id_.fetch_add(1, std::memory_order_relaxed), out);
+        auto queue = queues_[session.id() % queues_.size()];
+        In value;
+        while (!session.context().is_cancelled() && in.read(value).ok()) {
+            session.submit();
+            if (bthread::execution_queue_execute(queue, Item(std::move(value), &session)) != 0) {
+                session.done(Status(-1, "actor %s stopped", name().c_str()));
+                break;
+            }
+        }
+        return session.wait();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<In>),
+        OUTPUT(out, Stream<Out>),
+    );
+
+    const ActorOptions& actor_options() const { return opt_; }
+
+private:
+    // 第一个请求到来时按节点配置启动 worker，之后一直运行到节点析构
+    Status start() {
+        opt_ = ActorOptions::from_json(option());
+        for (int i = 0; i < opt_.workers; i++) {
+            bthread::ExecutionQueueId<Item> queue;
+            bthread::ExecutionQueueOptions options;
+            if (bthread::execution_queue_start(&queue, &options, &ActorNode::drain, this) != 0) {
+                return Status(-1, "actor %s start worker failed", name().c_str());
+            }
+            queues_.push_back(queue);
+        }
+        return Status::OK();
+    }
+
+    static int drain(void* meta, bthread::TaskIterator<Item>& iter) {
+        if (iter.is_queue_stopped()) {
+            return 0;
+        }
+        auto* self = static_cast<ActorNode*>(meta);
+        std::vector<Item> batch;
+        batch.reserve(self->opt_.max_batch);
+        for (; iter; ++iter) {
+            // 已经取消的请求不再处理
+            if (iter->context().is_cancelled()) {
+                iter->finish(Status::OK());
+                continue;
+            }
+            batch.push_back(std::move(*iter));
+            if (batch.size() >= self->opt_.max_batch) {
+                self->flush(batch);
+            }
+        }
+        if (!batch.empty()) {
+            self->flush(batch);
+        }
+        return 0;
+    }
+
+    void flush(std::vector<Item>& batch) {
+        Status status = process(batch);
+        for (auto& item : batch) {
+            item.finish(status);
+        }
+        batch.clear();
+    }
+
+    ActorOptions opt_;
+    std::once_flag start_once_;
+    Status start_status_;
+    std::vector<bthread::ExecutionQueueId<Item>> queues_;
+    std::atomic<uint64_t> next_id_{0};
+};
+
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "butil/status.h"
+#include "bthread/mutex.h"
+
+namespace stream_dag {
+
+using Status = butil::Status;
+
+// 多模式匹配自动机
+//   1. 按字节匹配。UTF-8 是自同步编码，合法的模式串不会在字符中间匹配上，不需要解码
+//   2. ignore_case 只折叠 ASCII 大小写，多字节字符的字节都 >= 0x80 不受影响
+//   3. 状态是一个 int32，流式匹配时由调用方在元素之间保存，模式可以跨元素
+//   4. 构建后只读，多个请求可以并发使用同一个实例
+class AhoCorasick {
+public:
+    static constexpr int32_t kRoot = 0;
+
+    AhoCorasick(const std::vector<std::string>& patterns, bool ignore_case=false) : ignore_case_(ignore_case) {
+        build(patterns);
+    }
+
+    // 从 state 开始扫描 [data, data+length)，每个命中回调 on_match(pattern_id)，返回新的状态
+    // on_match 返回 false 时停止扫描
+    template<class Callback>
+    int32_t scan(int32_t state, const char* data, size_t length, Callback&& on_match) const {
+        const uint8_t* p = (const uint8_t*) data;
+        const uint8_t* end = p + length;
+        for (; p < end; ++p) {
+            state = next(state, fold(*p));
+            for (int32_t s = output_state(state); s != kRoot; s = dict_link_[s]) {
+                if (!on_match(output_[s])) {
+                    return state;
+                }
+            }
+        }
+        return state;
+    }
+
+    // 当前状态对应的已匹配前缀长度。流式输出时最后这么多字节可能是某个模式的开头
+    int32_t depth(int32_t state) const { return depth_[state]; }
+
+    const std::string& pattern(int32_t id) const { return patterns_[id]; }
+    size_t pattern_size() const { return patterns_.size(); }
+    size_t state_size() const { return fail_.size(); }
+
+private:
+    uint8_t fold(uint8_t c) const {
+        return (ignore_case_ && c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+
+    int32_t goto_state(int32_t state, uint8_t c) const {
+        auto begin = edge_label_.begin() + edge_begin_[state];
+        auto end = edge_label_.begin() + edge_begin_[state + 1];
+        auto it = std::lower_bound(begin, end, c);
+        if (it != end && *it == c) {
+            return edge_target_[it - edge_label_.begin()];
+        }
+        return -1;
+    }
+
+    int32_t next(int32_t state, uint8_t c) const {
+        while (state != kRoot) {
+            int32_t target = goto_state(state, c);
+            if (target >= 0) {
+                return target;
+            }
+            state = fail_[state];
+        }
+        return root_next_[c];
+    }
+
+    // state 自己或者 fail 链上第一个有输出的状态
+    int32_t output_state(int32_t state) const {
+        return output_[state] >= 0 ? state : dict_link_[state];
+    }
+
+    void build(const std::vector<std::string>& patterns) {
+        // 1. 构建 trie. 构建期用 map，构建完压缩成 CSR
+        std::vector<std::map<uint8_t, int32_t>> trie(1);
+        depth_.assign(1, 0);
+        output_.assign(1, -1);
+        for (auto& pattern : patterns) {
+            if (pattern.empty()) {
+                continue;
+            }
+            int32_t state = kRoot;
+            for (char ch : pattern) {
+                uint8_t c = fold((uint8_t) ch);
+                auto it = trie[state].find(c);
+                if (it == trie[state].end()) {
+                    int32_t id = (int32_t) trie.size();
+                    trie[state][c] = id;
+                    trie.emplace_back();
+                    depth_.push_back(depth_[state] + 1);
+                    output_.push_back(-1);
+                    state = id;
+                } else {
+                    state = it->second;
+                }
+            }
+            if (output_[state] < 0) {
+                output_[state] = (int32_t) patterns_.size();
+                patterns_.push_back(pattern);
+            }
+        }
+
+        size_t n = trie.size();
+        edge_begin_.assign(n + 1, 0);
+        for (size_t s = 0; s < n; s++) {
+            edge_begin_[s + 1] = edge_begin_[s] + (int32_t) trie[s].size();
+            for (auto& [c, target] : trie[s]) {
+                edge_label_.push_back(c);
+                edge_target_.push_back(target);
+            }
+        }
+
+        // 2. BFS 计算 fail 和输出链
+        fail_.assign(n, kRoot);
+        dict_link_.assign(n, kRoot);
+        std::fill(std::begin(root_next_), std::end(root_next_), kRoot);
+        std::deque<int32_t> queue;
+        for (auto& [c, target] : trie[kRoot]) {
+            root_next_[c] = target;
+            queue.push_back(target);
+        }
+        while (!queue.empty()) {
+            int32_t state = queue.front();
+            queue.pop_front();
+            for (auto& [c, target] : trie[state]) {
+                int32_t fail = next(fail_[state], c);
+                fail_[target] = fail;
+                dict_link_[target] = output_[fail] >= 0 ? fail : dict_link_[fail];
+                queue.push_back(target);
+            }
+        }
+    }
+
+    bool ignore_case_ = false;
+    std::vector<std::string> patterns_;
+
+    int32_t root_next_[256];
+    std::vector<int32_t> edge_begin_;
+    std::vector<uint8_t> edge_label_;
+    std::vector<int32_t> edge_target_;
+    std::vector<int32_t> fail_;
+    std::vector<int32_t> dict_link_;
+    std::vector<int32_t> output_;
+    std::vector<int32_t> depth_;
+};
+
+// 进程级的词表注册表，支持热更新
+//   新词表在调用方线程构建好之后原子替换，不阻塞正在匹配的请求
+//   每个请求开始时取一次快照，请求内的状态始终对应同一个自动机
+class SafetyDictionary {
+public:
+    static std::shared_ptr<const AhoCorasick> get(const std::string& name) {
+        auto* slot = find(name);
+        if (slot == nullptr) {
+            return nullptr;
+        }
+        return std::atomic_load(slot);
+    }
+
+    static void update(const std::string& name, const std::vector<std::string>& patterns, bool ignore_case=false) {
+        auto automaton = std::make_shared<const AhoCorasick>(patterns, ignore_case);
+        std::atomic_store(slot(name), automaton);
+    }
+
+    // 每行一个词
+    static Status load(const std::string& name, const std::string& path, bool ignore_case=false) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            return Status(-1, "open file failed");
+        }
+        std::vector<std::string> patterns;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                patterns.push_back(line);
+            }
+        }
+        update(name, patterns, ignore_case);
+        return Status::OK();
+    }
+
+private:
+    using Slot = std::shared_ptr<const AhoCorasick>;
+
+    // slot 创建后不会删除，指针一直有效
+    static Slot* slot(const std::string& name) {
+        std::unique_lock<bthread::Mutex> lock_(mutex());
+        return &registry()[name];
+    }
+
+    static Slot* find(const std::string& name) {
+        std::unique_lock<bthread::Mutex> lock_(mutex());
+        auto it = registry().find(name);
+        return it == registry().end() ? nullptr : &it->second;
+    }
+
+    static std::map<std::string, Slot>& registry() {
+        static std::map<std::string, Slot> registry;
+        return registry;
+    }
+
+    static bthread::Mutex& mutex() {
+        static bthread::Mutex mutex;
+        return mutex;
+    }
+};
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include "bthread/mutex.h"
+
+namespace stream_dag {
+
+// 请求级内存池，由 BaseContext 持有
+//   ctx 的表、流对象、流的缓冲区都从这里分配，请求结束时一次释放
+//   先用 ctx 里的内联缓冲区，不够时按块向堆申请；释放的内存由 pool 复用，例如 vector 扩容
+//   节点在不同 bthread 里并发读写流，所以分配需要加锁；锁只在一个请求内竞争，不和其它请求争用全局堆
+class RequestArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kInlineBytes = 4096;
+
+    RequestArena()
+        : upstream_(this),
+          monotonic_(inline_, sizeof(inline_), &upstream_),
+          pool_(&monotonic_) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    // 关闭后所有分配直接走堆，用来对比分配次数. 只影响之后创建的 ctx
+    static void enable(bool enable) { enabled_flag().store(enable, std::memory_order_relaxed); }
+    static bool is_enabled() { return enabled_flag().load(std::memory_order_relaxed); }
+
+    // 从 arena 分配的次数
+    int64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+    // 实际向堆申请的次数. 关闭 arena 时等于 allocations
+    int64_t heap_allocations() const { return heap_allocations_.load(std::memory_order_relaxed); }
+    int64_t heap_bytes() const { return heap_bytes_.load(std::memory_order_relaxed); }
+
+    // 复用 ctx 时清零计数，已经分配的内存保留给下一个请求
+    void reset_counters() {
+        allocations_.store(0, std::memory_order_relaxed);
+        heap_allocations_.store(0, std::memory_order_relaxed);
+        heap_bytes_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    // 统计向堆申请的次数
+    class Upstream : public std::pmr::memory_resource {
+    public:
+        Upstream(RequestArena* arena) : arena_(arena) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            arena_->heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+            arena_->heap_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        RequestArena* arena_;
+    };
+
+    static std::atomic<bool>& enabled_flag() {
+        static std::atomic<bool> enabled{true};
+        return enabled;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        if (!enabled_) {
+            return upstream_.allocate(bytes, alignment);
+        }
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return pool_.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        if (!enabled_) {
+            return upstream_.deallocate(p, bytes, alignment);
+        }
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        pool_.deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    const bool enabled_ = is_enabled();
+    std::atomic<int64_t> allocations_{0};
+    std::atomic<int64_t> heap_allocations_{0};
+    std::atomic<int64_t> heap_bytes_{0};
+
+    bthread::Mutex mutex_;
+    alignas(std::max_align_t) char inline_[kInlineBytes];
+    Upstream upstream_;
+    std::pmr::monotonic_buffer_resource monotonic_;
+    std::pmr::unsynchronized_pool_resource pool_;
+};
+
+// 在 arena 上创建对象，控制块和对象在同一次分配里
+template<class T, class... Args>
+std::shared_ptr<T> arena_make_shared(std::pmr::memory_resource* arena, Args&&... args) {
+    return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(arena), std::forward<Args>(args)...);
+}
+
+}
@@ -33,6 +33,15 @@ public:
         bthread_start_background(&bthid_, nullptr, call_back, (void*)p_wrap_fn);
     }
 
+    // 不需要闭包时用这个，不分配内存. 启动失败时 get_tid() 是 INVALID_BTHREAD
+    static BThread start(void* (*fn)(void*), void* arg, const bthread_attr_t* attr = nullptr) {
+        BThread thread;
+        if (bthread_start_background(&thread.bthid_, attr, fn, arg) != 0) {
+            thread.bthid_ = INVALID_BTHREAD;
+        }
+        return thread;
+    }
+
     int join() {
         if (bthid_ != INVALID_BTHREAD) {
             return bthread_join(bthid_, NULL);
@@ -0,0 +1,220 @@
+#pragma once
+#include <deque>
+#include <iterator>
+#include "stream.h"
+#include "butil/iobuf.h"
+#include <nlohmann/json.hpp>
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 按 IOBuf block 遍历字节的只读迭代器，用来在 IOBuf 的分段上直接解析，不需要拼成连续内存
+class IOBufIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    IOBufIterator() = default;
+    IOBufIterator(const butil::IOBuf& buf, bool end=false) : buf_(&buf) {
+        block_num_ = buf.backing_block_num();
+        block_ = end ? block_num_ : 0;
+        load_block();
+    }
+
+    reference operator*() const { return data_[offset_]; }
+    pointer operator->() const { return data_ + offset_; }
+
+    IOBufIterator& operator++() {
+        offset_ += 1;
+        if (offset_ >= size_) {
+            block_ += 1;
+            load_block();
+        }
+        return *this;
+    }
+
+    IOBufIterator operator++(int) {
+        IOBufIterator it = *this;
+        ++(*this);
+        return it;
+    }
+
+    bool operator==(const IOBufIterator& other) const {
+        return block_ == other.block_ && offset_ == other.offset_;
+    }
+    bool operator!=(const IOBufIterator& other) const { return !(*this == other); }
+
+private:
+    // 跳过空 block，停在下一个有数据的 block 或者 end
+    void load_block() {
+        offset_ = 0;
+        for (; block_ < block_num_; block_++) {
+            butil::StringPiece piece = buf_->backing_block(block_);
+            if (!piece.empty()) {
+                data_ = piece.data();
+                size_ = piece.size();
+                return;
+            }
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const butil::IOBuf* buf_ = nullptr;
+    size_t block_num_ = 0;
+    size_t block_ = 0;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+};
+
+inline IOBufIterator iobuf_begin(const butil::IOBuf& buf) { return IOBufIterator(buf); }
+inline IOBufIterator iobuf_end(const butil::IOBuf& buf) { return IOBufIterator(buf, true); }
+
+// 直接在 IOBuf 的分段上解析 json，失败返回 discarded
+inline json parse_json(const butil::IOBuf& buf) {
+    return json::parse(iobuf_begin(buf), iobuf_end(buf), nullptr, false);
+}
+
+inline json to_json(const butil::IOBuf& buf) {
+    return json({{"size", buf.size()}});
+}
+
+// 字节流。每个元素是一个 IOBuf，只持有 block 的引用
+//   append(IOBuf) 和 read(IOBuf) 都只增加 block 的引用计数，不拷贝数据
+//   和 PipeStream 一样是单读者，支持 half_close 之后把剩余数据读完
+class ByteStream : public PipeStreamBase {
+public:
+    // chunk 队列从 ctx 的 arena 分配
+    ByteStream(BaseContext& ctx, const std::string& name, const std::string& type)
+        : PipeStreamBase(ctx, name, type), chunks_(&ctx.arena()) {}
+
+    Status append(butil::IOBuf&& data) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (discard_) {
+            return Status::OK();
+        }
+        if (ctx_.trace_enabled()) {
+            trace("ByteStream::append", to_json(data));
+        }
+        bytes_ += data.size();
+        record_append(data.size());
+        chunks_.emplace_back();
+        chunks_.back().swap(data);
+        cond_.notify_one();
+        lock_.unlock();
+        return Status::OK();
+    }
+
+    Status append(const butil::IOBuf& data) {
+        butil::IOBuf ref = data;
+        return append(std::move(ref));
+    }
+
+    // 外部内存只能拷贝一次进 IOBuf 的 block
+    Status append(const void* data, size_t length) {
+        butil::IOBuf buf;
+        buf.append(data, length);
+        return append(std::move(buf));
+    }
+
+    Status append(const std::string& data) {
+        return append(data.data(), data.size());
+    }
+
+    // 读一个 chunk
+    Status read(butil::IOBuf& result) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        Status status = wait_locked(lock_);
+        if (!status.ok()) {
+            return status;
+        }
+        trace("ByteStream::read buf", json());
+        result.clear();
+        result.swap(chunks_.front());
+        chunks_.pop_front();
+        record_read();
+        return Status::OK();
+    }
+
+    // 读完整个流，chunk 按顺序拼接到 result 上。只拼 block 引用
+    Status read_all(butil::IOBuf& result) {
+        while (true) {
+            butil::IOBuf chunk;
+            Status status = read(chunk);
+            if (status.error_code() == 1) {
+                return Status::OK();
+            }
+            if (!status.ok()) {
+                return status;
+            }
+            result.append(std::move(chunk));
+        }
+    }
+
+    std::tuple<Status, butil::IOBuf> read() {
+        butil::IOBuf result;
+        auto status = read(result);
+        return {status, result};
+    }
+
+    Status wait() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return wait_locked(lock_);
+    }
+
+    bool has_data() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return !chunks_.empty();
+    }
+
+    bool readable() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return !chunks_.empty() || (!closed_ && !half_closed_);
+    }
+
+    // 累计写入的字节数
+    size_t bytes() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return bytes_;
+    }
+
+private:
+    size_t pending_locked() const { return chunks_.size(); }
+
+    void reset_locked() {
+        chunks_.clear();
+        bytes_ = 0;
+    }
+
+    Status wait_locked(std::unique_lock<bthread::Mutex>& lock_) {
+        BlockedScope blocked(name_, chunks_.empty() && !closed_ && !half_closed_);
+        while (chunks_.empty() && !closed_ && !half_closed_) {
+            trace("ByteStream::read wait", json());
+            int rc = cond_.wait_for(lock_, 1000000);
+            if (rc == ETIMEDOUT) {
+                continue;
+            }
+            if (rc != 0) {
+                return Status(-1, "ByteStream::read wait %s", berror(rc));
+            }
+            trace("ByteStream::read wake", ctx_.trace_enabled() ? json({{"rc", rc}}) : json());
+        }
+        if (!chunks_.empty()) {
+            return Status::OK();
+        }
+        if (closed_) {
+            return Status(2, "ByteStream::read closed");
+        }
+        return Status(1, "ByteStream::read half_closed");
+    }
+
+    std::pmr::deque<butil::IOBuf> chunks_;
+    size_t bytes_ = 0;
+};
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "butil/status.h"
+#include "bthread/bthread.h"
+#include "bthread/mutex.h"
+#include <brpc/channel.h>
+#include <nlohmann/json.hpp>
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+using Status = butil::Status;
+
+// 一个 channel 的完整配置。相同配置的 HttpNode 共享同一个 brpc::Channel
+struct ChannelKey {
+    std::string host;
+    std::string lb;
+    std::string protocol = "http";
+    std::string connection_type = "pooled"; // single / pooled / short
+    std::string connection_group;           // 同 host 需要隔离连接时使用
+    int timeout_ms = 20000;
+    int connect_timeout_ms = 200;
+    int max_retry = 3;
+
+    static ChannelKey from_json(const json& option) {
+        ChannelKey key;
+        key.host = option.value("host", "https://api.bing.microsoft.com");
+        key.lb = option.value("lb", "");
+        key.protocol = option.value("protocol", "http");
+        key.connection_type = option.value("connection_type", "pooled");
+        key.connection_group = option.value("connection_group", "");
+        key.timeout_ms = option.value("timeout_ms", 20000);
+        key.connect_timeout_ms = option.value("connect_timeout_ms", 200);
+        key.max_retry = option.value("max_retry", 3);
+        return key;
+    }
+
+    std::string to_string() const {
+        return host + "|" + lb + "|" + protocol + "|" + connection_type + "|" + connection_group + "|"
+            + std::to_string(timeout_ms) + "|" + std::to_string(connect_timeout_ms) + "|" + std::to_string(max_retry);
+    }
+
+    json to_json() const {
+        return json({
+            {"host", host},
+            {"lb", lb},
+            {"protocol", protocol},
+            {"connection_type", connection_type},
+            {"connection_group", connection_group},
+            {"timeout_ms", timeout_ms},
+            {"connect_timeout_ms", connect_timeout_ms},
+            {"max_retry", max_retry},
+        });
+    }
+};
+
+// 进程级的 channel 注册表
+//   1. 相同 ChannelKey 只初始化一次 channel，所有节点实例、所有请求共享连接
+//   2. 启动时通过 prewarm 提前建好 channel 和连接，请求路径上不再有连接建立
+class ChannelPool {
+public:
+    static ChannelPool& instance() {
+        static ChannelPool pool;
+        return pool;
+    }
+
+    std::shared_ptr<brpc::Channel> get(const json& option) {
+        return get(ChannelKey::from_json(option));
+    }
+
+    // 表锁只用来找到 key 对应的项，Init 在锁外执行，每个 key 只有第一个调用方 Init，同 key 的其它调用方等它完成
+    std::shared_ptr<brpc::Channel> get(const ChannelKey& key) {
+        std::string id = key.to_string();
+        std::shared_ptr<Entry> entry;
+        {
+            std::unique_lock<bthread::Mutex> lock_(mutex_);
+            auto& slot = channels_[id];
+            if (slot == nullptr) {
+                slot = std::make_shared<Entry>();
+            }
+            entry = slot;
+        }
+        std::call_once(entry->once, [&key, &entry] {
+            entry->chann = create(key);
+            entry->done.store(true, std::memory_order_release);
+        });
+        if (entry->chann == nullptr) {
+            // 失败的项删掉，下次 get 重新 Init
+            std::unique_lock<bthread::Mutex> lock_(mutex_);
+            auto it = channels_.find(id);
+            if (it != channels_.end() && it->second == entry) {
+                channels_.erase(it);
+            }
+        }
+        return entry->chann;
+    }
+
+    // 启动时预热. options 是 channel 配置数组，每一项可以带 warmup:
+    //   {"host": "http://127.0.0.1:8000", "connection_type": "pooled",
+    //    "warmup": {"path": "/health", "connections": 8}}
+    // warmup.connections 个并发请求会在连接池里留下对应数量的连接，取值限制在 [0, kMaxWarmupConnections]
+    Status prewarm(const json& options) {
+        for (auto& option : options) {
+            auto chann = get(option);
+            if (chann == nullptr) {
+                return Status(-1, "init channel failed: %s", option.dump().c_str());
+            }
+            if (!option.contains("warmup")) {
+                continue;
+            }
+            const json& warmup = option["warmup"];
+            std::string path = warmup.value("path", "/");
+            int connections = std::clamp(warmup.value("connections", 1), 0, kMaxWarmupConnections);
+            Status status = warm_connections(*chann, path, connections);
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        return Status::OK();
+    }
+
+    // brpc 连接池默认最多保留 100 条空闲连接（max_connection_pool_size），更多的并发预热请求留不下连接
+    static constexpr int kMaxWarmupConnections = 100;
+
+    size_t size() {
+        return dump().size();
+    }
+
+    // 已经初始化好的 channel，不含正在 Init 的
+    json dump() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        json result = json::array();
+        for (auto& it : channels_) {
+            if (ready(*it.second)) {
+                result.push_back(it.first);
+            }
+        }
+        return result;
+    }
+
+private:
+    ChannelPool() = default;
+
+    struct Entry {
+        std::once_flag once;
+        std::shared_ptr<brpc::Channel> chann;
+        std::atomic<bool> done{false};
+    };
+
+    static bool ready(const Entry& entry) {
+        return entry.done.load(std::memory_order_acquire) && entry.chann != nullptr;
+    }
+
+    static std::shared_ptr<brpc::Channel> create(const ChannelKey& key) {
+        brpc::ChannelOptions opt;
+        opt.protocol = key.protocol;
+        opt.connection_type = key.connection_type;
+        opt.connection_group = key.connection_group;
+        opt.connect_timeout_ms = key.connect_timeout_ms;
+        if (key.timeout_ms > 0) { opt.timeout_ms = key.timeout_ms; }
+        if (key.max_retry > 0) { opt.max_retry = key.max_retry; }
+
+        auto chann = std::make_shared<brpc::Channel>();
+        int rc = key.lb.empty() ? chann->Init(key.host.c_str(), &opt)
+                                : chann->Init(key.host.c_str(), key.lb.c_str(), &opt);
+        if (rc != 0) {
+            return nullptr;
+        }
+        return chann;
+    }
+
+    struct WarmupArgs {
+        brpc::Channel* chann;
+        std::string path;
+    };
+
+    static Status warm_connections(brpc::Channel& chann, const std::string& path, int connections) {
+        // 并发发出请求，pooled 模式下每个并发请求占用一条独立连接，结束后归还到池里
+        std::vector<bthread_t> tids(connections, INVALID_BTHREAD);
+        WarmupArgs args{&chann, path};
+        int started = 0;
+        for (; started < connections; started++) {
+            int rc = bthread_start_background(&tids[started], nullptr, [](void* arg) -> void* {
+                WarmupArgs* pargs = (WarmupArgs*) arg;
+                brpc::Controller cntl;
+                cntl.http_request().uri() = pargs->path;
+                pargs->chann->CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
+                return nullptr;
+            }, &args);
+            if (rc != 0) {
+                break;
+            }
+        }
+        // 没启动的 tid 不 join；已经启动的要等完，它们引用着栈上的 args
+        for (int i = 0; i < started; i++) {
+            bthread_join(tids[i], nullptr);
+        }
+        if (started < connections) {
+            return Status(-1, "warmup started %d of %d connections", started, connections);
+        }
+        return Status::OK();
+    }
+
+    bthread::Mutex mutex_;
+    std::map<std::string, std::shared_ptr<Entry>> channels_;
+};
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include "stream-dag.h"
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 合并规则. 默认适用于 std::string 这类有 size() 和 append() 的类型，其它类型特化这个模板
+template<class T>
+struct coalesce_traits {
+    static size_t size(const T& value) { return value.size(); }
+    static void merge(T& to, T&& from) { to.append(from); }
+};
+
+struct CoalesceOptions {
+    size_t max_bytes = 4096;       // 合并后的字节数达到上限立即输出
+    size_t max_items = 64;         // 合并的元素个数达到上限立即输出
+    int64_t max_delay_us = 20000;  // 第一个元素缓存后最多等这么久
+
+    static CoalesceOptions from_json(const json& option) {
+        CoalesceOptions opt;
+        opt.max_bytes = option.value("max_bytes", opt.max_bytes);
+        opt.max_items = option.value("max_items", opt.max_items);
+        opt.max_delay_us = option.value("max_delay_ms", opt.max_delay_us / 1000) * 1000;
+        return opt;
+    }
+};
+
+// 读端的合并适配器. 每次 read 把连续的元素合并成一个
+//   N 字节、M 个元素、第一个元素之后 T 时间，先到先输出；上游 half_close 时立即输出
+template<class T, class Traits = coalesce_traits<T>>
+class Coalescer {
+public:
+    Coalescer(Stream<T>& in, const CoalesceOptions& opt) : in_(in), opt_(opt) {}
+
+    Status read(T& result) {
+        T first;
+        Status status = in_.read(first);
+        if (!status.ok()) {
+            return status;
+        }
+        int64_t deadline_us = butil::gettimeofday_us() + opt_.max_delay_us;
+        size_t items = 1;
+        size_t bytes = Traits::size(first);
+        while (items < opt_.max_items && bytes < opt_.max_bytes) {
+            T next;
+            if (!in_.read_until(next, deadline_us).ok()) {
+                break; // 超时或者上游结束，先把已经合并的输出
+            }
+            bytes += Traits::size(next);
+            items += 1;
+            Traits::merge(first, std::move(next));
+        }
+        result = std::move(first);
+        return Status::OK();
+    }
+
+private:
+    Stream<T>& in_;
+    CoalesceOptions opt_;
+};
+
+// 合并节点. 具体类型需要注册:
+//   using ResponseCoalesce = CoalesceNode<Response>;
+//   REGISTER_CLASS(ResponseCoalesce);
+// 配置: max_bytes / max_items / max_delay_ms
+template<class T, class Traits = coalesce_traits<T>>
+class CoalesceNode : public BaseNode {
+public:
+    Status init(json& option) {
+        opt_ = CoalesceOptions::from_json(option);
+        return Status::OK();
+    }
+
+    Status run(Stream<T>& in, Stream<T>& out) {
+        Coalescer<T, Traits> coalescer(in, opt_);
+        while (true) {
+            T value;
+            if (!coalescer.read(value).ok()) {
+                break;
+            }
+            out.append(std::move(value));
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<T>),
+        OUTPUT(out, Stream<T>),
+    );
+
+private:
+    CoalesceOptions opt_;
+};
+
+}
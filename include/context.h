@@ -6,12 +6,19 @@
 #include "bthread/condition_variable.h"
 
 #include <any>
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 #include <memory>
 #include <atomic>
 #include <fstream>
 #include <nlohmann/json.hpp>
 #include "brpc_utils.h"
+#include "metrics.h"
+#include "arena.h"
 
 namespace stream_dag {
     
@@ -42,10 +49,18 @@ class OutputData;
 template<class T>
 class Node;
 
+// 请求的优先级，数值越小越优先. 过载时调度器先放行优先级高的请求
+enum RequestPriority {
+    kPriorityInteractive = 0, // 在线对话
+    kPriorityNormal = 1,
+    kPriorityBatch = 2,       // 离线任务
+    kPriorityCount = 3,
+};
+
 class BaseContext {
 public:
     BaseContext() = default;
-    BaseContext(StreamGraph* g, const std::string& unique_id) : graph_(g), unique_id_(unique_id) {
+    BaseContext(StreamGraph* g, const std::string& unique_id) : unique_id_(unique_id), graph_(g) {
     }
     BaseContext(const std::string& unique_id) : unique_id_(unique_id) {
         trace_buf_["unique_id"] = unique_id;
@@ -66,24 +81,55 @@ public:
     //     }
     // }
 
+    // 请求内的运行时结构都从这里分配
+    RequestArena& arena() { return arena_; }
+
+    // 执行器第一次在这个 ctx 上执行图 g 时创建流、登记节点和边，ctx 被复用时跳过
+    bool prepared_for(const StreamGraph* g) const { return prepared_graph_ == g; }
+    void set_prepared(const StreamGraph* g) { prepared_graph_ = g; }
+
+    // 复用 ctx 前清空请求级的状态. 流由 ContextPool 按图逐个重置，表和已分配的内存都保留
+    void reset() {
+        running_cnt.store(0);
+        cancelled_.store(false, std::memory_order_relaxed);
+        parent_ = nullptr;
+        node_error_ = Status::OK();
+        priority_ = kPriorityNormal;
+        deadline_us_ = 0;
+        latency_.reset();
+        arena_.reset_counters();
+        if (enable_trace_ || !trace_buf_.is_null()) {
+            trace_buf_ = json();
+        }
+        enable_trace_ = false;
+    }
+
     template <class T>
     void init_data(const std::string& name, T&& value) {
-        output_map_[name] = value;
-        trace_buf_["streams"][name] = json::array();
+        put(output_map_, name, value);
+        if (enable_trace_) {
+            trace_buf_["streams"][name] = json::array();
+        }
     }
 
     void init_node(const std::string& name, BaseNode* node) {
-        node_map_[name] = node;
-        trace_buf_["nodes"][name] = json::array();
+        put(node_map_, name, node);
+        if (enable_trace_) {
+            trace_buf_["nodes"][name] = json::array();
+        }
     }
 
     void init_data(const std::string& name, std::any&& value) {
-        output_map_.emplace(name, value);
-        trace_buf_["streams"][name] = json::array();
+        put(output_map_, name, std::move(value));
+        if (enable_trace_) {
+            trace_buf_["streams"][name] = json::array();
+        }
     }
 
     void init_input(const std::string& out, const std::string& in) {
-        input_map_[in] = out;
+        // 输入指向的名字和输出表共用一份
+        auto it = output_map_.find(out);
+        put(input_map_, in, it != output_map_.end() ? it->first : intern(out));
     }
 
     // 避免节点 A 的输入 a 和节点 B 的输入 a 混淆，需要把节点名称也加上
@@ -102,15 +148,12 @@ public:
 
     template <class T>
     T& get_input(const std::string& name) {
-        std::string output_name = input_map_.at(name);
-        return get_output<T>(output_name);
+        return *std::any_cast<std::shared_ptr<T>&>(get_input(name));
     }
 
     template <class T>
     T& get_output(const std::string& name) {
-        std::any & val = output_map_.at(name);
-        std::shared_ptr<T> out_val = std::any_cast<std::shared_ptr<T>>(val);
-        return *out_val;
+        return *std::any_cast<std::shared_ptr<T>&>(get_output(name));
     }
 
     std::any& get_output(const std::string& name) {
@@ -118,19 +161,18 @@ public:
     }
 
     std::any& get_input(const std::string& name) {
-        std::string output_name = input_map_.at(name);
-        return get_output(output_name);
+        return output_map_.at(input_map_.at(name));
     }
 
     template <class T>
     InputData<T>& get(NodeInputWrppper<InputData<T>>& wrapper) {
-        if (input_map2_.count(wrapper.fullname()) == 0) {
-            std::string output_name = input_map_.at(wrapper.fullname());
-            OutputData<T>& out = get_output<OutputData<T>>(output_name);
-            input_map2_[wrapper.fullname()] = InputData<T>(out);
+        const std::string& fullname = wrapper.fullname();
+        auto it = input_map2_.find(fullname);
+        if (it == input_map2_.end()) {
+            OutputData<T>& out = *std::any_cast<std::shared_ptr<OutputData<T>>&>(output_map_.at(input_map_.at(fullname)));
+            it = input_map2_.emplace(intern(fullname), InputData<T>(out)).first;
         }
-        std::any& data = input_map2_[wrapper.fullname()];
-        return std::any_cast<InputData<T>&>(data);
+        return std::any_cast<InputData<T>&>(it->second);
     }
 
     template <class T>
@@ -145,8 +187,7 @@ public:
 
     template <class T>
     Node<T> get(NodeCalleeWrapper<T>& wrapper) {
-        auto fullname = wrapper.fullname();
-        BaseNode* node = node_map_[fullname];
+        BaseNode* node = node_map_.at(wrapper.fullname());
         T* ptr = dynamic_cast<T*>(node);
         return Node<T>(*ptr, *this);
     }
@@ -155,6 +196,11 @@ public:
         enable_trace_ = enable;
     }
 
+    // trace 关闭时调用方可以跳过构造 trace 数据
+    bool trace_enabled() const {
+        return enable_trace_;
+    }
+
     void trace_node(const std::string& name, const std::string& type, const std::string& event, json data) {
         if (enable_trace_) {
             return trace("nodes", name, type, event, data);
@@ -189,6 +235,48 @@ public:
         return false;
     }
 
+    // 取消请求. 节点可以用 is_cancelled 提前退出
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool is_cancelled() const {
+        return cancelled_.load(std::memory_order_relaxed) || (parent_ && parent_->is_cancelled());
+    }
+
+    // 运行时展开的子图用自己的 ctx，跟着父 ctx 一起取消
+    void set_parent(BaseContext* parent) { parent_ = parent; }
+    BaseContext* parent() const { return parent_; }
+
+    // 优先级和截止时间在执行前设置. 截止时间是 gettimeofday_us 的绝对时间，0 表示没有
+    //   排队时按优先级、截止时间放行，过了截止时间还在排队的请求直接失败，执行中的请求被取消
+    void set_priority(RequestPriority priority) { priority_ = priority; }
+    RequestPriority priority() const { return priority_; }
+    void set_deadline_us(int64_t deadline_us) { deadline_us_ = deadline_us; }
+    int64_t deadline_us() const { return deadline_us_; }
+
+    // 执行结束后第一个失败节点的状态（按 list_node 的顺序），都成功时为 OK. 过了截止时间被取消时是 deadline exceeded
+    const Status& node_error() const { return node_error_; }
+    void set_node_error(const Status& status) { node_error_ = status; }
+
+    // 执行器等节点超时返回时标记. 这时可能还有节点的 bthread 在用 ctx，不能复用，也不能直接释放
+    bool timed_out() const { return timed_out_; }
+    void set_timed_out() { timed_out_ = true; }
+
+    // 引用计数: 持有者一个，每个启动了的节点 bthread 一个. 节点 bthread 最后一步 unpin
+    void pin() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    void unpin() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // new 出来的 ctx 的持有者放手. 还有节点在运行时由最后一个退出的节点释放
+    static void release(BaseContext* ctx) { ctx->unpin(); }
+
+    // 和 ctx 一起释放的对象，比如超时返回时节点 bthread 还在用的执行状态
+    void keep_alive(std::shared_ptr<void> object) { kept_.push_back(std::move(object)); }
+
+    // sink 流的时延，执行完之后可以读取
+    RequestLatency& latency() { return latency_; }
+
     // for executor
     std::atomic_int running_cnt{0};
 
@@ -196,18 +284,53 @@ public:
     bthread::ConditionVariable cond_;
 
 private:
-    std::unordered_map<std::string, std::string> input_map_;
-    std::unordered_map<std::string, std::any> output_map_;
-    std::unordered_map<std::string, std::any> input_map2_;
-    std::unordered_map<std::string, BaseNode*> node_map_;
+    using ArenaString = std::pmr::string;
+    // key 指向 names_ 里的字符串. 查找时直接用调用方的名字，不分配内存，只在插入新名字时复制一份
+    template<class V>
+    using ArenaMap = std::pmr::unordered_map<std::string_view, V>;
+
+    std::string_view intern(std::string_view name) {
+        return names_.emplace_back(name);
+    }
+
+    template<class V, class U>
+    void put(ArenaMap<V>& map, const std::string& name, U&& value) {
+        auto it = map.find(name);
+        if (it != map.end()) {
+            it->second = std::forward<U>(value);
+        } else {
+            map.emplace(intern(name), std::forward<U>(value));
+        }
+    }
 
-    std::unordered_map<BaseNode*, bthread_t> bthread_id_map_;
+    // arena 必须在所有从它分配的成员之前构造、之后析构
+    RequestArena arena_;
+
+    // 表里所有的名字. deque 追加时已有元素不移动
+    std::pmr::deque<ArenaString> names_{&arena_};
+
+    ArenaMap<ArenaString> input_map_{&arena_};
+    ArenaMap<std::any> output_map_{&arena_};
+    ArenaMap<std::any> input_map2_{&arena_};
+    ArenaMap<BaseNode*> node_map_{&arena_};
 
     // for trace
     std::string unique_id_;
     json trace_buf_;
     bool enable_trace_ = false;
 
+    RequestLatency latency_;
+    std::atomic<bool> cancelled_{false};
+    BaseContext* parent_ = nullptr;
+    Status node_error_;
+    RequestPriority priority_ = kPriorityNormal;
+    int64_t deadline_us_ = 0;
+    const StreamGraph* prepared_graph_ = nullptr;
+    bool timed_out_ = false;
+    std::atomic<int> refs_{1};
+    // 在 arena 之后析构，里面的对象可以用 arena 的内存
+    std::vector<std::shared_ptr<void>> kept_;
+
     StreamGraph* graph_ = nullptr;
 };
 
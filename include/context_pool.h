@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "butil/time.h"
+#include "bthread/mutex.h"
+#include "graph.h"
+
+namespace stream_dag {
+
+// 一个图的 ctx 池
+//   ctx 第一次执行时建好的表、流对象、流的缓冲区和 arena 里的内存都保留，请求结束后重置再给下一个请求用，
+//   稳定之后执行一个请求时运行时结构只从 arena 已有的内存里分配，不再向堆申请
+//   空闲 ctx 的个数不超过上一个统计窗口里同时在用的峰值，并发下降后多余的 ctx 在归还时释放
+//   只有流（PipeStream、ByteStream）能重置，图里有其它类型的输出时归还的 ctx 直接释放
+//   超时返回的请求可能还有节点在运行，节点的 bthread 还在用 ctx、arena 和流，这样的 ctx 不复用，
+//   归还时放手，由最后一个退出的节点释放. 个数计入 timed_out
+class ContextPool {
+public:
+    // 借出的 ctx，析构时归还
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(ContextPool* pool, std::unique_ptr<BaseContext> ctx) : pool_(pool), ctx_(std::move(ctx)) {}
+        Handle(Handle&&) = default;
+        Handle& operator=(Handle&& other) {
+            release();
+            pool_ = other.pool_;
+            ctx_ = std::move(other.ctx_);
+            return *this;
+        }
+        ~Handle() { release(); }
+
+        BaseContext& operator*() { return *ctx_; }
+        BaseContext* operator->() { return ctx_.get(); }
+        BaseContext* get() { return ctx_.get(); }
+
+    private:
+        void release() {
+            if (pool_ && ctx_) {
+                pool_->release(std::move(ctx_));
+            }
+        }
+
+        ContextPool* pool_ = nullptr;
+        std::unique_ptr<BaseContext> ctx_;
+    };
+
+    // max_idle 是空闲 ctx 的硬上限，window_ms 是统计并发峰值的窗口
+    ContextPool(StreamGraph& g, size_t max_idle = 1024, int64_t window_ms = 1000)
+        : graph_(g), max_idle_(max_idle), window_us_(window_ms * 1000) {}
+
+    Handle acquire() {
+        std::unique_ptr<BaseContext> ctx;
+        {
+            std::unique_lock<bthread::Mutex> lock_(mutex_);
+            in_use_ += 1;
+            window_peak_ = std::max(window_peak_, in_use_);
+            if (!idle_.empty()) {
+                ctx = std::move(idle_.back());
+                idle_.pop_back();
+                reused_ += 1;
+            }
+        }
+        if (ctx == nullptr) {
+            ctx = std::make_unique<BaseContext>();
+            created_ += 1;
+        }
+        return Handle(this, std::move(ctx));
+    }
+
+    size_t idle() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return idle_.size();
+    }
+
+    size_t in_use() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return in_use_;
+    }
+
+    json to_json() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return json({
+            {"idle", idle_.size()},
+            {"in_use", in_use_},
+            {"limit", limit_},
+            {"created", created_.load()},
+            {"reused", reused_},
+            {"timed_out", timed_out_},
+        });
+    }
+
+private:
+    void release(std::unique_ptr<BaseContext> ctx) {
+        bool timed_out = ctx->timed_out();
+        bool reusable = !timed_out && reset(*ctx);
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        in_use_ -= 1;
+        if (timed_out) {
+            timed_out_ += 1;
+            lock_.unlock();
+            BaseContext::release(ctx.release());
+            return;
+        }
+        int64_t now = butil::gettimeofday_us();
+        if (now - window_start_us_ >= window_us_) {
+            // 新窗口的上限取上个窗口的峰值
+            limit_ = window_peak_;
+            window_peak_ = in_use_;
+            window_start_us_ = now;
+        }
+        size_t limit = std::min(max_idle_, std::max(limit_, window_peak_));
+        if (reusable && idle_.size() < limit) {
+            idle_.push_back(std::move(ctx));
+            return;
+        }
+        lock_.unlock();
+        // ctx 在锁外析构
+        ctx.reset();
+    }
+
+    bool reset(BaseContext& ctx) {
+        if (!ctx.prepared_for(&graph_)) {
+            return false;
+        }
+        for (auto node : graph_.list_node()) {
+            for (auto& out : node->list_output()) {
+                if (!out->reset(ctx.get_output(out->fullname()))) {
+                    return false;
+                }
+            }
+        }
+        ctx.reset();
+        return true;
+    }
+
+    StreamGraph& graph_;
+    const size_t max_idle_;
+    const int64_t window_us_;
+
+    bthread::Mutex mutex_;
+    std::vector<std::unique_ptr<BaseContext>> idle_;
+    size_t in_use_ = 0;
+    size_t window_peak_ = 0;
+    size_t limit_ = 0;
+    int64_t window_start_us_ = 0;
+    std::atomic<int64_t> created_{0};
+    int64_t reused_ = 0;
+    int64_t timed_out_ = 0;
+};
+
+}
@@ -3,6 +3,11 @@
 #include "bthread/bthread.h"
 #include "brpc_utils.h"
 #include "graph.h"
+#include "inspector.h"
+#include "scheduler.h"
+#include <deque>
+#include <memory_resource>
+#include <optional>
 
 namespace stream_dag {
 
@@ -11,10 +16,18 @@ using Status = butil::Status;
 
 class RunningNodeInfo {
 public:
-    RunningNodeInfo(BaseContext& ctx_, BaseNode& node_) : ctx(ctx_), node(node_) {} 
+    RunningNodeInfo(BaseContext& ctx_, BaseNode& node_, const NodeRuntimeMetrics* metrics_=nullptr,
+                    const NodePlan* plan_=nullptr)
+        : ctx(ctx_), node(node_), metrics(metrics_), plan(plan_),
+          sync_prev(&ctx_.arena()), sync_next(&ctx_.arena()) {
+        run_state.node = &node;
+    }
 
     BaseContext& ctx;
     BaseNode& node;
+    const NodeRuntimeMetrics* metrics;
+    // 图的执行计划，标出哪些输出是 sink、哪些直接丢弃
+    const NodePlan* plan;
 
     int64_t start_time=0;
     int64_t stop_time=0;
@@ -22,9 +35,10 @@ public:
     BThread bthrd;
 
     // 为了添加节点依赖增加数据结构
-    std::vector<RunningNodeInfo*> sync_prev, sync_next; // 上游、下游的同步依赖节点。方便调度
+    std::pmr::vector<RunningNodeInfo*> sync_prev, sync_next; // 上游、下游的同步依赖节点。方便调度
     std::function<bool(BaseContext&)> condition, action;
     std::atomic_int sync_prev_finishied_cnt{0};
+    NodeRunState run_state;
 
     friend class BaseNode;
 
@@ -32,41 +46,146 @@ public:
         start_time = butil::gettimeofday_us();
         ctx.trace_node(node.name(), node.type(), "before_execute", json());
         ctx.running_cnt++;
+        // 执行器超时返回后 ctx 由还在运行的节点共同持有，最后一个退出的释放
+        ctx.pin();
+#ifdef STREAM_DAG_WITH_BTHREAD_TAG
+        const bthread_attr_t* attr = RequestScheduler::instance().bthread_attr(ctx.priority());
+#else
+        const bthread_attr_t* attr = nullptr;
+#endif
+        // 直接把 this 传给 bthread，不为闭包分配内存
+        bthrd = BThread::start([](void* arg) -> void* {
+            RunningNodeInfo* run = static_cast<RunningNodeInfo*>(arg);
+            NodeThreadPool* pool = NodeThreadPool::of(run->node.exec());
+            if (pool == nullptr) {
+                run->execute_in_bthread();
+                return nullptr;
+            }
+            // 等所有输入就绪再占池里的线程. 池里的节点要等的上游都已经在执行，线程数有限也不会互相等死
+            //   只对平铺的图成立: 池里的节点用 FanOut 或者执行器跑子图，子图里的节点也在同一个池里时，
+            //   外层节点占着线程等子图，子图的节点等线程，线程数不够就会卡死
+            run->wait_inputs();
+            // 等上游的时间不算在 launch_delay 里，只算排队等池里线程的时间
+            run->start_time = butil::gettimeofday_us();
+            pool->run([](void* arg) {
+                static_cast<RunningNodeInfo*>(arg)->execute_in_bthread();
+            }, run);
+            return nullptr;
+        }, this, attr);
+    }
 
-        bthrd = BThread([this] {
-            try {
-                status = node.execute(ctx);
-            } catch (const std::exception& e) {
-                status = Status(-1, e.what());
+    void wait_inputs() {
+        try {
+            for (auto& input : node.list_input()) {
+                PipeStreamBase* stream = input->stream_base(ctx.get_input(input->fullname()));
+                if (stream) {
+                    stream->wait_readable();
+                }
             }
-            
+        } catch (const std::exception& e) {
+            // 没连边的输入，执行时报错
+        }
+    }
+
+    void execute_in_bthread() {
+        int64_t exec_start = butil::gettimeofday_us();
+        run_state.start_us.store(exec_start, std::memory_order_relaxed);
+        run_state.state.store(NodeRunState::kRunning, std::memory_order_release);
+        NodeRunState::set_current(&run_state);
+        run_state.resume_cpu();
+        if (metrics) {
+            bind_metrics(exec_start);
+        }
+        if (plan && (!plan->sink_outputs.empty() || !plan->discard_outputs.empty())) {
+            mark_outputs();
+        }
+        try {
+            status = node.execute(ctx);
+        } catch (const std::exception& e) {
+            status = Status(-1, e.what());
+        }
+        run_state.pause_cpu();
+        NodeRunState::set_current(nullptr);
+        run_state.state.store(NodeRunState::kDone, std::memory_order_release);
+        if (metrics) {
+            int64_t exec_us = butil::gettimeofday_us() - exec_start;
+            metrics->node.record([&](NodeMetrics& m) {
+                m.exec << exec_us;
+                m.cpu << run_state.cpu_total_us;
+                m.blocked << run_state.blocked_total_us;
+            });
+        }
+        
+        if (ctx.trace_enabled()) {
             ctx.trace_node(node.name(), node.type(), "after_execute", json({{"status", status.error_code()}, {"msg", status.error_str()}}));
-            
-            for (auto& out: node.list_output()) {
-                out->half_close(ctx.get_output(out->fullname()));
-            }
-            // for (auto& in_: node.list_input()) {
-            //     in_->close(ctx.get_input(in_->fullname()));
-            // }
-            
-            // if (status.ok()) 
-            for (auto& next: sync_next) {
-                // next->notify_one(this, status);
-                next->sync_prev_finishied_cnt++;
-                if (next->sync_prev_finishied_cnt.load() == next->sync_prev.size()) {
+        }
+        
+        auto& outputs = node.list_output();
+        for (size_t i = 0; i < outputs.size(); i++) {
+            outputs[i]->half_close(ctx.get_output(outputs[i]->fullname()));
+            if (plan && i < plan->sink_outputs.size() && plan->sink_outputs[i]) {
+                ctx.latency().on_close(butil::gettimeofday_us());
+            }
+        }
+        // for (auto& in_: node.list_input()) {
+        //     in_->close(ctx.get_input(in_->fullname()));
+        // }
+        
+        // if (status.ok()) 
+        for (auto& next: sync_next) {
+            // next->notify_one(this, status);
+            next->sync_prev_finishied_cnt++;
+            if (next->sync_prev_finishied_cnt.load() == next->sync_prev.size()) {
+                if (ctx.trace_enabled()) {
                     ctx.trace_node(node.name(), node.type(), "trigger_next", json({{"next", next->node.name()},}));
-                    next->async_run();
                 }
+                next->async_run();
             }
+        }
 
-            ctx.running_cnt--;
-            if (ctx.running_cnt.load() == 0) {
-                ctx.cond_.notify_one();
-            }
+        ctx.running_cnt--;
+        if (ctx.running_cnt.load() == 0) {
+            ctx.cond_.notify_one();
+        }
 
+        if (ctx.trace_enabled()) {
             ctx.trace_node(node.name(), node.type(), "after_clean", json({{"status", status.error_code()}, {"msg", status.error_str()}}));
-            stop_time = butil::gettimeofday_us();
-        });
+        }
+        stop_time = butil::gettimeofday_us();
+        // 超时时 this 归 ctx 所有，unpin 之后不能再访问
+        ctx.unpin();
+    }
+
+    // 记录调度延迟，并把输出流绑定到对应的指标上
+    void bind_metrics(int64_t exec_start) {
+        metrics->node.record([&](NodeMetrics& m) { m.launch_delay << exec_start - start_time; });
+        auto& outputs = node.list_output();
+        for (size_t i = 0; i < outputs.size() && i < metrics->outputs.size(); i++) {
+            PipeStreamBase* stream = outputs[i]->stream_base(ctx.get_output(outputs[i]->fullname()));
+            if (stream) {
+                stream->bind_metrics(metrics->outputs[i], exec_start);
+            }
+        }
+    }
+
+    void mark_outputs() {
+        auto& outputs = node.list_output();
+        for (size_t i = 0; i < outputs.size(); i++) {
+            bool sink = i < plan->sink_outputs.size() && plan->sink_outputs[i];
+            bool discard = i < plan->discard_outputs.size() && plan->discard_outputs[i];
+            if (!sink && !discard) {
+                continue;
+            }
+            PipeStreamBase* stream = outputs[i]->stream_base(ctx.get_output(outputs[i]->fullname()));
+            if (stream == nullptr) {
+                continue;
+            }
+            if (sink) {
+                stream->mark_sink();
+            } else {
+                stream->set_discard();
+            }
+        }
     }
 
     json dump() {
@@ -88,31 +207,53 @@ public:
     }
 
     Status run(StreamGraph& g, BaseContext& ctx) {
-        std::unordered_map<std::string, RunningNodeInfo> nodes_map_;
+        int64_t run_start = butil::gettimeofday_us();
+        ctx.latency().admit(run_start);
+        bool enable_metrics = MetricsRegistry::is_enabled();
+        auto& nodes = g.list_node();
+        auto& plan = g.exec_plan();
 
-        for (auto& node: g.list_node()) {
-            node->init_ctx(ctx);
-            nodes_map_.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(node->name()),
-                std::forward_as_tuple(ctx, *node)
-            );
+        // 过载时按优先级、截止时间排队. 子图的 ctx 跟着父请求，已经占了名额，不再排队
+        //   默认不限制，不排队也不加锁
+        RequestScheduler& scheduler = RequestScheduler::instance();
+        std::optional<SchedulerSlot> slot;
+        if (ctx.parent() == nullptr && scheduler.enabled()) {
+            Status admitted = scheduler.admit(ctx);
+            if (!admitted.ok()) {
+                return admitted;
+            }
+            slot.emplace(scheduler);
         }
 
-        for (auto& dep_info: g.list_depends()) {
-            RunningNodeInfo& running_node = nodes_map_.at(dep_info.node()->name());
-            for (const auto& prev: dep_info.deps()) {
-                RunningNodeInfo& prev_running_info = nodes_map_.at(prev->name());
-                running_node.sync_prev.push_back(&prev_running_info);
-                prev_running_info.sync_next.push_back(&running_node);
+        // 复用的 ctx 里流和边都已经建好
+        if (!ctx.prepared_for(&g)) {
+            for (auto node : nodes) {
+                node->init_ctx(ctx);
             }
+            for (auto& [out, in] : g.list_edge()) {
+                BaseConvertor* convertor = g.convertor(out);
+                if (convertor == nullptr) {
+                    ctx.init_input(out, in);
+                } else if (!convertor->connect(ctx, out, in)) {
+                    return Status(-1, "edge %s -> %s: convertor type mismatch", out.c_str(), in.c_str());
+                }
+            }
+            ctx.set_prepared(&g);
         }
 
-        auto& edges = g.list_edge();
-        for (auto& it: edges) {
-            auto out = it.first;
-            auto in = it.second;
-            ctx.init_input(out, in);
+        // 每次执行的状态从 ctx 的 arena 分配. deque 扩容不移动元素
+        std::pmr::deque<RunningNodeInfo> running(&ctx.arena());
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const NodeRuntimeMetrics* metrics = enable_metrics ? &g.node_metrics()[i] : nullptr;
+            running.emplace_back(ctx, *nodes[i], metrics, &plan[i]);
+        }
+        for (size_t i = 0; i < nodes.size(); i++) {
+            for (int prev : plan[i].sync_prev) {
+                running[i].sync_prev.push_back(&running[prev]);
+            }
+            for (int next : plan[i].sync_next) {
+                running[i].sync_next.push_back(&running[next]);
+            }
         }
 
         // for (auto& name: g.list_output_full_names()) {
@@ -130,51 +271,91 @@ public:
         //     });
         // }
 
-        for (auto& [name, run]: nodes_map_) {
-            if (run.sync_prev_finishied_cnt.load() == run.sync_prev.size()) {
+        InflightRequest inflight(ctx, g.name());
+        for (auto& run : running) {
+            inflight.add_node(&run.node, &run.run_state);
+        }
+        InflightGuard inflight_guard(inflight);
+
+        for (auto& run : running) {
+            if (run.sync_prev.empty()) {
                 run.async_run();
             }
         }
         
         bthread::Mutex mutex_;
         std::unique_lock<bthread::Mutex> lock_(mutex_);
-        int timeout_cnt = 0;
+        int64_t deadline = run_start + timeout_ms_ * 1000;
+        // 过了请求的截止时间就取消: 节点用 is_cancelled 提前退出，阻塞在读上的节点因为输出流关闭被唤醒
+        int64_t cancel_at = ctx.deadline_us();
         while (ctx.running_cnt.load() != 0) {
-            int rc = ctx.cond_.wait_for(lock_, 1000000);
-            if (rc == ETIMEDOUT) {
-                timeout_cnt += 1;
-                if (timeout_cnt >= 100) {
-                    bool dumped = ctx.dump("running.json");
-                    if (dumped) {
-                        return Status(-1, "Timeout, dump to running.json");
-                    } else {
-                        printf("Executor[%s] Start dump Running Node Info:\n", name_.c_str());
-                        for (auto& it: nodes_map_) {
-                            json info = it.second.dump();
-                            printf("Executor[%s] [%s]:%s\n", name_.c_str(), it.first.c_str(), info.dump().c_str());
-                        }
-                        printf("Executor[%s] ctx.running_cnt=%d\n", name_.c_str(), ctx.running_cnt.load());
-                        return Status(-1, "Timeout, fail to dump");
-                    }
-                    break;
+            int64_t now = butil::gettimeofday_us();
+            if (cancel_at > 0 && now >= cancel_at) {
+                inflight.cancel();
+                ctx.set_node_error(Status(-1, "deadline exceeded"));
+                cancel_at = 0;
+            }
+            int64_t remain_us = deadline - now;
+            if (remain_us <= 0) {
+                // 还在运行的节点引用着 running 里的 RunningNodeInfo，交给 ctx，和 ctx 一起释放. deque 移动时元素不动
+                ctx.keep_alive(std::make_shared<std::pmr::deque<RunningNodeInfo>>(std::move(running)));
+                ctx.set_timed_out();
+                bool dumped = ctx.dump("running.json");
+                if (dumped) {
+                    return Status(-1, "Timeout, dump to running.json");
+                } else {
+                    json info = inflight.inspect(butil::gettimeofday_us());
+                    printf("Executor[%s] Timeout, running info: %s\n", name_.c_str(), info.dump().c_str());
+                    printf("Executor[%s] ctx.running_cnt=%d\n", name_.c_str(), ctx.running_cnt.load());
+                    return Status(-1, "Timeout, fail to dump");
                 }
             }
+            int64_t wait_us = std::min<int64_t>(remain_us, 1000000);
+            if (cancel_at > 0) {
+                wait_us = std::min<int64_t>(wait_us, std::max<int64_t>(cancel_at - now, 1));
+            }
+            ctx.cond_.wait_for(lock_, wait_us);
         }
         
-        for (auto& [name, run]: nodes_map_) {
+        for (auto& run : running) {
             int join_code = run.bthrd.join();
             if (join_code != 0) {
                 printf("Internal error bthread join failed!");
                 return Status(-1, "Internal error bthread join failed");
             }
+            if (ctx.node_error().ok() && !run.status.ok()) {
+                ctx.set_node_error(run.status);
+            }
         }
 
+        int64_t run_stop = butil::gettimeofday_us();
+        RequestLatency& latency = ctx.latency();
+        latency.finish(run_stop);
+        if (enable_metrics) {
+            GraphMetrics* metrics = g.graph_metrics();
+            metrics->run << run_stop - run_start;
+            if (latency.elements() > 0) {
+                metrics->ttft << latency.ttft_us();
+                for (int64_t gap : latency.itl()) {
+                    metrics->itl << gap;
+                }
+                metrics->tokens_per_second << (int64_t) latency.tokens_per_second();
+            }
+            metrics->arena_allocations << ctx.arena().allocations();
+            metrics->heap_allocations << ctx.arena().heap_allocations();
+        }
         return Status::OK();
     }
 
+    // 等待所有节点结束的超时时间
+    //   超时返回时还有节点在运行，ctx 不能直接释放: 用 ContextPool 借的 ctx 归还后由最后一个退出的节点释放，
+    //   自己 new 的 ctx 用 BaseContext::release 放手，栈上的 ctx 要等节点都退出
+    void set_timeout_ms(int64_t timeout_ms) { timeout_ms_ = timeout_ms; }
+
 private:
     bool lazy_ = false;
     std::string name_;
+    int64_t timeout_ms_ = 100000;
 };
 
 
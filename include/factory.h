@@ -34,6 +34,14 @@ public:
         return nullptr;
     }
 
+    using Creator = std::function<std::unique_ptr<BaseNode>(Args&&... args)>;
+
+    // 查一次拿到创建函数，批量创建同类型的节点时不用每次查表. 注册表只增不删，指针一直有效
+    static const Creator* GetCreator(const std::string& typeName) {
+        auto it = GetRegistry().find(typeName);
+        return it == GetRegistry().end() ? nullptr : &it->second;
+    }
+
     static std::vector<std::string> GetRegisteredTypes() {
         std::vector<std::string> types;
         for (const auto& pair : GetRegistry()) {
@@ -104,8 +112,9 @@ public:
 // }
 #define CONCAT(A, B) _CONCAT(A, B)
 #define _CONCAT(A, B) A##B
-#define MacroArgCount(...) _MacroArgCount(__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
-#define _MacroArgCount(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, COUNT, ...) COUNT
+// 最多 30 个参数，也就是 DECLARE_PARAMS 最多 10 个端口
+#define MacroArgCount(...) _MacroArgCount(__VA_ARGS__, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define _MacroArgCount(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, COUNT, ...) COUNT
 #define _MACRO_GET1_EVERY3_(...) CONCAT(_MACRO_GET1_EVERY3_, MacroArgCount(__VA_ARGS__))(__VA_ARGS__)
 #define _MACRO_GET1_EVERY3_0() 
 #define _MACRO_GET1_EVERY3_1(_1) 
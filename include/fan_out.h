@@ -0,0 +1,186 @@
+#pragma once
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include "executor.h"
+#include "context_pool.h"
+
+namespace stream_dag {
+
+// 运行时展开的子图
+//   节点执行时按输入的个数把同一个子图复制 K 份并行执行，比如 LLM 拆出几个子查询，每个子查询跑一份搜索子图
+//   子图的入口是一个没有连边的 Stream<In> 输入端口，每份写入一个元素；出口是一个 Stream<Out> 输出端口
+//   入口没有连边，子图不能 finalize
+//   每份从子图的 ContextPool 借一个 ctx（同一个 ctx 里端口名唯一，放不下多份），和调用方的 ctx 关联，调用方取消时各份一起取消
+//   同时执行的份数不超过 max_concurrency，各份的输出按输入顺序或者完成顺序写到一个流
+//
+//   FanOut 一般是节点的成员，init 时创建，所有请求共用:
+//   Status run(Stream<Query>& queries, Stream<Result>& results) {
+//       return fan_out_->run(queries, results);
+//   }
+template<class In, class Out>
+class FanOut {
+public:
+    struct Options {
+        int max_concurrency = 8;
+        // true 时按输入顺序输出，一份的输出要等前面的份都完成；false 时哪份先完成先输出
+        bool ordered = true;
+    };
+
+    // subgraph 由调用方持有，要比 FanOut 活得久
+    FanOut(StreamGraph& subgraph, const std::string& input, const std::string& output, Options options = Options())
+        : subgraph_(subgraph), input_(input), output_(output), options_(options), pool_(subgraph) {}
+
+    // 读完 inputs 为止，每个元素启动一份，份数没有上限. 所有份都结束后返回，有失败时返回输入顺序上第一个失败的状态
+    Status run(Stream<In>& inputs, Stream<Out>& out) {
+        Gather gather(*this, out);
+        In item;
+        while (!out.context().is_cancelled() && inputs.read(item).ok()) {
+            gather.launch(std::move(item));
+        }
+        return gather.wait();
+    }
+
+    Status run(const std::vector<In>& inputs, Stream<Out>& out) {
+        Gather gather(*this, out);
+        for (auto& item : inputs) {
+            if (out.context().is_cancelled()) {
+                break;
+            }
+            gather.launch(In(item));
+        }
+        return gather.wait();
+    }
+
+    const Options& options() const { return options_; }
+
+private:
+    class Gather;
+
+    // 一份子图
+    struct Copy {
+        Copy(Gather& gather_, In&& input_) : gather(gather_), input(std::move(input_)) {}
+
+        Gather& gather;
+        In input;
+        Status status;
+        std::vector<Out> outputs;
+        bool done = false;
+        BThread bthrd;
+    };
+
+    // 一次 run 的状态，在调用方的栈上
+    class Gather {
+    public:
+        Gather(FanOut& owner, Stream<Out>& out)
+            : owner_(owner), out_(out), copies_(&out.context().arena()) {}
+
+        // 正在执行的份数到上限时等待. bthread 启动失败时这一份记为失败，不占执行中的份数
+        void launch(In&& input) {
+            std::unique_lock<bthread::Mutex> lock_(mutex_);
+            while (running_ >= std::max(owner_.options_.max_concurrency, 1)) {
+                cond_.wait(lock_);
+            }
+            running_++;
+            copies_.emplace_back(*this, std::move(input));
+            Copy* copy = &copies_.back();
+            lock_.unlock();
+            copy->bthrd = BThread::start([](void* arg) -> void* {
+                Copy* copy = static_cast<Copy*>(arg);
+                copy->gather.execute(*copy);
+                return nullptr;
+            }, copy);
+            if (copy->bthrd.get_tid() == INVALID_BTHREAD) {
+                copy->status = Status(-1, "start fan-out copy failed");
+                finish(*copy);
+            }
+        }
+
+        Status wait() {
+            std::unique_lock<bthread::Mutex> lock_(mutex_);
+            while (running_ > 0) {
+                cond_.wait(lock_);
+            }
+            lock_.unlock();
+            // 结束的 bthread 也要 join，回收 tid
+            Status status;
+            for (auto& copy : copies_) {
+                copy.bthrd.join();
+                if (status.ok() && !copy.status.ok()) {
+                    status = copy.status;
+                }
+            }
+            return status;
+        }
+
+        void execute(Copy& copy) {
+            {
+                auto ctx = owner_.pool_.acquire();
+                ctx->set_parent(&out_.context());
+                ctx->set_priority(out_.context().priority());
+                // 入口不是任何节点的输出，第一次用这个 ctx 时建好，之后每次重置
+                if (!ctx->prepared_for(&owner_.subgraph_)) {
+                    auto entry = arena_make_shared<Stream<In>>(&ctx->arena(), *ctx, owner_.input_, typeid(Stream<In>).name());
+                    ctx->init_data(owner_.input_, std::any(std::move(entry)));
+                    ctx->init_input(owner_.input_, owner_.input_);
+                }
+                auto& entry = ctx->template get_output<Stream<In>>(owner_.input_);
+                entry.reset();
+                entry.append(copy.input);
+                entry.half_close();
+
+                BthreadExecutor executor;
+                copy.status = executor.run(owner_.subgraph_, *ctx);
+                auto& exit = ctx->template get_output<Stream<Out>>(owner_.output_);
+                Out item;
+                while (exit.read(item).ok()) {
+                    copy.outputs.push_back(std::move(item));
+                }
+                if (copy.status.ok()) {
+                    copy.status = ctx->node_error();
+                }
+                // 先把 ctx 还回池子，再汇总
+            }
+            finish(copy);
+        }
+
+    private:
+        void finish(Copy& copy) {
+            std::unique_lock<bthread::Mutex> lock_(mutex_);
+            copy.done = true;
+            if (!owner_.options_.ordered) {
+                emit(copy);
+            } else {
+                while (next_ < copies_.size() && copies_[next_].done) {
+                    emit(copies_[next_]);
+                    next_++;
+                }
+            }
+            running_--;
+            cond_.notify_all();
+        }
+
+        void emit(Copy& copy) {
+            for (auto& item : copy.outputs) {
+                out_.append(item);
+            }
+            copy.outputs.clear();
+        }
+
+        FanOut& owner_;
+        Stream<Out>& out_;
+        bthread::Mutex mutex_;
+        bthread::ConditionVariable cond_;
+        int running_ = 0;
+        size_t next_ = 0;
+        std::pmr::deque<Copy> copies_;
+    };
+
+    StreamGraph& subgraph_;
+    std::string input_, output_;
+    Options options_;
+    ContextPool pool_;
+};
+
+}
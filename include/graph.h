@@ -5,7 +5,10 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <nlohmann/json.hpp>
 
 namespace stream_dag {
@@ -88,32 +91,119 @@ private:
 };
 
 
+// 一个节点的执行计划，下标都是 list_node() 里的位置
+struct NodePlan {
+    std::vector<bool> sink_outputs;    // 和 list_output() 对应，图里没有 sink 时为空
+    std::vector<bool> discard_outputs; // 和 list_output() 对应，finalize 没有丢弃输出时为空
+    std::vector<int> sync_prev;        // 同步依赖的上游
+    std::vector<int> sync_next;
+};
+
+// finalize 的优化项. 图里没有 sink 时都不做，调用方可能在执行后读任何输出
+struct GraphOptimizeOptions {
+    // 删掉输出到不了 sink 的节点. 没有输出的节点当作有副作用，保留
+    bool eliminate_dead_nodes = true;
+    // 没有下游也不是 sink 的输出，写入直接丢弃
+    //   流对象还是每个 ctx 创建一个，只是不缓存数据: 节点按引用拿到输出流，换成所有请求共用的空流
+    //   会让每次写入都争同一把锁. 用 ContextPool 复用 ctx 时流对象只在 ctx 第一次执行时创建
+    bool discard_unused_outputs = true;
+};
+
+
+// 转换边. 上游写入时就地转换，直接写到下游的输入流里，不需要中间节点、流和 bthread
+//   两端都是 Stream<T>. 上游流不再缓存数据，关闭、指标、sink 都转到下游流
 class BaseConvertor {
 public:
-    virtual std::any convert(const std::any& data) = 0;
+    virtual ~BaseConvertor() = default;
+    // 边两端的流类型，finalize 时校验
+    virtual const std::type_info& from_type() const = 0;
+    virtual const std::type_info& to_type() const = 0;
+    // 在 ctx 里创建 in 的输入流，挂到 out 上. out 的类型不对时返回 false
+    virtual bool connect(BaseContext& ctx, const std::string& out, const std::string& in) = 0;
+
+    // 注册名，JSON 图里用它指定转换函数. 代码里直接创建的为空，dump 时不输出
+    const std::string& name() const { return name_; }
+    void set_name(const std::string& name) { name_ = name; }
+private:
+    std::string name_;
 };
 
 template<class from, class to>
 class Convertor : public BaseConvertor {
 public:
-    Convertor(std::function<to(from)> func) : func_(func) {}
-    std::any convert(const std::any& data) override {
-        from& from_data = std::any_cast<from&>(data);
-        to to_data = func_(from_data);
-        return to_data;
+    using Func = std::function<to(const from&)>;
+
+    Convertor(Func func) : func_(std::make_shared<const Func>(std::move(func))) {}
+
+    const std::type_info& from_type() const override { return typeid(Stream<from>); }
+    const std::type_info& to_type() const override { return typeid(Stream<to>); }
+
+    bool connect(BaseContext& ctx, const std::string& out, const std::string& in) override {
+        auto* source = std::any_cast<std::shared_ptr<Stream<from>>>(&ctx.get_output(out));
+        if (source == nullptr) {
+            return false;
+        }
+        auto target = arena_make_shared<Stream<to>>(&ctx.arena(), ctx, in, typeid(Stream<to>).name());
+        (*source)->set_forward(arena_make_shared<Forward>(&ctx.arena(), target.get(), func_), target.get());
+        ctx.init_data(in, std::any(std::move(target)));
+        ctx.init_input(in, in);
+        return true;
     }
+
 private:
-    std::function<to(from)> func_;
+    // 复用的 ctx 一直留着 Forward，Convertor 可能先被图或者注册表释放，所以共同持有转换函数
+    class Forward : public StreamForward<from> {
+    public:
+        Forward(Stream<to>* target, std::shared_ptr<const Func> func) : target_(target), func_(std::move(func)) {}
+        Status forward(from& data) override {
+            return target_->append((*func_)(data));
+        }
+    private:
+        Stream<to>* target_;
+        std::shared_ptr<const Func> func_;
+    };
+
+    std::shared_ptr<const Func> func_;
 };
 
+// 按名字注册的转换函数，JSON 图的边用 "convertor" 指定
+class ConvertorRegistry {
+public:
+    static void Register(const std::string& name, std::shared_ptr<BaseConvertor> convertor) {
+        if (GetRegistry().count(name)) {
+            throw std::runtime_error("Convertor already registered: " + name);
+        }
+        convertor->set_name(name);
+        GetRegistry()[name] = std::move(convertor);
+    }
+
+    static std::shared_ptr<BaseConvertor> Get(const std::string& name) {
+        auto it = GetRegistry().find(name);
+        return it == GetRegistry().end() ? nullptr : it->second;
+    }
+
+private:
+    static std::map<std::string, std::shared_ptr<BaseConvertor>>& GetRegistry() {
+        static std::map<std::string, std::shared_ptr<BaseConvertor>> registry;
+        return registry;
+    }
+};
+
+// REGISTER_CONVERTOR(StartToChat, Start, ChatRequest, [](const Start& s) { ... })
+#define REGISTER_CONVERTOR(name, from, to, ...) \
+    class name##ConvertorInitializer { \
+    public: \
+        name##ConvertorInitializer() { \
+            ConvertorRegistry::Register(#name, std::make_shared<Convertor<from, to>>(__VA_ARGS__)); \
+        } \
+    }; \
+    name##ConvertorInitializer _##name##ConvertorInitializerInstance;
+
 class StreamGraph {
 public:
     StreamGraph() = default;
-    StreamGraph(json& option) : option_(option) {}
-    ~StreamGraph() {
-        for (auto node : nodes_) {
-            delete node;
-        }
+    StreamGraph(json& option) : option_(option) {
+        name_ = option_.value("name", name_);
     }
 
     // void add_node(BaseNode& node) {
@@ -124,19 +214,46 @@ public:
     template <class T>
     T* add_node(const std::string& name) {
         T* node = new T(name, typeid(T).name());
-        nodes_.push_back(node);
-        nodes_map_[name] = node;
+        add_node(std::shared_ptr<BaseNode>(node));
         return node;
     }
 
     BaseNode* add_node(const std::string& name, const std::string& type) {
         std::unique_ptr<BaseNode> node = NodeFactory::CreateInstanceByName(type, name, type);
-        BaseNode* ptr = node.release();
+        if (node == nullptr) {
+            return nullptr;
+        }
+        return add_node(std::shared_ptr<BaseNode>(std::move(node)));
+    }
+
+    // 加入已经创建好的节点，图负责释放
+    BaseNode* add_node(std::unique_ptr<BaseNode> node) {
+        return add_node(std::shared_ptr<BaseNode>(std::move(node)));
+    }
+
+    // 加入和其它图共用的节点，比如热更新时没有变化的节点. 节点不持有请求级的状态，多个图可以同时执行它
+    BaseNode* add_node(std::shared_ptr<BaseNode> node) {
+        BaseNode* ptr = node.get();
         nodes_.push_back(ptr);
-        nodes_map_[name] = ptr;
+        owned_.push_back(std::move(node));
+        nodes_map_[ptr->name()] = ptr;
         return ptr;
     }
 
+    // 按名字取节点，给其它图共用. 没有时返回 nullptr
+    std::shared_ptr<BaseNode> share_node(const std::string& name) const {
+        auto it = nodes_map_.find(name);
+        if (it == nodes_map_.end()) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (nodes_[i] == it->second) {
+                return owned_[i];
+            }
+        }
+        return nullptr;
+    }
+
     void add_node_dep(BaseNode* node, std::vector<BaseNode*> deps, Condition&& condition) {
         depends_.push_back(DependentInfo{node, deps, condition});
     }
@@ -178,13 +295,11 @@ public:
         edge_[out.fullname()] = in.fullname();
     }
 
-    // template <class T1, class T2>
-    // void add_edge(NodeOutputWrppper<T1>& out, NodeInputWrppper<T2>& in, std::function<T2(T1)> convertor) {
-    //     edge_[out.fullname()] = DataConvertor{
-    //         .from_name = in.fullname();
-    //         .convertor = convertor;
-    //     };
-    // }
+    // 转换边，func 把 T1 转成 T2
+    template <class T1, class T2, class F>
+    void add_edge(NodeOutputWrppper<Stream<T1>>& out, NodeInputWrppper<Stream<T2>>& in, F&& func) {
+        add_edge(out.fullname(), in.fullname(), std::make_shared<Convertor<T1, T2>>(std::forward<F>(func)));
+    }
 
     template <class T1, class T2>
     void add_edge_dep(NodeInputWrppper<T2>& in, NodeOutputWrppper<T1>& out) {
@@ -194,9 +309,37 @@ public:
 
     void add_edge(const std::string& out, const std::string& in) {
         edge_[out] = in;
+        convertors_.erase(out);
     }
 
-    std::vector<BaseNode*> list_node() {
+    void add_edge(const std::string& out, const std::string& in, std::shared_ptr<BaseConvertor> convertor) {
+        edge_[out] = in;
+        convertors_[out] = std::move(convertor);
+    }
+
+    // out 上的转换边，普通边返回 nullptr
+    BaseConvertor* convertor(const std::string& out) const {
+        auto it = convertors_.find(out);
+        return it == convertors_.end() ? nullptr : it->second.get();
+    }
+
+    // 标记 sink 流，执行时统计它的首元素时延、元素间隔
+    template <class T>
+    void mark_sink(NodeOutputWrppper<T>& out) {
+        sinks_.insert(out.fullname());
+    }
+
+    void mark_sink(const std::string& out) {
+        sinks_.insert(out);
+    }
+
+    bool is_sink(const std::string& out) const {
+        return sinks_.count(out) > 0;
+    }
+
+    const std::unordered_set<std::string>& list_sink() const { return sinks_; }
+
+    const std::vector<BaseNode*>& list_node() const {
         return nodes_;
     }
 
@@ -206,6 +349,100 @@ public:
         return edge_;
     }
 
+    // 图名，用作指标前缀
+    const std::string& name() const { return name_; }
+    void set_name(const std::string& name) { name_ = name; }
+
+    // 各节点的指标，和 list_node() 一一对应. 第一次执行时创建，之后不能再修改图
+    const std::vector<NodeRuntimeMetrics>& node_metrics() {
+        std::call_once(metrics_once_, [this] {
+            graph_metrics_ = MetricsRegistry::graph(name_);
+            for (auto node : nodes_) {
+                NodeRuntimeMetrics metrics;
+                metrics.node = MetricsRegistry::node(name_, node->name(), node->type());
+                for (auto& out : node->list_output()) {
+                    metrics.outputs.push_back(MetricsRegistry::stream(name_, out->fullname(), metrics.node));
+                }
+                node_metrics_.push_back(std::move(metrics));
+            }
+        });
+        return node_metrics_;
+    }
+
+    GraphMetrics* graph_metrics() {
+        node_metrics();
+        return graph_metrics_;
+    }
+
+    // 执行计划，和 list_node() 一一对应. 按名字查找只在这里做一次，执行时只用下标
+    // 第一次执行时创建，之后不能再修改图
+    const std::vector<NodePlan>& exec_plan() {
+        std::call_once(plan_once_, [this] {
+            planned_ = true;
+            std::unordered_map<const BaseNode*, int> index;
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                index[nodes_[i]] = i;
+            }
+            exec_plan_.resize(nodes_.size());
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                for (auto& out : nodes_[i]->list_output()) {
+                    if (!sinks_.empty()) {
+                        exec_plan_[i].sink_outputs.push_back(is_sink(out->fullname()));
+                    }
+                    if (!discarded_.empty()) {
+                        exec_plan_[i].discard_outputs.push_back(discarded_.count(out->fullname()) > 0);
+                    }
+                }
+            }
+            for (auto& dep_info : depends_) {
+                int node = index.at(dep_info.node());
+                for (auto prev : dep_info.deps()) {
+                    exec_plan_[node].sync_prev.push_back(index.at(prev));
+                    exec_plan_[index.at(prev)].sync_next.push_back(node);
+                }
+            }
+        });
+        return exec_plan_;
+    }
+
+    // 校验并优化图，要在第一次执行前调用，重复调用直接返回
+    //   校验: 边的两端是存在的输出和输入且类型一致，每个输入恰好连一条边，sink 是存在的输出，
+    //         边和同步依赖不成环
+    //   优化: 见 GraphOptimizeOptions. 执行后还要读的输出要标成 sink，否则会被删掉或丢弃
+    // 校验失败时图不变
+    Status finalize(const GraphOptimizeOptions& options = GraphOptimizeOptions()) {
+        if (finalized_) {
+            return Status::OK();
+        }
+        if (planned_) {
+            return Status(-1, "graph %s: finalize after first run", name_.c_str());
+        }
+        Status status = validate();
+        if (!status.ok()) {
+            return status;
+        }
+        optimize_report_ = {{"removed_nodes", json::array()}, {"discarded_outputs", json::array()}};
+        if (!sinks_.empty() && options.eliminate_dead_nodes) {
+            eliminate_dead_nodes();
+        }
+        if (!sinks_.empty() && options.discard_unused_outputs) {
+            for (auto node : nodes_) {
+                for (auto& out : node->list_output()) {
+                    if (edge_.count(out->fullname()) == 0 && !is_sink(out->fullname())) {
+                        discarded_.insert(out->fullname());
+                        optimize_report_["discarded_outputs"].push_back(out->fullname());
+                    }
+                }
+            }
+        }
+        finalized_ = true;
+        exec_plan();
+        return Status::OK();
+    }
+
+    // finalize 删掉的节点和丢弃的输出
+    const json& optimize_report() const { return optimize_report_; }
+
     Status load(const std::string& path) {
         json graph;
         std::ifstream in(path);
@@ -214,17 +451,60 @@ public:
         }
         in >> graph;
         in.close();
+        return load_json(graph);
+    }
+
+    // base 不为空时，名字、类型、配置、执行方式都和 base 里相同的节点直接共用，不重新创建和 init
+    Status load_json(const json& graph, const StreamGraph* base = nullptr) {
+        name_ = graph.value("name", name_);
+        static const json empty = json::array();
+        auto list = [&](const char* key) -> const json& {
+            auto it = graph.find(key);
+            return it == graph.end() ? empty : *it;
+        };
 
-        for (auto& node : graph["nodes"]) {
+        for (auto& node : list("nodes")) {
             std::string type = node["type"];
             std::string name = node["name"];
-            add_node(name, type);
+            NodeExec exec = kExecBthread;
+            if (node.contains("exec") && !node_exec_from_name(node["exec"], &exec)) {
+                return Status(-1, "node %s unknown exec: %s", name.c_str(), node["exec"].dump().c_str());
+            }
+            std::shared_ptr<BaseNode> same = base ? base->share_node(name) : nullptr;
+            if (same && same->type() == type && same->option() == node.value("option", json::object()) &&
+                same->exec() == exec && same->ensure_init().ok()) {
+                add_node(std::move(same));
+                continue;
+            }
+            BaseNode* ptr = add_node(name, type);
+            if (ptr == nullptr) {
+                return Status(-1, "unknown node type: %s", type.c_str());
+            }
+            ptr->set_exec(exec);
+            Status status = ptr->configure(node.value("option", json::object()));
+            if (!status.ok()) {
+                return status;
+            }
         }
-        for (auto& edge : graph["edges"]) {
-            add_edge(edge["from"], edge["to"]);
+        for (auto& edge : list("edges")) {
+            if (!edge.contains("convertor")) {
+                add_edge(edge["from"], edge["to"]);
+                continue;
+            }
+            std::string name = edge["convertor"];
+            std::shared_ptr<BaseConvertor> convertor = ConvertorRegistry::Get(name);
+            if (convertor == nullptr) {
+                return Status(-1, "unknown convertor: %s", name.c_str());
+            }
+            add_edge(edge["from"], edge["to"], convertor);
         }
 
-        for (auto& depend: graph["depents"]) {
+        for (auto& sink : list("sinks")) {
+            mark_sink(sink.get<std::string>());
+        }
+
+        // dump 写的是 depends，兼容以前的 depents
+        for (auto& depend: graph.contains("depends") ? list("depends") : list("depents")) {
             std::string node_name = depend["node"];
             std::string condition = depend["condition"];
             std::vector<std::string> dependent = depend["dependent"];
@@ -233,8 +513,9 @@ public:
         return Status::OK();
     }
 
-    void dump(const std::string& path) {
+    json to_json() const {
         json result;
+        result["name"] = name_;
         json& nodes = result["nodes"];
         json& edges = result["edges"];
 
@@ -248,22 +529,211 @@ public:
                 {"from", edge.first},
                 {"to", edge.second}
             });
+            BaseConvertor* conv = convertor(edge.first);
+            if (conv && !conv->name().empty()) {
+                edges.back()["convertor"] = conv->name();
+            }
         }
 
         for (auto& dep: depends_) {
             result["depends"].push_back(dep.to_json());
         }
 
+        for (auto& sink: sinks_) {
+            result["sinks"].push_back(sink);
+        }
+
+        return result;
+    }
+
+    void dump(const std::string& path) {
         std::ofstream out(path, std::ofstream::out);
-        out << result;
+        out << to_json();
         out.close();
         return;
     }
 
     friend class BaseNode;
 private:
+    // 端口所在节点的下标
+    struct PortRef {
+        int node;
+        bool output;
+        const BaseDataWrapper* wrapper;
+    };
+
+    std::unordered_map<std::string, PortRef> port_index() const {
+        std::unordered_map<std::string, PortRef> ports;
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            for (auto& in : nodes_[i]->list_input()) {
+                ports[in->fullname()] = {(int) i, false, in.get()};
+            }
+            for (auto& out : nodes_[i]->list_output()) {
+                ports[out->fullname()] = {(int) i, true, out.get()};
+            }
+        }
+        return ports;
+    }
+
+    Status validate() const {
+        auto ports = port_index();
+        std::unordered_map<std::string, std::string> feeder;
+        std::vector<std::vector<int>> next(nodes_.size());
+        for (auto& [out, in] : edge_) {
+            auto from = ports.find(out);
+            if (from == ports.end() || !from->second.output) {
+                return Status(-1, "edge %s -> %s: %s is not an output", out.c_str(), in.c_str(), out.c_str());
+            }
+            auto to = ports.find(in);
+            if (to == ports.end() || to->second.output) {
+                return Status(-1, "edge %s -> %s: %s is not an input", out.c_str(), in.c_str(), in.c_str());
+            }
+            BaseConvertor* conv = convertor(out);
+            if (conv ? from->second.wrapper->data_typeid() != conv->from_type() ||
+                       to->second.wrapper->data_typeid() != conv->to_type()
+                     : from->second.wrapper->data_typeid() != to->second.wrapper->data_typeid()) {
+                return Status(-1, "edge %s -> %s: type mismatch", out.c_str(), in.c_str());
+            }
+            if (!feeder.emplace(in, out).second) {
+                return Status(-1, "input %s has more than one edge", in.c_str());
+            }
+            next[from->second.node].push_back(to->second.node);
+        }
+        for (auto node : nodes_) {
+            for (auto& in : node->list_input()) {
+                if (feeder.count(in->fullname()) == 0) {
+                    return Status(-1, "input %s is not connected", in->fullname().c_str());
+                }
+            }
+        }
+        for (auto& sink : sinks_) {
+            auto it = ports.find(sink);
+            if (it == ports.end() || !it->second.output) {
+                return Status(-1, "sink %s is not an output", sink.c_str());
+            }
+        }
+
+        // 边和同步依赖一起做拓扑排序，剩下的节点在环上
+        std::unordered_map<const BaseNode*, int> index;
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            index[nodes_[i]] = i;
+        }
+        for (auto& dep_info : depends_) {
+            for (auto prev : dep_info.deps()) {
+                next[index.at(prev)].push_back(index.at(dep_info.node()));
+            }
+        }
+        std::vector<int> indegree(nodes_.size(), 0);
+        for (auto& list : next) {
+            for (int to : list) {
+                indegree[to]++;
+            }
+        }
+        std::vector<int> ready;
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (indegree[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        size_t visited = 0;
+        while (!ready.empty()) {
+            int i = ready.back();
+            ready.pop_back();
+            visited++;
+            for (int to : next[i]) {
+                if (--indegree[to] == 0) {
+                    ready.push_back(to);
+                }
+            }
+        }
+        if (visited != nodes_.size()) {
+            std::string cycle;
+            for (size_t i = 0; i < nodes_.size(); i++) {
+                if (indegree[i] > 0) {
+                    cycle += (cycle.empty() ? "" : ",") + nodes_[i]->name();
+                }
+            }
+            return Status(-1, "graph %s has a cycle through %s", name_.c_str(), cycle.c_str());
+        }
+        return Status::OK();
+    }
+
+    // 从 sink 和没有输出的节点往上游找，经过边和同步依赖都到不了的节点删掉
+    void eliminate_dead_nodes() {
+        auto ports = port_index();
+        std::unordered_map<const BaseNode*, int> index;
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            index[nodes_[i]] = i;
+        }
+        std::vector<std::vector<int>> prev(nodes_.size());
+        for (auto& [out, in] : edge_) {
+            prev[ports.at(in).node].push_back(ports.at(out).node);
+        }
+        for (auto& dep_info : depends_) {
+            for (auto dep : dep_info.deps()) {
+                prev[index.at(dep_info.node())].push_back(index.at(dep));
+            }
+        }
+
+        std::vector<bool> live(nodes_.size(), false);
+        std::vector<int> stack;
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (nodes_[i]->list_output().empty()) {
+                stack.push_back(i);
+            }
+        }
+        for (auto& sink : sinks_) {
+            stack.push_back(ports.at(sink).node);
+        }
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+            if (live[i]) {
+                continue;
+            }
+            live[i] = true;
+            for (int p : prev[i]) {
+                stack.push_back(p);
+            }
+        }
+
+        // 活节点的上游都是活的，只会有活节点到死节点的边
+        for (auto it = edge_.begin(); it != edge_.end();) {
+            if (!live[ports.at(it->second).node]) {
+                convertors_.erase(it->first);
+                it = edge_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        std::vector<DependentInfo> depends;
+        for (auto& dep_info : depends_) {
+            if (live[index.at(dep_info.node())]) {
+                depends.push_back(dep_info);
+            }
+        }
+        depends_.swap(depends);
+        std::vector<BaseNode*> nodes;
+        std::vector<std::shared_ptr<BaseNode>> owned;
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            if (live[i]) {
+                nodes.push_back(nodes_[i]);
+                owned.push_back(std::move(owned_[i]));
+            } else {
+                optimize_report_["removed_nodes"].push_back(nodes_[i]->name());
+                nodes_map_.erase(nodes_[i]->name());
+            }
+        }
+        nodes_.swap(nodes);
+        owned_.swap(owned);
+    }
+
     std::vector<BaseNode*> nodes_;
+    // 和 nodes_ 一一对应，节点可能和其它图共用
+    std::vector<std::shared_ptr<BaseNode>> owned_;
     std::unordered_map<std::string, std::string> edge_;
+    // 转换边，key 是上游输出
+    std::unordered_map<std::string, std::shared_ptr<BaseConvertor>> convertors_;
 
     // 节点 map 
     std::unordered_map<std::string, BaseNode*> nodes_map_;
@@ -271,8 +741,27 @@ private:
     // 节点依赖
     std::vector<DependentInfo> depends_;
 
+    // sink 流
+    std::unordered_set<std::string> sinks_;
+
     // 图配置
     json option_;
+    std::string name_ = "graph";
+
+    // 执行计划
+    std::once_flag plan_once_;
+    std::vector<NodePlan> exec_plan_;
+    bool planned_ = false;
+
+    // finalize 的结果
+    bool finalized_ = false;
+    std::unordered_set<std::string> discarded_;
+    json optimize_report_;
+
+    // 指标
+    std::once_flag metrics_once_;
+    std::vector<NodeRuntimeMetrics> node_metrics_;
+    GraphMetrics* graph_metrics_ = nullptr;
 };
 
 
@@ -0,0 +1,677 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "graph.h"
+
+namespace stream_dag {
+
+// 只读映射一个文件
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    Status open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return Status(-1, "open %s failed: %s", path.c_str(), strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return Status(-1, "stat %s failed: %s", path.c_str(), strerror(errno));
+        }
+        if (st.st_size > 0) {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                return Status(-1, "mmap %s failed: %s", path.c_str(), strerror(errno));
+            }
+            data_ = static_cast<const char*>(addr);
+            size_ = st.st_size;
+        }
+        ::close(fd);
+        return Status::OK();
+    }
+
+    void close() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 预编译的二进制图
+//   StreamGraph::load 要解析 JSON、按名字拼接和查找端口；二进制图在转换时把这些做完:
+//   字符串去重后放在字符串表，节点配置存成 CBOR，边、sink、同步依赖都用节点和端口的下标表示，另存一份拓扑序
+//   文件可以直接 mmap，加载时只做边界检查、按拓扑序创建节点、解析各节点的 CBOR 配置
+//   端口下标依赖节点类型里声明端口的顺序. 文件里同时存了端口名，节点类型改了端口后加载会报错，需要重新转换
+//   整数都是本机字节序的 uint32，各段按 4 字节对齐
+class GraphBinary {
+public:
+    static constexpr uint32_t kVersion = 3;
+    // 没有对应字符串，比如普通边的 convertor
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    enum SectionId {
+        kStrings,     // StringRecord
+        kNodes,       // NodeRecord
+        kPorts,       // uint32 字符串下标. 每个节点先输入后输出，按声明顺序
+        kEdges,       // EdgeRecord
+        kSinks,       // PortRecord
+        kDepends,     // DependRecord
+        kDependNodes, // uint32 节点下标
+        kTopo,        // uint32 节点下标，拓扑序. 环上的节点按原顺序排在最后
+        kBlob,        // 字符串内容和节点配置
+        kSectionCount,
+    };
+
+    struct Section {
+        uint32_t count;
+        uint32_t offset;
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t file_size;
+        uint32_t name;
+        Section sections[kSectionCount];
+    };
+
+    struct StringRecord {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct NodeRecord {
+        uint32_t name;
+        uint32_t type;
+        uint32_t option_offset; // CBOR，size 为 0 时没有配置
+        uint32_t option_size;
+        uint32_t first_port;
+        uint32_t input_count;
+        uint32_t output_count;
+        uint32_t exec;          // NodeExec. 版本 3 加入
+    };
+
+    // 输入、输出端口各自从 0 编号，和 list_input()、list_output() 的下标一致
+    struct EdgeRecord {
+        uint32_t from_node;
+        uint32_t from_port;
+        uint32_t to_node;
+        uint32_t to_port;
+        uint32_t convertor; // 转换函数注册名的字符串下标，普通边为 kNone. 版本 2 加入
+    };
+
+    struct PortRecord {
+        uint32_t node;
+        uint32_t port;
+    };
+
+    struct DependRecord {
+        uint32_t node;
+        uint32_t condition;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // 校验过的只读视图，不复制数据
+    class View {
+    public:
+        Status open(const char* data, size_t size) {
+            data_ = data;
+            if (size < sizeof(Header) || reinterpret_cast<uintptr_t>(data) % alignof(Header) != 0) {
+                return Status(-1, "graph binary too small or misaligned");
+            }
+            header_ = reinterpret_cast<const Header*>(data);
+            if (memcmp(header_->magic, "SDAG", 4) != 0) {
+                return Status(-1, "not a graph binary");
+            }
+            if (header_->version != kVersion) {
+                return Status(-1, "graph binary version %u, expect %u", header_->version, kVersion);
+            }
+            if (header_->file_size > size) {
+                return Status(-1, "graph binary truncated: %u > %zu", header_->file_size, size);
+            }
+            static const size_t record_size[kSectionCount] = {
+                sizeof(StringRecord), sizeof(NodeRecord), sizeof(uint32_t), sizeof(EdgeRecord),
+                sizeof(PortRecord), sizeof(DependRecord), sizeof(uint32_t), sizeof(uint32_t), 1,
+            };
+            for (int i = 0; i < kSectionCount; i++) {
+                const Section& section = header_->sections[i];
+                if (section.offset % 4 != 0 ||
+                    !in_file(section.offset, (uint64_t) section.count * record_size[i])) {
+                    return Status(-1, "graph binary section %d out of range", i);
+                }
+            }
+            return check();
+        }
+
+        const Header& header() const { return *header_; }
+
+        uint32_t count(SectionId id) const { return header_->sections[id].count; }
+
+        template<class T>
+        const T& at(SectionId id, uint32_t index) const {
+            return reinterpret_cast<const T*>(data_ + header_->sections[id].offset)[index];
+        }
+
+        std::string_view str(uint32_t index) const {
+            const StringRecord& record = at<StringRecord>(kStrings, index);
+            return std::string_view(data_ + record.offset, record.size);
+        }
+
+        const NodeRecord& node(uint32_t index) const { return at<NodeRecord>(kNodes, index); }
+
+        std::string_view input_name(const NodeRecord& node, uint32_t port) const {
+            return str(at<uint32_t>(kPorts, node.first_port + port));
+        }
+
+        std::string_view output_name(const NodeRecord& node, uint32_t port) const {
+            return str(at<uint32_t>(kPorts, node.first_port + node.input_count + port));
+        }
+
+        // 配置损坏时抛异常
+        json option(const NodeRecord& node) const {
+            if (node.option_size == 0) {
+                return json::object();
+            }
+            const uint8_t* begin = reinterpret_cast<const uint8_t*>(data_ + node.option_offset);
+            return json::from_cbor(begin, begin + node.option_size);
+        }
+
+    private:
+        bool in_file(uint64_t offset, uint64_t size) const {
+            return offset + size <= header_->file_size;
+        }
+
+        // 所有下标都在范围内，之后的访问不再检查
+        Status check() const {
+            uint32_t strings = count(kStrings), nodes = count(kNodes), ports = count(kPorts);
+            if (header_->name >= strings) {
+                return Status(-1, "graph binary bad name");
+            }
+            for (uint32_t i = 0; i < strings; i++) {
+                const StringRecord& record = at<StringRecord>(kStrings, i);
+                if (!in_file(record.offset, record.size)) {
+                    return Status(-1, "graph binary string %u out of range", i);
+                }
+            }
+            for (uint32_t i = 0; i < ports; i++) {
+                if (at<uint32_t>(kPorts, i) >= strings) {
+                    return Status(-1, "graph binary port %u bad name", i);
+                }
+            }
+            for (uint32_t i = 0; i < nodes; i++) {
+                const NodeRecord& record = node(i);
+                if (record.name >= strings || record.type >= strings ||
+                    !in_file(record.option_offset, record.option_size) ||
+                    (uint64_t) record.first_port + record.input_count + record.output_count > ports ||
+                    record.exec > kExecBlocking) {
+                    return Status(-1, "graph binary node %u out of range", i);
+                }
+            }
+            for (uint32_t i = 0; i < count(kEdges); i++) {
+                const EdgeRecord& edge = at<EdgeRecord>(kEdges, i);
+                if (edge.from_node >= nodes || edge.to_node >= nodes ||
+                    edge.from_port >= node(edge.from_node).output_count ||
+                    edge.to_port >= node(edge.to_node).input_count ||
+                    (edge.convertor != kNone && edge.convertor >= strings)) {
+                    return Status(-1, "graph binary edge %u out of range", i);
+                }
+            }
+            for (uint32_t i = 0; i < count(kSinks); i++) {
+                const PortRecord& sink = at<PortRecord>(kSinks, i);
+                if (sink.node >= nodes || sink.port >= node(sink.node).output_count) {
+                    return Status(-1, "graph binary sink %u out of range", i);
+                }
+            }
+            for (uint32_t i = 0; i < count(kDepends); i++) {
+                const DependRecord& depend = at<DependRecord>(kDepends, i);
+                if (depend.node >= nodes || depend.condition >= strings ||
+                    (uint64_t) depend.first + depend.count > count(kDependNodes)) {
+                    return Status(-1, "graph binary depend %u out of range", i);
+                }
+            }
+            for (uint32_t i = 0; i < count(kDependNodes); i++) {
+                if (at<uint32_t>(kDependNodes, i) >= nodes) {
+                    return Status(-1, "graph binary depend node %u out of range", i);
+                }
+            }
+            if (count(kTopo) != nodes) {
+                return Status(-1, "graph binary topo size mismatch");
+            }
+            std::vector<bool> seen(nodes);
+            for (uint32_t i = 0; i < nodes; i++) {
+                uint32_t index = at<uint32_t>(kTopo, i);
+                if (index >= nodes || seen[index]) {
+                    return Status(-1, "graph binary bad topo order");
+                }
+                seen[index] = true;
+            }
+            return Status::OK();
+        }
+
+        const char* data_ = nullptr;
+        const Header* header_ = nullptr;
+    };
+
+    // JSON 图（StreamGraph::load 的格式）转成二进制. 需要创建各节点来确定端口下标，节点类型必须已经注册
+    static Status from_json(const json& graph, std::string* out) {
+        Writer writer;
+        Status status = writer.build(graph);
+        if (!status.ok()) {
+            return status;
+        }
+        *out = writer.serialize();
+        return Status::OK();
+    }
+
+    // 二进制图转回 JSON，不需要注册节点类型
+    static Status to_json(const char* data, size_t size, json* out) {
+        View view;
+        Status status = view.open(data, size);
+        if (!status.ok()) {
+            return status;
+        }
+        json graph;
+        graph["name"] = view.str(view.header().name);
+        json& nodes = graph["nodes"] = json::array();
+        for (uint32_t i = 0; i < view.count(kNodes); i++) {
+            const NodeRecord& node = view.node(i);
+            json item = {{"name", view.str(node.name)}, {"type", view.str(node.type)}};
+            try {
+                json option = view.option(node);
+                if (!option.empty()) {
+                    item["option"] = std::move(option);
+                }
+            } catch (const std::exception& e) {
+                return Status(-1, "graph binary node %u bad option: %s", i, e.what());
+            }
+            if (node.exec != kExecBthread) {
+                item["exec"] = node_exec_name((NodeExec) node.exec);
+            }
+            nodes.push_back(std::move(item));
+        }
+        auto port_name = [&](uint32_t node, std::string_view port) {
+            return std::string(view.str(view.node(node).name)) + "/" + std::string(port);
+        };
+        json& edges = graph["edges"] = json::array();
+        for (uint32_t i = 0; i < view.count(kEdges); i++) {
+            const EdgeRecord& edge = view.at<EdgeRecord>(kEdges, i);
+            edges.push_back({
+                {"from", port_name(edge.from_node, view.output_name(view.node(edge.from_node), edge.from_port))},
+                {"to", port_name(edge.to_node, view.input_name(view.node(edge.to_node), edge.to_port))},
+            });
+            if (edge.convertor != kNone) {
+                edges.back()["convertor"] = view.str(edge.convertor);
+            }
+        }
+        for (uint32_t i = 0; i < view.count(kSinks); i++) {
+            const PortRecord& sink = view.at<PortRecord>(kSinks, i);
+            graph["sinks"].push_back(port_name(sink.node, view.output_name(view.node(sink.node), sink.port)));
+        }
+        for (uint32_t i = 0; i < view.count(kDepends); i++) {
+            const DependRecord& depend = view.at<DependRecord>(kDepends, i);
+            json item = {{"node", view.str(view.node(depend.node).name)}, {"condition", view.str(depend.condition)}};
+            json& dependent = item["dependent"] = json::array();
+            for (uint32_t j = 0; j < depend.count; j++) {
+                dependent.push_back(view.str(view.node(view.at<uint32_t>(kDependNodes, depend.first + j)).name));
+            }
+            graph["depends"].push_back(std::move(item));
+        }
+        *out = std::move(graph);
+        return Status::OK();
+    }
+
+    // 从内存里的二进制图构建 g，g 应当是空图. 节点按拓扑序加入
+    static Status load(StreamGraph& g, const char* data, size_t size) {
+        View view;
+        Status status = view.open(data, size);
+        if (!status.ok()) {
+            return status;
+        }
+        g.set_name(std::string(view.str(view.header().name)));
+
+        // 同一个类型只查一次注册表
+        std::vector<const NodeFactory::Creator*> creators(view.count(kStrings));
+        std::vector<BaseNode*> nodes(view.count(kNodes));
+        for (uint32_t i = 0; i < view.count(kTopo); i++) {
+            uint32_t index = view.at<uint32_t>(kTopo, i);
+            const NodeRecord& record = view.node(index);
+            std::string type(view.str(record.type));
+            std::string name(view.str(record.name));
+            const NodeFactory::Creator*& creator = creators[record.type];
+            if (creator == nullptr) {
+                creator = NodeFactory::GetCreator(type);
+                if (creator == nullptr) {
+                    return Status(-1, "unknown node type: %s", type.c_str());
+                }
+            }
+            BaseNode* node = g.add_node((*creator)(name, type));
+            nodes[index] = node;
+            status = check_ports(view, record, *node);
+            if (!status.ok()) {
+                return status;
+            }
+            json option;
+            try {
+                option = view.option(record);
+            } catch (const std::exception& e) {
+                return Status(-1, "node %s bad option: %s", name.c_str(), e.what());
+            }
+            node->set_exec((NodeExec) record.exec);
+            status = node->configure(option);
+            if (!status.ok()) {
+                return status;
+            }
+        }
+
+        for (uint32_t i = 0; i < view.count(kEdges); i++) {
+            const EdgeRecord& edge = view.at<EdgeRecord>(kEdges, i);
+            const std::string& from = nodes[edge.from_node]->list_output()[edge.from_port]->fullname();
+            const std::string& to = nodes[edge.to_node]->list_input()[edge.to_port]->fullname();
+            if (edge.convertor == kNone) {
+                g.add_edge(from, to);
+                continue;
+            }
+            std::string name(view.str(edge.convertor));
+            std::shared_ptr<BaseConvertor> convertor = ConvertorRegistry::Get(name);
+            if (convertor == nullptr) {
+                return Status(-1, "unknown convertor: %s", name.c_str());
+            }
+            g.add_edge(from, to, convertor);
+        }
+        for (uint32_t i = 0; i < view.count(kSinks); i++) {
+            const PortRecord& sink = view.at<PortRecord>(kSinks, i);
+            g.mark_sink(nodes[sink.node]->list_output()[sink.port]->fullname());
+        }
+        for (uint32_t i = 0; i < view.count(kDepends); i++) {
+            const DependRecord& depend = view.at<DependRecord>(kDepends, i);
+            std::vector<BaseNode*> deps;
+            for (uint32_t j = 0; j < depend.count; j++) {
+                deps.push_back(nodes[view.at<uint32_t>(kDependNodes, depend.first + j)]);
+            }
+            g.add_node_dep(nodes[depend.node], deps, Condition(std::string(view.str(depend.condition))));
+        }
+        return Status::OK();
+    }
+
+    static Status load_file(StreamGraph& g, const std::string& path) {
+        MappedFile file;
+        Status status = file.open(path);
+        if (!status.ok()) {
+            return status;
+        }
+        return load(g, file.data(), file.size());
+    }
+
+    static bool is_binary(const char* data, size_t size) {
+        return size >= 4 && memcmp(data, "SDAG", 4) == 0;
+    }
+
+private:
+    // 节点类型当前的端口和文件里记录的一致
+    static Status check_ports(const View& view, const NodeRecord& record, BaseNode& node) {
+        auto& inputs = node.list_input();
+        auto& outputs = node.list_output();
+        if (inputs.size() != record.input_count || outputs.size() != record.output_count) {
+            return Status(-1, "node %s ports changed, regenerate graph binary", node.name().c_str());
+        }
+        auto same = [&](const std::string& fullname, std::string_view port) {
+            size_t prefix = node.name().size() + 1;
+            return fullname.size() == prefix + port.size() && fullname.compare(prefix, port.size(), port.data(), port.size()) == 0;
+        };
+        for (uint32_t i = 0; i < record.input_count; i++) {
+            if (!same(inputs[i]->fullname(), view.input_name(record, i))) {
+                return Status(-1, "node %s input %u changed, regenerate graph binary", node.name().c_str(), i);
+            }
+        }
+        for (uint32_t i = 0; i < record.output_count; i++) {
+            if (!same(outputs[i]->fullname(), view.output_name(record, i))) {
+                return Status(-1, "node %s output %u changed, regenerate graph binary", node.name().c_str(), i);
+            }
+        }
+        return Status::OK();
+    }
+
+    class Writer {
+    public:
+        Status build(const json& graph) {
+            static const json empty = json::array();
+            auto list = [&](const char* key) -> const json& {
+                auto it = graph.find(key);
+                return it == graph.end() ? empty : *it;
+            };
+            name_ = intern(graph.value("name", "graph"));
+
+            // 端口全名 -> (节点, 端口)
+            std::unordered_map<std::string, PortRecord> inputs, outputs;
+            std::unordered_map<std::string, uint32_t> node_index;
+            for (auto& item : list("nodes")) {
+                std::string name = item.value("name", "");
+                std::string type = item.value("type", "");
+                const NodeFactory::Creator* creator = NodeFactory::GetCreator(type);
+                if (creator == nullptr) {
+                    return Status(-1, "unknown node type: %s", type.c_str());
+                }
+                std::unique_ptr<BaseNode> node = (*creator)(name, type);
+                uint32_t index = nodes_.size();
+                if (!node_index.emplace(name, index).second) {
+                    return Status(-1, "duplicate node name: %s", name.c_str());
+                }
+
+                NodeRecord record{};
+                NodeExec exec = kExecBthread;
+                if (item.contains("exec") && !node_exec_from_name(item["exec"], &exec)) {
+                    return Status(-1, "node %s unknown exec: %s", name.c_str(), item["exec"].dump().c_str());
+                }
+                record.exec = exec;
+                record.name = intern(name);
+                record.type = intern(type);
+                record.first_port = ports_.size();
+                record.input_count = node->list_input().size();
+                record.output_count = node->list_output().size();
+                for (uint32_t i = 0; i < record.input_count; i++) {
+                    const std::string& fullname = node->list_input()[i]->fullname();
+                    ports_.push_back(intern(fullname.substr(name.size() + 1)));
+                    inputs[fullname] = PortRecord{index, i};
+                }
+                for (uint32_t i = 0; i < record.output_count; i++) {
+                    const std::string& fullname = node->list_output()[i]->fullname();
+                    ports_.push_back(intern(fullname.substr(name.size() + 1)));
+                    outputs[fullname] = PortRecord{index, i};
+                }
+                auto option = item.find("option");
+                if (option != item.end() && !option->empty()) {
+                    std::vector<uint8_t> cbor = json::to_cbor(*option);
+                    record.option_offset = blob_.size();
+                    record.option_size = cbor.size();
+                    blob_.append(cbor.begin(), cbor.end());
+                }
+                nodes_.push_back(record);
+            }
+
+            for (auto& edge : list("edges")) {
+                std::string from = edge.value("from", ""), to = edge.value("to", "");
+                auto out = outputs.find(from);
+                auto in = inputs.find(to);
+                if (out == outputs.end()) {
+                    return Status(-1, "edge from unknown output: %s", from.c_str());
+                }
+                if (in == inputs.end()) {
+                    return Status(-1, "edge to unknown input: %s", to.c_str());
+                }
+                uint32_t convertor = kNone;
+                if (edge.contains("convertor")) {
+                    std::string name = edge["convertor"];
+                    if (ConvertorRegistry::Get(name) == nullptr) {
+                        return Status(-1, "unknown convertor: %s", name.c_str());
+                    }
+                    convertor = intern(name);
+                }
+                edges_.push_back(EdgeRecord{out->second.node, out->second.port, in->second.node, in->second.port, convertor});
+            }
+            for (auto& sink : list("sinks")) {
+                auto out = outputs.find(sink.get<std::string>());
+                if (out == outputs.end()) {
+                    return Status(-1, "unknown sink: %s", sink.get<std::string>().c_str());
+                }
+                sinks_.push_back(out->second);
+            }
+            for (auto& depend : graph.contains("depends") ? list("depends") : list("depents")) {
+                auto node = node_index.find(depend.value("node", ""));
+                if (node == node_index.end()) {
+                    return Status(-1, "depend on unknown node: %s", depend.value("node", "").c_str());
+                }
+                DependRecord record{node->second, intern(depend.value("condition", "")), (uint32_t) depend_nodes_.size(), 0};
+                for (auto& dep : depend.value("dependent", json::array())) {
+                    auto prev = node_index.find(dep.get<std::string>());
+                    if (prev == node_index.end()) {
+                        return Status(-1, "depend on unknown node: %s", dep.get<std::string>().c_str());
+                    }
+                    depend_nodes_.push_back(prev->second);
+                    record.count += 1;
+                }
+                depends_.push_back(record);
+            }
+            build_topo();
+            return Status::OK();
+        }
+
+        std::string serialize() {
+            Header header{};
+            memcpy(header.magic, "SDAG", 4);
+            header.version = kVersion;
+            header.name = name_;
+
+            size_t offset = sizeof(Header);
+            auto place = [&](SectionId id, size_t count, size_t record_size) {
+                header.sections[id] = Section{(uint32_t) count, (uint32_t) offset};
+                offset += (count * record_size + 3) / 4 * 4;
+            };
+            place(kStrings, strings_.size(), sizeof(StringRecord));
+            place(kNodes, nodes_.size(), sizeof(NodeRecord));
+            place(kPorts, ports_.size(), sizeof(uint32_t));
+            place(kEdges, edges_.size(), sizeof(EdgeRecord));
+            place(kSinks, sinks_.size(), sizeof(PortRecord));
+            place(kDepends, depends_.size(), sizeof(DependRecord));
+            place(kDependNodes, depend_nodes_.size(), sizeof(uint32_t));
+            place(kTopo, topo_.size(), sizeof(uint32_t));
+            place(kBlob, blob_.size(), 1);
+            header.file_size = offset;
+
+            // blob 里的偏移换成文件内的偏移
+            uint32_t blob_start = header.sections[kBlob].offset;
+            for (auto& record : strings_) {
+                record.offset += blob_start;
+            }
+            for (auto& record : nodes_) {
+                record.option_offset += blob_start;
+            }
+
+            std::string out(offset, '\0');
+            auto write = [&](SectionId id, const void* data, size_t bytes) {
+                if (bytes > 0) {
+                    memcpy(&out[header.sections[id].offset], data, bytes);
+                }
+            };
+            memcpy(&out[0], &header, sizeof(header));
+            write(kStrings, strings_.data(), strings_.size() * sizeof(StringRecord));
+            write(kNodes, nodes_.data(), nodes_.size() * sizeof(NodeRecord));
+            write(kPorts, ports_.data(), ports_.size() * sizeof(uint32_t));
+            write(kEdges, edges_.data(), edges_.size() * sizeof(EdgeRecord));
+            write(kSinks, sinks_.data(), sinks_.size() * sizeof(PortRecord));
+            write(kDepends, depends_.data(), depends_.size() * sizeof(DependRecord));
+            write(kDependNodes, depend_nodes_.data(), depend_nodes_.size() * sizeof(uint32_t));
+            write(kTopo, topo_.data(), topo_.size() * sizeof(uint32_t));
+            write(kBlob, blob_.data(), blob_.size());
+            return out;
+        }
+
+    private:
+        uint32_t intern(const std::string& value) {
+            auto [it, inserted] = string_index_.emplace(value, strings_.size());
+            if (inserted) {
+                strings_.push_back(StringRecord{(uint32_t) blob_.size(), (uint32_t) value.size()});
+                blob_.append(value);
+            }
+            return it->second;
+        }
+
+        // 按流的边和同步依赖排拓扑序
+        void build_topo() {
+            std::vector<std::vector<uint32_t>> next(nodes_.size());
+            std::vector<uint32_t> indegree(nodes_.size());
+            auto link = [&](uint32_t from, uint32_t to) {
+                next[from].push_back(to);
+                indegree[to] += 1;
+            };
+            for (auto& edge : edges_) {
+                link(edge.from_node, edge.to_node);
+            }
+            for (auto& depend : depends_) {
+                for (uint32_t j = 0; j < depend.count; j++) {
+                    link(depend_nodes_[depend.first + j], depend.node);
+                }
+            }
+            std::vector<bool> placed(nodes_.size());
+            for (uint32_t i = 0; i < nodes_.size(); i++) {
+                if (indegree[i] == 0) {
+                    topo_.push_back(i);
+                    placed[i] = true;
+                }
+            }
+            for (size_t head = 0; head < topo_.size(); head++) {
+                for (uint32_t to : next[topo_[head]]) {
+                    if (--indegree[to] == 0) {
+                        topo_.push_back(to);
+                        placed[to] = true;
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < nodes_.size(); i++) {
+                if (!placed[i]) {
+                    topo_.push_back(i);
+                }
+            }
+        }
+
+        uint32_t name_ = 0;
+        std::unordered_map<std::string, uint32_t> string_index_;
+        std::vector<StringRecord> strings_;
+        std::vector<NodeRecord> nodes_;
+        std::vector<uint32_t> ports_;
+        std::vector<EdgeRecord> edges_;
+        std::vector<PortRecord> sinks_;
+        std::vector<DependRecord> depends_;
+        std::vector<uint32_t> depend_nodes_;
+        std::vector<uint32_t> topo_;
+        std::string blob_;
+    };
+};
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include "butil/containers/doubly_buffered_data.h"
+#include "graph.h"
+#include "graph_binary.h"
+#include "context_pool.h"
+
+namespace stream_dag {
+
+// 发布出去的一个版本: 图、它的 ctx 池和原始定义. 发布后不再修改
+//   请求开始时取一次，执行期间一直持有，最后一个持有者放手后释放
+class GraphVersion {
+public:
+    GraphVersion(uint64_t version, const json& definition)
+        : version_(version), definition_(definition) {}
+
+    uint64_t version() const { return version_; }
+    const json& definition() const { return definition_; }
+    StreamGraph& graph() { return graph_; }
+    ContextPool& pool() { return pool_; }
+
+    // 从上一个版本直接共用的节点数
+    size_t reused_nodes() const { return reused_nodes_; }
+
+private:
+    friend class GraphRegistry;
+
+    uint64_t version_;
+    json definition_;
+    StreamGraph graph_;
+    // 依赖 graph_，要在它之后构造
+    ContextPool pool_{graph_};
+    size_t reused_nodes_ = 0;
+};
+
+// 按名字登记的图，支持热更新
+//   publish 在调用方线程加载、校验新版本，成功后原子替换，失败时保留旧版本
+//   新版本按 options 做 finalize 优化，默认会删掉到不了 sink 的节点、丢弃没人读的输出. 执行后要读的输出标成 sink 或者关掉优化
+//   名字、类型、配置、执行方式都没变的节点直接和上一个版本共用，不重新 init. channel 由 ChannelPool 按配置共用
+//   新请求拿到新版本，正在执行的请求继续用旧版本，旧版本在最后一个请求结束后释放
+//
+//   auto version = GraphRegistry::instance().get("chat");
+//   auto ctx = version->pool().acquire();
+//   Status status = executor.run(version->graph(), *ctx);
+class GraphRegistry {
+public:
+    static GraphRegistry& instance() {
+        static GraphRegistry registry;
+        return registry;
+    }
+
+    // 当前版本，没有发布过时返回 nullptr
+    //   DoublyBufferedData 读的时候只锁本线程的锁，不和其他请求竞争. publish 切换时才会等正在读的线程
+    std::shared_ptr<GraphVersion> get(const std::string& name) {
+        butil::DoublyBufferedData<VersionMap>::ScopedPtr versions;
+        if (versions_.Read(&versions) != 0) {
+            return nullptr;
+        }
+        auto it = versions->find(name);
+        if (it == versions->end()) {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    Status publish(const std::string& name, const json& definition,
+                   const GraphOptimizeOptions& options = GraphOptimizeOptions()) {
+        // 同一时间只有一个 publish，版本号递增
+        std::unique_lock<bthread::Mutex> lock_(publish_mutex_);
+        std::shared_ptr<GraphVersion> prev = get(name);
+        auto next = std::make_shared<GraphVersion>(prev ? prev->version() + 1 : 1, definition);
+        StreamGraph& g = next->graph_;
+        g.set_name(name);
+        Status status = g.load_json(definition, prev ? &prev->graph() : nullptr);
+        if (status.ok()) {
+            status = g.finalize(options);
+        }
+        if (!status.ok()) {
+            return status;
+        }
+        if (prev) {
+            for (auto node : g.list_node()) {
+                if (prev->graph().share_node(node->name()).get() == node) {
+                    next->reused_nodes_++;
+                }
+            }
+        }
+        // 两份表各改一次，第二次前等读旧表的线程读完
+        auto update = [&name, &next](VersionMap& versions) -> size_t {
+            versions[name] = next;
+            return 1;
+        };
+        versions_.Modify(update);
+        return Status::OK();
+    }
+
+    // JSON 图或者 graph_convert 转出的二进制图
+    Status publish_file(const std::string& name, const std::string& path,
+                        const GraphOptimizeOptions& options = GraphOptimizeOptions()) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            return Status(-1, "open %s failed", path.c_str());
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string data = buffer.str();
+        json definition;
+        if (GraphBinary::is_binary(data.data(), data.size())) {
+            Status status = GraphBinary::to_json(data.data(), data.size(), &definition);
+            if (!status.ok()) {
+                return status;
+            }
+        } else {
+            definition = json::parse(data, nullptr, false);
+            if (definition.is_discarded()) {
+                return Status(-1, "%s is neither json nor graph binary", path.c_str());
+            }
+        }
+        return publish(name, definition, options);
+    }
+
+    // 各图的当前版本
+    json dump() {
+        json result = json::object();
+        butil::DoublyBufferedData<VersionMap>::ScopedPtr versions;
+        if (versions_.Read(&versions) != 0) {
+            return result;
+        }
+        for (auto& [name, version] : *versions) {
+            result[name] = {
+                {"version", version->version()},
+                {"nodes", version->graph().list_node().size()},
+                {"reused_nodes", version->reused_nodes()},
+            };
+        }
+        return result;
+    }
+
+private:
+    using VersionMap = std::map<std::string, std::shared_ptr<GraphVersion>>;
+
+    bthread::Mutex publish_mutex_;
+    butil::DoublyBufferedData<VersionMap> versions_;
+};
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 #include "stream-dag.h"
+#include "channel_pool.h"
 #include <brpc/channel.h>
 #include <brpc/progressive_reader.h>
+#include <bthread/countdown_event.h>
 
 namespace stream_dag {
 
@@ -35,56 +37,62 @@ public:
     int status_code;
     std::map<std::string, std::string> headers;
     json body;
+    int error_code = 0;     // 请求失败（连接失败、超时等）时为 brpc 的错误码
+    std::string error_text;
 
     json to_json() {
         json j;
         j["status_code"] = status_code;
+        j["error_code"] = error_code;
+        j["error_text"] = error_text;
         j["headers"] = headers;
         j["body"] = body;
         return j;
     }
 };
 
+// ProgressiveReader 只给出裸指针，这里是唯一一次拷贝：直接写进 IOBuf block，之后在图里只传引用
+//   body 在 ctx 里，ctx 复用后会给下一个请求. 读完之后才能让节点返回，done 在 OnEndOfMessage 里通知
 class StreamHttpReader : public brpc::ProgressiveReader {
 public:
-    StreamHttpReader(Stream<std::string>& body) : body_(body) {
+    StreamHttpReader(ByteStream& body, bthread::CountdownEvent* done) : body_(body), done_(done) {
         body.set_auto_close(false);
     }
 
     butil::Status OnReadOnePart (const void* data, size_t length) override {
-        return body_.append(std::string((const char*)data, length));
+        return body_.append(data, length);
     }
 
     void OnEndOfMessage (const butil::Status& status) override {
         body_.half_close(status);
+        bthread::CountdownEvent* done = done_;
         delete this;
+        done->signal();
     }
 
 private:
-    Stream<std::string>& body_;
+    ByteStream& body_;
+    bthread::CountdownEvent* done_;
 };
 
 // ref https://github.com/apache/brpc/blob/master/docs/cn/http_client.md
 class HttpNode : public BaseNode {
 public:
+    // channel 从进程级 ChannelPool 获取，相同配置的节点实例共享连接
     Status init(json& option) {
-        std::string host = option.value("host", "https://api.bing.microsoft.com");
-        std::string lb = option.value("lb", "");
-        int timeout_ms = option.value("timeout_ms", 20000);
-        int max_retry = option.value("max_retry", 3);
-
-        brpc::ChannelOptions opt;
-        opt.protocol = brpc::PROTOCOL_HTTP;
-        if (timeout_ms > 0) { opt.timeout_ms = timeout_ms; }
-        if (max_retry > 0) { opt.max_retry = max_retry; }
-        return (0 == chann_.Init(host.c_str(), lb.c_str(), &opt)) ? Status::OK() : Status(-1, "init channnel failed");
+        chann_ = ChannelPool::instance().get(option);
+        return chann_ ? Status::OK() : Status(-1, "init channnel failed");
     }
 
-    Status run(Stream<HttpRequest>& request_, Stream<HttpResponse>& response_, Stream<std::string>& stream_body) {
+    Status run(Stream<HttpRequest>& request_, Stream<HttpResponse>& response_, ByteStream& stream_body) {
         // 这里面没有必要写异步任务
         // 直接同步执行, 阻塞时 brpc 会自动调度到其它bthread
         // 
 
+        if (chann_ == nullptr) {
+            return Status(-1, "channel not initialized");
+        }
+
         HttpRequest requestdata, *request;
         request_.read(requestdata);
 
@@ -105,6 +113,9 @@ public:
         
 
         brpc::Controller cntl;
+        if (request->timeout_ms > 0) {
+            cntl.set_timeout_ms(request->timeout_ms);
+        }
         cntl.http_request().uri() = request->url;
         cntl.http_request().set_method(method);
         
@@ -125,25 +136,40 @@ public:
         }
 
         if (!request->stream) {
-            chann_.CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
+            // 同步 RPC 期间记为等外部 IO 的阻塞，不算在节点的 CPU 时间里，也不算死锁
+            BlockedScope blocked(request->url, true, true);
+            chann_->CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
         } else {
             cntl.response_will_be_read_progressively();
-            chann_.CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
-            cntl.ReadProgressiveAttachmentBy(new StreamHttpReader(stream_body));
+            BlockedScope blocked(request->url, true, true);
+            chann_->CallMethod(nullptr, &cntl, nullptr, nullptr, nullptr);
+            // 等 body 读完再返回. 节点返回后 ctx 可能被 ContextPool 重置给下一个请求，
+            // 之后到达的数据会写进别的请求的流里. 读失败时 brpc 也会调用 OnEndOfMessage
+            bthread::CountdownEvent body_done(1);
+            cntl.ReadProgressiveAttachmentBy(new StreamHttpReader(stream_body, &body_done));
+            body_done.wait();
         }
 
         HttpResponse responsedata, *response;
         response = &responsedata;
 
         response->status_code = cntl.http_response().status_code();
+        if (cntl.Failed()) {
+            response->error_code = cntl.ErrorCode();
+            response->error_text = cntl.ErrorText();
+        }
         for (auto it=cntl.http_response().HeaderBegin(); it != cntl.http_response().HeaderEnd(); ++it) {
             response->headers[it->first] = it->second;
         }
 
-        // 解析响应体
+        // 解析响应体. 直接在 IOBuf 分段上解析，不是 json 时 body 为 null
+        // 原始字节同时写到 stream_body，只传 block 引用
         if (!cntl.response_attachment().empty()) {
-            // 如果内容是 '\n\n'会不会 core?
-            response->body = json::parse(cntl.response_attachment().to_string());
+            json body = parse_json(cntl.response_attachment());
+            if (!body.is_discarded()) {
+                response->body = std::move(body);
+            }
+            stream_body.append(std::move(cntl.response_attachment()));
         }
         response_.append(responsedata);
         return Status::OK();
@@ -152,11 +178,11 @@ public:
     DECLARE_PARAMS (
         INPUT(request_, Stream<HttpRequest>),
         OUTPUT(response_, Stream<HttpResponse>),
-        OUTPUT(stream_body, Stream<std::string>),
+        OUTPUT(stream_body, ByteStream),
     );
 
 private:
-    brpc::Channel chann_;
+    std::shared_ptr<brpc::Channel> chann_;
 
 };
 REGISTER_CLASS(HttpNode);
@@ -0,0 +1,306 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <memory_resource>
+#include <vector>
+#include "butil/logging.h"
+#include "bthread/bthread.h"
+#include "bthread/mutex.h"
+#include <bvar/bvar.h>
+#include "node.h"
+#include "node_state.h"
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 一个正在执行的请求. 由执行器创建，执行期间挂在 InflightRegistry 上
+//   输出流在查看时才从 ctx 里取，注册本身只有一次 vector 分配
+class InflightRequest {
+public:
+    InflightRequest(BaseContext& ctx, const std::string& graph) : ctx_(ctx), graph_(graph), nodes_(&ctx.arena()) {
+        admit_us_ = butil::gettimeofday_us();
+    }
+
+    void add_node(BaseNode* node, const NodeRunState* state) {
+        nodes_.push_back({node, state});
+    }
+
+    // 阻塞最久的节点已经阻塞了多久，没有阻塞的节点返回 0
+    int64_t max_blocked_us(int64_t now) const {
+        int64_t result = 0;
+        for (auto& [node, state] : nodes_) {
+            int64_t since = state->blocked_since_us.load(std::memory_order_relaxed);
+            if (state->state.load(std::memory_order_acquire) == NodeRunState::kBlocked && since > 0) {
+                result = std::max(result, now - since);
+            }
+        }
+        return result;
+    }
+
+    // 没有节点在运行，但有节点在等流，一般就是死锁了
+    //   有节点在等外部 IO 时不算，IO 返回后请求还能继续
+    bool deadlocked() const {
+        bool blocked = false;
+        for (auto& [node, state] : nodes_) {
+            int s = state->state.load(std::memory_order_acquire);
+            if (s == NodeRunState::kRunning) {
+                return false;
+            }
+            if (s == NodeRunState::kBlocked) {
+                if (state->blocked_external.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                blocked = true;
+            }
+        }
+        return blocked;
+    }
+
+    json inspect(int64_t now) {
+        json result;
+        result["graph"] = graph_;
+        result["admit_us"] = admit_us_;
+        result["elapsed_us"] = now - admit_us_;
+        result["cancelled"] = ctx_.is_cancelled();
+        result["deadlock"] = deadlocked();
+        json& nodes = result["nodes"] = json::array();
+        for (auto& [node, state] : nodes_) {
+            json info;
+            int s = state->state.load(std::memory_order_acquire);
+            info["name"] = node->name();
+            info["type"] = node->type();
+            info["state"] = NodeRunState::state_name(s);
+            info["start_us"] = state->start_us.load(std::memory_order_relaxed);
+            const std::string* blocked_on = state->blocked_on.load(std::memory_order_relaxed);
+            int64_t since = state->blocked_since_us.load(std::memory_order_relaxed);
+            if (s == NodeRunState::kBlocked && blocked_on != nullptr) {
+                info["blocked_on"] = *blocked_on;
+                info["external"] = state->blocked_external.load(std::memory_order_relaxed);
+                info["blocked_us"] = since > 0 ? now - since : 0;
+            }
+            json& outputs = info["outputs"] = json::array();
+            for_each_output(node, [&](PipeStreamBase* stream) {
+                outputs.push_back(stream->inspect());
+            });
+            nodes.push_back(info);
+        }
+        return result;
+    }
+
+    // 取消请求: 标记 ctx 并关闭所有输出流，阻塞在读上的节点会收到 closed
+    void cancel() {
+        ctx_.cancel();
+        for (auto& [node, state] : nodes_) {
+            for_each_output(node, [](PipeStreamBase* stream) {
+                stream->close();
+            });
+        }
+    }
+
+    std::atomic<bool> stall_reported{false};
+
+private:
+    template<class Fn>
+    void for_each_output(BaseNode* node, Fn&& fn) {
+        for (auto& out : node->list_output()) {
+            PipeStreamBase* stream = out->stream_base(ctx_.get_output(out->fullname()));
+            if (stream) {
+                fn(stream);
+            }
+        }
+    }
+
+    friend class InflightRegistry;
+
+    BaseContext& ctx_;
+    const std::string& graph_;
+    int64_t admit_us_ = 0;
+    std::pmr::vector<std::pair<BaseNode*, const NodeRunState*>> nodes_;
+
+    // 侵入式链表，注册和注销都不需要分配内存
+    InflightRequest* prev_ = nullptr;
+    InflightRequest* next_ = nullptr;
+};
+
+// 进程内所有正在执行的请求. 在 brpc 内置的 /vars/stream_dag_inflight 页面查看
+class InflightRegistry {
+public:
+    static void add(InflightRequest* request) {
+        expose();
+        std::unique_lock<bthread::Mutex> lock_(mutex());
+        InflightRequest*& head = list();
+        request->prev_ = nullptr;
+        request->next_ = head;
+        if (head) {
+            head->prev_ = request;
+        }
+        head = request;
+    }
+
+    static void remove(InflightRequest* request) {
+        std::unique_lock<bthread::Mutex> lock_(mutex());
+        if (request->prev_) {
+            request->prev_->next_ = request->next_;
+        } else {
+            list() = request->next_;
+        }
+        if (request->next_) {
+            request->next_->prev_ = request->prev_;
+        }
+        request->prev_ = request->next_ = nullptr;
+    }
+
+    // 持锁遍历，回调期间请求不会结束
+    template<class Fn>
+    static void for_each(Fn&& fn) {
+        std::unique_lock<bthread::Mutex> lock_(mutex());
+        for (InflightRequest* request = list(); request != nullptr; request = request->next_) {
+            fn(*request);
+        }
+    }
+
+    static json dump() {
+        int64_t now = butil::gettimeofday_us();
+        json result = json::array();
+        for_each([&](InflightRequest& request) {
+            result.push_back(request.inspect(now));
+        });
+        return result;
+    }
+
+private:
+    static void expose() {
+        static bvar::PassiveStatus<std::string> status("stream_dag_inflight", [](void*) -> std::string {
+            return dump().dump();
+        }, nullptr);
+    }
+
+    static InflightRequest*& list() {
+        static InflightRequest* head = nullptr;
+        return head;
+    }
+
+    static bthread::Mutex& mutex() {
+        static bthread::Mutex mutex;
+        return mutex;
+    }
+};
+
+// 执行期间把请求挂到 InflightRegistry 上
+class InflightGuard {
+public:
+    InflightGuard(InflightRequest& request) : request_(request) {
+        InflightRegistry::add(&request_);
+    }
+    ~InflightGuard() {
+        InflightRegistry::remove(&request_);
+    }
+private:
+    InflightRequest& request_;
+};
+
+// 卡死检测
+//   threshold_ms 节点阻塞在一个流上超过这个时间算卡死
+//   interval_ms  检测间隔
+//   cancel       卡死时取消请求
+struct StallOptions {
+    int64_t threshold_ms = 10000;
+    int64_t interval_ms = 1000;
+    bool cancel = false;
+
+    static StallOptions from_json(const json& option) {
+        StallOptions result;
+        result.threshold_ms = option.value("threshold_ms", result.threshold_ms);
+        result.interval_ms = option.value("interval_ms", result.interval_ms);
+        result.cancel = option.value("cancel", result.cancel);
+        return result;
+    }
+};
+
+// 后台 bthread 定期扫描 InflightRegistry，卡死的请求打一次日志，按配置取消
+class StallDetector {
+public:
+    // 重复调用只更新配置
+    static void start(const StallOptions& options) {
+        std::unique_lock<bthread::Mutex> lock_(mutex());
+        state().options = options;
+        if (state().running) {
+            return;
+        }
+        state().running = true;
+        bthread_start_background(&state().tid, nullptr, [](void*) -> void* {
+            while (true) {
+                StallOptions options;
+                {
+                    std::unique_lock<bthread::Mutex> lock_(mutex());
+                    if (!state().running) {
+                        break;
+                    }
+                    options = state().options;
+                }
+                check(options);
+                bthread_usleep(options.interval_ms * 1000);
+            }
+            return nullptr;
+        }, nullptr);
+    }
+
+    static void stop() {
+        bthread_t tid = INVALID_BTHREAD;
+        {
+            std::unique_lock<bthread::Mutex> lock_(mutex());
+            if (!state().running) {
+                return;
+            }
+            state().running = false;
+            tid = state().tid;
+        }
+        bthread_join(tid, nullptr);
+    }
+
+    // 扫描一次，返回卡死的请求数
+    static int check(const StallOptions& options) {
+        int64_t now = butil::gettimeofday_us();
+        int stalled = 0;
+        InflightRegistry::for_each([&](InflightRequest& request) {
+            if (request.max_blocked_us(now) < options.threshold_ms * 1000) {
+                return;
+            }
+            stalled += 1;
+            if (!request.stall_reported.exchange(true)) {
+                LOG(WARNING) << "stream_dag request stalled: " << request.inspect(now).dump();
+                stalled_count() << 1;
+            }
+            if (options.cancel) {
+                request.cancel();
+            }
+        });
+        return stalled;
+    }
+
+private:
+    struct State {
+        StallOptions options;
+        bool running = false;
+        bthread_t tid = INVALID_BTHREAD;
+    };
+
+    static State& state() {
+        static State state;
+        return state;
+    }
+
+    static bthread::Mutex& mutex() {
+        static bthread::Mutex mutex;
+        return mutex;
+    }
+
+    static bvar::Adder<int64_t>& stalled_count() {
+        static bvar::Adder<int64_t> count("stream_dag_stalled_requests");
+        return count;
+    }
+};
+
+}
@@ -0,0 +1,276 @@
+#pragma once
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include "bthread/mutex.h"
+#include <bvar/bvar.h>
+#include <nlohmann/json.hpp>
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 一组节点指标. 按 "图+节点" 和 "节点类型" 各有一份，在 brpc 的 /vars 页面查看
+//   launch_delay  节点可以运行到真正开始执行的延迟
+//   exec          节点执行时间
+//   cpu           估算值: 执行期间节点 bthread 所在线程的 CPU 时间（CLOCK_THREAD_CPUTIME_ID），不含 blocked
+//                 不是 bthread 自己的 CPU 时间. 没包在 BlockedScope 里的让出（sleep、bthread 锁）回到同一 worker 时会算上其它 bthread
+//   blocked       执行时间里阻塞在流上和同步 RPC 上的部分（BlockedScope）
+//   first_output  开始执行到第一个输出元素
+//   output_gap    相邻两个输出元素的间隔
+//   elements      输出的元素个数
+//   bytes         输出的字节数
+struct NodeMetrics {
+    NodeMetrics(const std::string& prefix)
+        : launch_delay(prefix, "launch_delay"),
+          exec(prefix, "exec"),
+          cpu(prefix, "cpu"),
+          blocked(prefix, "blocked"),
+          first_output(prefix, "first_output"),
+          output_gap(prefix, "output_gap"),
+          elements(prefix, "elements"),
+          bytes(prefix, "bytes") {}
+
+    bvar::LatencyRecorder launch_delay;
+    bvar::LatencyRecorder exec;
+    bvar::LatencyRecorder cpu;
+    bvar::LatencyRecorder blocked;
+    bvar::LatencyRecorder first_output;
+    bvar::LatencyRecorder output_gap;
+    bvar::Adder<int64_t> elements;
+    bvar::Adder<int64_t> bytes;
+};
+
+// 一个节点在某张图里的指标，同时写两份
+struct NodeMetricsRef {
+    NodeMetrics* by_node = nullptr;
+    NodeMetrics* by_type = nullptr;
+
+    explicit operator bool() const { return by_node != nullptr; }
+
+    template<class Fn>
+    void record(Fn&& fn) const {
+        if (by_node) {
+            fn(*by_node);
+            fn(*by_type);
+        }
+    }
+};
+
+// 一个输出流的指标. backlog 是所有请求里这个流写入但还没读走的元素数
+struct StreamMetrics {
+    StreamMetrics(const std::string& prefix, NodeMetricsRef node_) : node(node_), backlog(prefix, "backlog") {}
+
+    NodeMetricsRef node;
+    bvar::Adder<int64_t> backlog;
+};
+
+// 图里一个节点运行时用到的指标，outputs 和节点的 list_output() 一一对应
+struct NodeRuntimeMetrics {
+    NodeMetricsRef node;
+    std::vector<StreamMetrics*> outputs;
+};
+
+// 图级别的指标
+//   run        执行器 run 的耗时
+//   ttft       请求进入到 sink 流第一个元素
+//   itl        sink 流相邻元素的间隔
+//   tokens_per_second 每个请求 sink 输出元素数 / 请求耗时
+struct GraphMetrics {
+    GraphMetrics(const std::string& prefix)
+        : run(prefix, "run"),
+          ttft(prefix, "ttft"),
+          itl(prefix, "itl"),
+          tokens_per_second(prefix, "tokens_per_second"),
+          arena_allocations(prefix, "arena_allocations"),
+          heap_allocations(prefix, "heap_allocations") {}
+
+    bvar::LatencyRecorder run;
+    bvar::LatencyRecorder ttft;
+    bvar::LatencyRecorder itl;
+    bvar::IntRecorder tokens_per_second;
+    // 每个请求在 ctx arena 上的分配次数，和其中实际向堆申请的次数
+    bvar::IntRecorder arena_allocations;
+    bvar::IntRecorder heap_allocations;
+};
+
+// 一个请求在 sink 流上的时延. 多个 sink 流时按所有 sink 的输出合并计算
+//   元素就是 token；前面接了合并节点时一个元素是一批 token
+class RequestLatency {
+public:
+    // 请求进入时间. 只记录第一次，调用方可以在收到请求时提前设置
+    void admit(int64_t us) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (admit_us_ == 0) {
+            admit_us_ = us;
+        }
+    }
+
+    void on_output(int64_t us) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (elements_ == 0) {
+            first_us_ = us;
+        } else {
+            gaps_.push_back(us - last_us_);
+        }
+        last_us_ = us;
+        elements_ += 1;
+    }
+
+    // sink 流关闭，取最晚的一个
+    void on_close(int64_t us) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        close_us_ = std::max(close_us_, us);
+    }
+
+    // 请求结束. 没有 sink 关闭过时用结束时间
+    void finish(int64_t us) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (close_us_ == 0) {
+            close_us_ = us;
+        }
+    }
+
+    int64_t elements() const {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return elements_;
+    }
+
+    // 没有输出时返回 -1
+    int64_t ttft_us() const {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return elements_ == 0 ? -1 : first_us_ - admit_us_;
+    }
+
+    int64_t total_us() const {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return close_us_ - admit_us_;
+    }
+
+    // ratio 取 [0, 1]，少于两个元素时返回 -1
+    int64_t itl_percentile(double ratio) const {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (gaps_.empty()) {
+            return -1;
+        }
+        std::vector<int64_t> gaps = gaps_;
+        size_t index = std::min(gaps.size() - 1, (size_t) (ratio * gaps.size()));
+        std::nth_element(gaps.begin(), gaps.begin() + index, gaps.end());
+        return gaps[index];
+    }
+
+    double tokens_per_second() const {
+        int64_t total = total_us();
+        return total <= 0 ? 0 : elements() * 1000000.0 / total;
+    }
+
+    // 相邻元素的间隔. 返回副本，节点还在输出时也可以读
+    std::vector<int64_t> itl() const {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return gaps_;
+    }
+
+    // 复用 ctx 时清空，保留 gaps_ 的容量
+    void reset() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        admit_us_ = 0;
+        first_us_ = 0;
+        last_us_ = 0;
+        close_us_ = 0;
+        elements_ = 0;
+        gaps_.clear();
+    }
+
+    json to_json() const {
+        return json({
+            {"elements", elements()},
+            {"ttft_us", ttft_us()},
+            {"total_us", total_us()},
+            {"itl_p50_us", itl_percentile(0.5)},
+            {"itl_p90_us", itl_percentile(0.9)},
+            {"itl_p99_us", itl_percentile(0.99)},
+            {"tokens_per_second", tokens_per_second()},
+        });
+    }
+
+private:
+    mutable bthread::Mutex mutex_;
+    int64_t admit_us_ = 0;
+    int64_t first_us_ = 0;
+    int64_t last_us_ = 0;
+    int64_t close_us_ = 0;
+    int64_t elements_ = 0;
+    std::vector<int64_t> gaps_;
+};
+
+// 进程级的指标注册表. 同名指标只创建一次，bvar 不允许重复暴露
+//   默认开启. 开启时的开销:
+//     每次 append 在流的锁里多一次 gettimeofday 和 4 次 bvar 写入（节点和类型各 2 次）外加 backlog 一次，每次 read 一次 backlog
+//     每个节点执行多 4 个 LatencyRecorder 写入（launch_delay、exec、cpu、blocked），节点和类型各一份
+//   bvar 写的是线程本地的值，不抢全局锁；元素很小、很多的图上这部分开销占比最大，压测时可以 enable(false) 对比
+class MetricsRegistry {
+public:
+    static void enable(bool enable=true) {
+        enabled().store(enable, std::memory_order_relaxed);
+    }
+
+    static bool is_enabled() {
+        return enabled().load(std::memory_order_relaxed);
+    }
+
+    static NodeMetricsRef node(const std::string& graph, const std::string& node_name, const std::string& type) {
+        NodeMetricsRef ref;
+        ref.by_node = get<NodeMetrics>("stream_dag_" + graph + "_" + node_name);
+        ref.by_type = get<NodeMetrics>("stream_dag_type_" + type);
+        return ref;
+    }
+
+    static GraphMetrics* graph(const std::string& graph) {
+        return get<GraphMetrics>("stream_dag_" + graph);
+    }
+
+    static StreamMetrics* stream(const std::string& graph, const std::string& stream_name, NodeMetricsRef node) {
+        return get<StreamMetrics>("stream_dag_" + graph + "_" + stream_name, node);
+    }
+
+    template<class T, class... Args>
+    static T* get(const std::string& prefix, Args&&... args) {
+        static bthread::Mutex mutex;
+        static std::map<std::string, std::unique_ptr<T>> registry;
+        std::unique_lock<bthread::Mutex> lock_(mutex);
+        auto& ptr = registry[prefix];
+        if (ptr == nullptr) {
+            ptr = std::make_unique<T>(prefix, std::forward<Args>(args)...);
+        }
+        return ptr.get();
+    }
+
+private:
+    static std::atomic<bool>& enabled() {
+        static std::atomic<bool> enabled{true};
+        return enabled;
+    }
+};
+
+// 元素的字节数，有 size() 的取 size()，否则按对象大小算
+template<typename T, typename = void>
+struct has_size : std::false_type {};
+
+template<typename T>
+struct has_size<T, decltype((void) std::declval<const T&>().size(), void())> : std::true_type {};
+
+template<class T>
+size_t byte_size(const T& value) {
+    if constexpr (has_size<T>::value) {
+        return value.size();
+    } else {
+        return sizeof(T);
+    }
+}
+
+}
@@ -1,12 +1,17 @@
 #pragma once
 #include <any>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
 #include "context.h"
 #include "stream.h"
+#include "thread_pool.h"
 #include <nlohmann/json.hpp>
 
 namespace stream_dag {
@@ -16,27 +21,57 @@ class BaseDataWrapper {
 public:
     BaseDataWrapper(const std::string& node_name, const std::string& data_name) : fullname_(node_name + "/" + data_name) {}
     ~BaseDataWrapper() = default;
-    virtual std::string fullname() { return fullname_; };
+    const std::string& fullname() const { return fullname_; };
+    // 流的类型，图校验时比较边两端是否一致
+    virtual const std::type_info& data_typeid() const = 0;
 
     virtual std::any create(BaseContext&, const std::string& data_name) = 0 ;
     virtual void half_close(std::any &data) = 0 ;
+    // data 是 PipeStream 类的流时返回它的基类指针，否则返回 nullptr
+    virtual PipeStreamBase* stream_base(std::any &data) { return nullptr; }
+    // 复用 ctx 时把数据重置为刚创建的状态，不支持重置时返回 false
+    virtual bool reset(std::any &data) { return false; }
 private:
     std::string fullname_;
 };
 
+// 边两端要一致的类型. InputData<T> 读的是上游的 OutputData<T>
+template<class T>
+struct edge_data { using type = T; };
+template<class T>
+struct edge_data<InputData<T>> { using type = OutputData<T>; };
+
 template<class T>
 class DataWrppper : public BaseDataWrapper {
 public:
     using data_type = T;
     using BaseDataWrapper::BaseDataWrapper;
 
+    const std::type_info& data_typeid() const { return typeid(typename edge_data<T>::type); }
+
     std::any create(BaseContext& ctx, const std::string& data_name) {
-        return std::make_shared<T>(ctx, data_name, typeid(T).name());
+        return arena_make_shared<T>(&ctx.arena(), ctx, data_name, typeid(T).name());
     }
 
     void half_close(std::any &data) {
-        auto stream = std::any_cast<std::shared_ptr<T>>(data);
-        stream->auto_close();
+        std::any_cast<std::shared_ptr<T>&>(data)->auto_close();
+    }
+
+    PipeStreamBase* stream_base(std::any &data) {
+        if constexpr (std::is_base_of<PipeStreamBase, T>::value) {
+            return std::any_cast<std::shared_ptr<T>&>(data).get();
+        } else {
+            return nullptr;
+        }
+    }
+
+    bool reset(std::any &data) {
+        if constexpr (std::is_base_of<PipeStreamBase, T>::value) {
+            std::any_cast<std::shared_ptr<T>&>(data)->reset();
+            return true;
+        } else {
+            return false;
+        }
     }
 };
 
@@ -56,7 +91,9 @@ class BaseNodeWrapper {
 public:
     BaseNodeWrapper(const std::string& full_name) : fullname_(full_name) {}
     ~BaseNodeWrapper() = default;
-    virtual std::string fullname() { return fullname_; };
+    const std::string& fullname() const { return fullname_; };
+    // 去掉调用方节点名之后的名字，也是调用方 option 里子节点配置的 key
+    std::string name() const { return fullname_.substr(fullname_.rfind('/') + 1); }
 
     virtual BaseNode* create(BaseContext&, const std::string& full_name) = 0 ;
 
@@ -92,20 +129,39 @@ public:
             ctx.init_data(output->fullname(), output->create(ctx, output->fullname()));
         }
 
-        json j = json::object();
-        Status status = init(j); // TODO !!!
+        // 节点只初始化一次，不在每个请求里重复 init
+        Status status = ensure_init();
+        if (!status.ok()) {
+            return status;
+        }
         // for (auto& input : inputs_) {
         //     ctx.init_data(input->fullname(), input->create(ctx, input->fullname()));
         // }
-        for (auto& callee : callees_) {
-            BaseNode* sub_node = callee->create(ctx, callee->fullname());
-            ctx.init_node(callee->fullname(), sub_node);
-            sub_node->init_ctx(ctx);
-            // sub_node 是动态调用
-            // 不清楚调用次数
-            // 无法初始化 input output 这些
-            // 只能初始化 callees_里面的内容
-            // 在 call 的时候先初始化然后使用 使用后删除 是用 shared_ptr 计数 不用 ctx 存储
+        return init_callees(ctx);
+    }
+
+    // 在 ctx 里登记子节点，Node<T>::Call 通过 ctx 找到它们
+    //   子节点实例第一次用到时创建并 init，之后所有请求共用，和图里的节点一样
+    //   子节点的参数流在调用时的 CallFrame 里，这里不创建输出流
+    Status init_callees(BaseContext& ctx) {
+        std::call_once(callee_once_, [this, &ctx] {
+            for (auto& callee : callees_) {
+                std::shared_ptr<BaseNode> sub_node(callee->create(ctx, callee->fullname()));
+                // 子节点的配置来自调用方配置里同名的字段
+                sub_node->configure(option_.value(callee->name(), json::object()));
+                callee_nodes_.push_back(std::move(sub_node));
+            }
+        });
+        for (auto& sub_node : callee_nodes_) {
+            ctx.init_node(sub_node->name(), sub_node.get());
+            Status status = sub_node->ensure_init();
+            if (!status.ok()) {
+                return status;
+            }
+            status = sub_node->init_callees(ctx);
+            if (!status.ok()) {
+                return status;
+            }
         }
         return Status::OK();
     }
@@ -126,6 +182,34 @@ public:
         return Status::OK();
     }
 
+    // 设置节点配置并初始化。图加载时调用一次，之后所有请求共享初始化结果
+    Status configure(const json& option) {
+        std::unique_lock<bthread::Mutex> lock_(init_mutex_);
+        option_ = option;
+        init_status_ = init(option_);
+        initialized_ = true;
+        return init_status_;
+    }
+
+    // 没有显式 configure 过的节点，在第一次执行时用当前配置初始化
+    Status ensure_init() {
+        if (initialized_.load(std::memory_order_acquire)) {
+            return init_status_;
+        }
+        std::unique_lock<bthread::Mutex> lock_(init_mutex_);
+        if (!initialized_.load(std::memory_order_relaxed)) {
+            init_status_ = init(option_);
+            initialized_.store(true, std::memory_order_release);
+        }
+        return init_status_;
+    }
+
+    const json& option() const { return option_; }
+
+    // 执行方式，图加载时设置. cpu_bound 和 blocking 的节点在线程池里执行
+    void set_exec(NodeExec exec) { exec_ = exec; }
+    NodeExec exec() const { return exec_; }
+
     virtual Status execute(BaseContext& ctx) = 0;
 
     template<class ...T> Status run(T ...inouts);
@@ -151,11 +235,11 @@ public:
         return wrapper;
     }
 
-    std::string name() const { return name_; };
-    std::string type() { return type_; };
-    std::vector<std::shared_ptr<BaseDataWrapper>> list_input () const { return inputs_; }
-    std::vector<std::shared_ptr<BaseDataWrapper>> list_output() const { return outputs_; }
-    std::vector<std::shared_ptr<BaseNodeWrapper>> list_depend() const { return callees_; }
+    const std::string& name() const { return name_; };
+    const std::string& type() const { return type_; };
+    const std::vector<std::shared_ptr<BaseDataWrapper>>& list_input () const { return inputs_; }
+    const std::vector<std::shared_ptr<BaseDataWrapper>>& list_output() const { return outputs_; }
+    const std::vector<std::shared_ptr<BaseNodeWrapper>>& list_depend() const { return callees_; }
 
     json to_json() {
         json info;
@@ -170,6 +254,12 @@ public:
         for (auto data : callees_) {
             info["callees"].push_back(data->fullname());
         }
+        if (!option_.empty()) {
+            info["option"] = option_;
+        }
+        if (exec_ != kExecBthread) {
+            info["exec"] = node_exec_name(exec_);
+        }
         return info;
     }
 
@@ -178,109 +268,248 @@ public:
 private:
     std::string name_, type_;
 
+    // 节点配置
+    json option_ = json::object();
+    Status init_status_;
+    std::atomic<bool> initialized_{false};
+    bthread::Mutex init_mutex_;
+    NodeExec exec_ = kExecBthread;
+
     // 边依赖
     std::vector<std::shared_ptr<BaseDataWrapper>> inputs_;
     std::vector<std::shared_ptr<BaseDataWrapper>> outputs_;
 
     // 子模块
     std::vector<std::shared_ptr<BaseNodeWrapper>> callees_;
+    // 子节点实例，和 callees_ 一一对应
+    std::vector<std::shared_ptr<BaseNode>> callee_nodes_;
+    std::once_flag callee_once_;
+};
+
+
+// 节点执行的栈帧. 不内联，CPU 和 contention profiler 的调用栈里会出现 run_node<节点类型>，可以按节点类型归类
+//   只区分类型，同一类型的多个节点在 profile 里分不开，要按节点看用 stream_dag_<图名>_<节点名>_* 指标
+template<class RealNode, class Fn>
+__attribute__((noinline)) Status run_node(Fn&& fn) {
+    Status status = fn();
+    asm volatile("" ::: "memory"); // 防止尾调用优化掉这一帧
+    return status;
+}
+
+namespace call_detail {
+
+template<class W>
+struct SlotInit {
+    BaseContext& ctx;
+    W& wrapper;
 };
 
+// 一个端口. 输入输出端口是流，子节点端口是 Node<T>
+template<class W> struct Slot;
+
+template<class T>
+struct Slot<NodeInputWrppper<T>> {
+    Slot(const SlotInit<NodeInputWrppper<T>>& init) : value(init.ctx, init.wrapper.fullname(), typeid(T).name()) {}
+    T value;
+};
+
+template<class T>
+struct Slot<NodeOutputWrppper<T>> {
+    Slot(const SlotInit<NodeOutputWrppper<T>>& init) : value(init.ctx, init.wrapper.fullname(), typeid(T).name()) {}
+    T value;
+};
 
+template<class T>
+struct Slot<NodeCalleeWrapper<T>> {
+    Slot(const SlotInit<NodeCalleeWrapper<T>>& init) : value(init.ctx.get(init.wrapper)) {}
+    Node<T> value;
+};
+
+}
+
+// 动态调用一个节点时的参数流
+//   端口和类型在编译期由 DECLARE_PARAMS 确定，流直接放在帧里，不查表、不做 any_cast
+//   同步调用时帧在调用方的栈上，异步调用时在 ctx 的 arena 上
 template<class RealNode>
-class Node {
+class CallFrame {
+    using Wrappers = decltype(std::declval<RealNode&>().wrappers);
+    static constexpr size_t kPorts = std::tuple_size_v<Wrappers>;
+    template<size_t P> using wrapper_t = std::remove_reference_t<std::tuple_element_t<P, Wrappers>>;
+
+    template<class Seq> struct slots;
+    template<size_t... P> struct slots<std::index_sequence<P...>> {
+        using type = std::tuple<call_detail::Slot<wrapper_t<P>>...>;
+    };
+
 public:
-    Node(RealNode& node, BaseContext& ctx): node_(node), ctx_(ctx) {}
+    CallFrame(RealNode& node, BaseContext& ctx) : CallFrame(node, ctx, std::make_index_sequence<kPorts>{}) {}
 
-    decltype(auto) Params() {
-        return std::apply([this](auto&... args) {
-            return std::tie(get(args)...);
-        }, node_.wrappers);
-    }
+    CallFrame(const CallFrame&) = delete;
+    CallFrame& operator=(const CallFrame&) = delete;
 
-    Status Call() {
-        return node_.execute(ctx_);
+    // 参数按端口顺序对应，T 对应 Stream<T> 输入时写入一个元素. 写完后关闭所有输入
+    template<class... Args>
+    void write(Args& ...args) {
+        static_assert(sizeof...(Args) <= kPorts); // 参数数量可能少一点 后面的参数可能不需要
+        write(std::index_sequence_for<Args...>{}, args...);
+        close_inputs(std::make_index_sequence<kPorts>{});
     }
 
-    // 为了从 下面 4 行简化为 1 行 使用一点模板自动转换类型
-    // auto&& [http_request, http_response, http_body] = http_node.Params(); // 1
-    // http_request.append(http_req); // 2
-    // Status status = http_node.Call(); // 3
-    // http_response.read(http_rsp); // 4
-    // 结果
-    // Status status = http_node.Call(http_req, http_rsp);
+    // 在当前 bthread 里执行，结束后关闭所有输出
+    Status run() {
+        Status status = run_node<RealNode>([this] {
+            return call(std::make_index_sequence<kPorts>{});
+        });
+        close_outputs(std::make_index_sequence<kPorts>{});
+        return status;
+    }
 
-    class BeforeTag {};
-    class AfterTag {};
-    BeforeTag before;
-    AfterTag after;
-    
+    // T 对应 Stream<T> 输出时读出一个元素
     template<class... Args>
-    Status Call(Args& ...args) {
-        // ctx.init_input(out, in);
-        auto tp = std::make_tuple(std::ref(args)...);
-        update(tp, node_.wrappers, before); // 运行前先把数据写进去
+    void read(Args& ...args) {
+        read(std::index_sequence_for<Args...>{}, args...);
+    }
 
-        Status status = std::apply([this](auto&... args) {
-            return node_.run(get(args)...);
-        }, node_.wrappers);
+    // 第 P 个端口上的流，一次写入或者读出多个元素时直接用
+    template<size_t P>
+    auto& get() { return std::get<P>(slots_).value; }
 
-        update(tp, node_.wrappers, after); // 运行后需要读出来
-        return status;
+private:
+    template<size_t... P>
+    CallFrame(RealNode& node, BaseContext& ctx, std::index_sequence<P...>)
+        : node_(node), slots_(call_detail::SlotInit<wrapper_t<P>>{ctx, std::get<P>(node.wrappers)}...) {}
+
+    template<size_t... P>
+    Status call(std::index_sequence<P...>) {
+        return node_.run(std::get<P>(slots_).value...);
     }
 
-    template<typename... T1, typename... T2, typename Tag>
-    Status update(std::tuple<T1...>& params, std::tuple<T2...>& wrappers, Tag tag) {
-        static_assert(sizeof...(T1) <= sizeof...(T2)); // 参数数量可能少一点 后面的参数可能不需要
-        return update(params, wrappers, std::make_index_sequence<sizeof...(T1)>{}, tag);
+    template<size_t... I, class... Args>
+    void write(std::index_sequence<I...>, Args& ...args) {
+        (write_one(std::get<I>(slots_), args), ...);
     }
 
-    template<typename... T1, typename... T2, std::size_t... I, typename Tag>
-    Status update(std::tuple<T1...>& t1, std::tuple<T2...>& t2, std::index_sequence<I...>, Tag tag) {
-        auto s = std::tuple{ update_one(std::get<I>(t1), std::get<I>(t2), tag)... };
-        return Status::OK();
+    template<size_t... I, class... Args>
+    void read(std::index_sequence<I...>, Args& ...args) {
+        (read_one(std::get<I>(slots_), args), ...);
     }
 
     template<class T>
-    Status update_one(T& param, NodeInputWrppper<Stream<T>>& wrapper, BeforeTag tag) {
-        // Input 类型的需要提前设置好
-        auto& input = get(wrapper);
-        return input.append(param);
+    static void write_one(call_detail::Slot<NodeInputWrppper<Stream<T>>>& slot, T& param) {
+        slot.value.append(param);
     }
 
     template<class T>
-    Status update_one(T& param, NodeOutputWrppper<Stream<T>>& wrapper, AfterTag tag) {
-        // Output 类型的需要 结束后拿出来
-        auto&  output = get(wrapper);
-        return output.read(param);
+    static void read_one(call_detail::Slot<NodeOutputWrppper<Stream<T>>>& slot, T& param) {
+        slot.value.read(param);
     }
 
-    template<class T1, class T2, typename Tag>
-    Status update_one(T1& param, T2& wrapper, Tag tag) {
-        //  其它类型先忽略
-        return Status::OK();
+    // 其它类型先忽略
+    template<class S, class T>
+    static void write_one(S& slot, T& param) {}
+
+    template<class S, class T>
+    static void read_one(S& slot, T& param) {}
+
+    template<size_t... P>
+    void close_inputs(std::index_sequence<P...>) {
+        (close_port<P, NodeInputWrppper>(), ...);
     }
 
-    template<class T>
-    T& get(NodeInputWrppper<T>& wrapper) {
-        auto it = data_map_.find(wrapper.fullname());
-        if (it != data_map_.end()) {
-            return *std::any_cast<std::shared_ptr<T>>(it->second);
+    template<size_t... P>
+    void close_outputs(std::index_sequence<P...>) {
+        (close_port<P, NodeOutputWrppper>(), ...);
+    }
+
+    template<size_t P, template<class> class Kind>
+    void close_port() {
+        if constexpr (is_port<wrapper_t<P>, Kind>::value) {
+            using data_type = std::remove_reference_t<decltype(std::get<P>(slots_).value)>;
+            if constexpr (std::is_base_of<PipeStreamBase, data_type>::value) {
+                std::get<P>(slots_).value.half_close();
+            }
         }
-        auto ptr = std::make_shared<T>(ctx_, wrapper.fullname(), typeid(T).name());
-        data_map_[wrapper.fullname()] = ptr;
-        return *ptr;
     }
 
-    template<class T>
-    T& get(NodeOutputWrppper<T>& wrapper) {
-        auto it = data_map_.find(wrapper.fullname());
-        if (it != data_map_.end()) {
-            return *std::any_cast<std::shared_ptr<T>>(it->second);
+    template<class W, template<class> class Kind> struct is_port : std::false_type {};
+    template<class T, template<class> class Kind> struct is_port<Kind<T>, Kind> : std::true_type {};
+
+    RealNode& node_;
+    typename slots<std::make_index_sequence<kPorts>>::type slots_;
+};
+
+// CallAsync 的返回值. 子节点在另一个 bthread 里执行，join 后输出写回参数
+//   参数要活到 join 之后; 没有 join 的句柄析构时等待执行结束，输出丢弃
+template<class RealNode, class... Args>
+class CallHandle {
+public:
+    CallHandle(RealNode& node, BaseContext& ctx, Args& ...args)
+        : state_(arena_make_shared<State>(&ctx.arena(), node, ctx, args...)) {
+        state_->frame.write(args...);
+        bthrd_ = BThread::start([](void* arg) -> void* {
+            State* state = static_cast<State*>(arg);
+            state->status = state->frame.run();
+            return nullptr;
+        }, state_.get());
+    }
+
+    CallHandle(CallHandle&& other) : state_(std::move(other.state_)), bthrd_(std::exchange(other.bthrd_, BThread())) {}
+    CallHandle& operator=(CallHandle&&) = delete;
+
+    ~CallHandle() {
+        if (state_) {
+            bthrd_.join();
         }
-        auto ptr = std::make_shared<T>(ctx_, wrapper.fullname(), typeid(T).name());
-        data_map_[wrapper.fullname()] = ptr;
-        return *ptr;
+    }
+
+    // 等待执行结束，返回子节点的状态. 只能 join 一次
+    Status join() {
+        if (!state_) {
+            return Status(-1, "call already joined");
+        }
+        bthrd_.join();
+        std::apply([this](auto& ...args) { state_->frame.read(args...); }, state_->args);
+        Status status = state_->status;
+        state_.reset();
+        return status;
+    }
+
+private:
+    struct State {
+        State(RealNode& node, BaseContext& ctx, Args& ...args_) : frame(node, ctx), args(args_...) {}
+        CallFrame<RealNode> frame;
+        std::tuple<Args&...> args;
+        Status status;
+    };
+
+    std::shared_ptr<State> state_;
+    BThread bthrd_;
+};
+
+template<class RealNode>
+class Node {
+public:
+    Node(RealNode& node, BaseContext& ctx): node_(node), ctx_(ctx) {}
+
+    // 参数流在栈上的帧里，在调用方的 bthread 里执行
+    //   Status status = http_node.Call(http_req, http_rsp);
+    // 参数按端口顺序对应，一个参数对应流里的一个元素，后面的参数可以省略. 一个端口上有多个元素时直接用 CallFrame
+    template<class... Args>
+    Status Call(Args& ...args) {
+        CallFrame<RealNode> frame(node_, ctx_);
+        frame.write(args...); // 运行前先把数据写进去
+        Status status = frame.run();
+        frame.read(args...); // 运行后需要读出来
+        return status;
+    }
+
+    // 在另一个 bthread 里执行，可以同时发出多个调用再逐个 join
+    //   auto a = search.CallAsync(req_a, rsp_a);
+    //   auto b = search.CallAsync(req_b, rsp_b);
+    //   Status sa = a.join(), sb = b.join();
+    template<class... Args>
+    CallHandle<RealNode, Args...> CallAsync(Args& ...args) {
+        return CallHandle<RealNode, Args...>(node_, ctx_, args...);
     }
 
     template<class T>
@@ -291,15 +520,19 @@ public:
 public:
     RealNode& node_;
     BaseContext& ctx_;
-
-    std::unordered_map<std::string, std::any> data_map_;
 };
 
 #define INPUT(name, type)  name, NodeInputWrppper<type>&, *BaseNode::input<type>(#name)
 #define OUTPUT(name, type) name, NodeOutputWrppper<type>&, *BaseNode::output<type>(#name)
 #define DEPEND(name, type) name, NodeCalleeWrapper<type>&, *BaseNode::depend<type>(#name)
 #define GEN_RESULT(...) std::tuple<_MACRO_GET2_EVERY3_(__VA_ARGS__)> wrappers = std::tie(_MACRO_GET1_EVERY3_(__VA_ARGS__));
-#define DECLARE_PARAMS(...) _MACRO_GEN_PARAMS_(__VA_ARGS__)  GEN_RESULT(__VA_ARGS__) using BaseNode::BaseNode; \
-    Status execute(BaseContext& ctx) { return std::apply([this, &ctx](auto& ...args) { return run(ctx.get(args)...); }, wrappers);  }
+// 端口在 wrappers 里的下标，静态图用它指定边的两端，例如 HttpNode::ports::request_
+#define GEN_PORTS(...) struct ports { enum : size_t { _MACRO_GET1_EVERY3_(__VA_ARGS__) }; };
+#define DECLARE_PARAMS(...) _MACRO_GEN_PARAMS_(__VA_ARGS__)  GEN_RESULT(__VA_ARGS__) GEN_PORTS(__VA_ARGS__) using BaseNode::BaseNode; \
+    Status execute(BaseContext& ctx) { \
+        return run_node<std::remove_pointer_t<decltype(this)>>([this, &ctx] { \
+            return std::apply([this, &ctx](auto& ...args) { return run(ctx.get(args)...); }, wrappers); \
+        }); \
+    }
 
 }
\ No newline at end of file
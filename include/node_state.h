@@ -0,0 +1,132 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <pthread.h>
+#include <time.h>
+#include "bthread/bthread.h"
+#include "butil/time.h"
+
+namespace stream_dag {
+
+class BaseNode;
+
+// 节点在一次请求里的执行状态，inspector 和卡死检测读取
+//   执行期间绑定在 bthread 上，节点内的代码可以用 current() 知道自己属于哪个节点
+class NodeRunState {
+public:
+    enum State {
+        kPending = 0,
+        kRunning = 1,
+        kBlocked = 2,
+        kDone = 3,
+    };
+
+    static const char* state_name(int state) {
+        switch (state) {
+            case kPending: return "pending";
+            case kRunning: return "running";
+            case kBlocked: return "blocked";
+            case kDone: return "done";
+        }
+        return "unknown";
+    }
+
+    // 当前 bthread 正在执行的节点，不在节点里时返回 nullptr
+    static NodeRunState* current() {
+        return (NodeRunState*) bthread_getspecific(key());
+    }
+
+    static void set_current(NodeRunState* state) {
+        bthread_setspecific(key(), state);
+    }
+
+    BaseNode* node = nullptr;
+    std::atomic<int> state{kPending};
+    std::atomic<int64_t> start_us{0};
+    // 阻塞在哪个流上. 指向流的名字，流的生命周期和请求一样长
+    std::atomic<const std::string*> blocked_on{nullptr};
+    std::atomic<int64_t> blocked_since_us{0};
+    // 阻塞在外部 IO（同步 RPC）上，等的不是图里的其它节点
+    std::atomic<bool> blocked_external{false};
+    // 累计阻塞时间，只由执行节点的 bthread 读写
+    int64_t blocked_total_us = 0;
+    // 累计 CPU 时间的估算值，只由执行节点的 bthread 读写. 统计的是线程 CPU 时间，见 pause_cpu
+    int64_t cpu_total_us = 0;
+
+    // 开始或者恢复统计 CPU 时间. 节点开始执行和每次阻塞结束时调用
+    void resume_cpu() {
+        cpu_thread_ = pthread_self();
+        cpu_since_us_ = thread_cpu_us();
+    }
+
+    // 暂停统计，把这一段的线程 CPU 时间加到 cpu_total_us 上. 阻塞开始和节点执行结束时调用
+    //   bthread 在这一段里让出过 worker 时（sleep、bthread 锁等待）:
+    //   换到别的 worker 上的一段线程 CPU 时间没有意义，丢掉；回到同一个 worker 时会多算上其它 bthread 的 CPU 时间
+    void pause_cpu() {
+        if (cpu_since_us_ < 0) {
+            return;
+        }
+        if (pthread_equal(cpu_thread_, pthread_self())) {
+            cpu_total_us += std::max<int64_t>(thread_cpu_us() - cpu_since_us_, 0);
+        }
+        cpu_since_us_ = -1;
+    }
+
+    static int64_t thread_cpu_us() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+    }
+
+private:
+    pthread_t cpu_thread_;
+    int64_t cpu_since_us_ = -1;
+
+    static bthread_key_t key() {
+        static bthread_key_t key = []() {
+            bthread_key_t k;
+            bthread_key_create(&k, nullptr);
+            return k;
+        }();
+        return key;
+    }
+};
+
+// 阻塞区间，析构时恢复成 running，阻塞期间不统计 CPU 时间. 不在节点的 bthread 里或者 active 为 false 时什么都不做
+//   external 为 true 表示等的是外部 IO，卡死检测不把它当成死锁
+class BlockedScope {
+public:
+    BlockedScope(const std::string& what, bool active=true, bool external=false) {
+        if (active) {
+            state_ = NodeRunState::current();
+        }
+        if (state_) {
+            state_->pause_cpu();
+            state_->blocked_on.store(&what, std::memory_order_relaxed);
+            state_->blocked_external.store(external, std::memory_order_relaxed);
+            state_->blocked_since_us.store(butil::gettimeofday_us(), std::memory_order_relaxed);
+            state_->state.store(NodeRunState::kBlocked, std::memory_order_release);
+        }
+    }
+
+    ~BlockedScope() {
+        if (state_) {
+            int64_t since = state_->blocked_since_us.load(std::memory_order_relaxed);
+            state_->blocked_total_us += butil::gettimeofday_us() - since;
+            state_->state.store(NodeRunState::kRunning, std::memory_order_release);
+            state_->blocked_on.store(nullptr, std::memory_order_relaxed);
+            state_->blocked_external.store(false, std::memory_order_relaxed);
+            state_->blocked_since_us.store(0, std::memory_order_relaxed);
+            state_->resume_cpu();
+        }
+    }
+
+    BlockedScope(const BlockedScope&) = delete;
+    BlockedScope& operator=(const BlockedScope&) = delete;
+
+private:
+    NodeRunState* state_ = nullptr;
+};
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <tuple>
+#include "butil/status.h"
+#include "butil/time.h"
+#include "bthread/bthread.h"
+#include "bthread/condition_variable.h"
+#include "context.h"
+
+namespace stream_dag {
+
+// 请求级的准入调度
+//   bthread 按 FIFO 调度，过载时在线请求排在离线任务后面. 调度器限制同时执行的请求数，
+//   排队的请求按优先级、截止时间（早的先）、到达顺序放行. 默认不限制，不排队
+//   离线任务在在线请求一直排队时会饿死，需要的话给离线任务单独的进程或者更大的上限
+//
+//   RequestScheduler::instance().set_max_running(64);
+//   ctx.set_priority(kPriorityInteractive);
+//   ctx.set_deadline_us(butil::gettimeofday_us() + 3000000);
+//   executor.run(g, ctx);
+//
+// 编译时定义 STREAM_DAG_WITH_BTHREAD_TAG 可以把各优先级的节点放到不同的 bthread tag 上，
+// 离线任务占满 worker 时不影响在线请求. 需要 brpc 支持 tag，并用 -task_group_ntags 启动足够的 tag
+class RequestScheduler {
+public:
+    static RequestScheduler& instance() {
+        static RequestScheduler scheduler;
+        return scheduler;
+    }
+
+    // 同时执行的请求数上限，0 表示不限制
+    //   不限制时执行器不调用 admit/release，这期间开始的请求不计入 running
+    void set_max_running(int max_running) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        max_running_.store(std::max(max_running, 0), std::memory_order_release);
+        grant_locked();
+    }
+
+    // 是否限制了同时执行的请求数. 不加锁，不限制时请求路径上没有全局锁
+    bool enabled() const {
+        return max_running_.load(std::memory_order_acquire) > 0;
+    }
+
+    // 等到放行. 排队期间过了截止时间返回错误，不占执行名额
+    Status admit(BaseContext& ctx) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        int max_running = max_running_.load(std::memory_order_relaxed);
+        if (max_running == 0 || (running_ < max_running && queue_.empty())) {
+            running_++;
+            return Status::OK();
+        }
+        Waiter waiter{ctx.priority(), ctx.deadline_us() > 0 ? ctx.deadline_us() : INT64_MAX, seq_++};
+        auto it = queue_.insert(&waiter).first;
+        queued_[waiter.priority]++;
+        grant_locked();
+        while (!waiter.granted) {
+            int64_t now = butil::gettimeofday_us();
+            if (ctx.deadline_us() > 0 && now >= ctx.deadline_us()) {
+                queue_.erase(it);
+                queued_[waiter.priority]--;
+                return Status(-1, "deadline exceeded after %ldus in queue", now - waiter.enqueue_us);
+            }
+            int64_t wait_us = ctx.deadline_us() > 0 ? ctx.deadline_us() - now : 1000000;
+            waiter.cond.wait_for(lock_, std::min<int64_t>(wait_us, 1000000));
+        }
+        return Status::OK();
+    }
+
+    // 和成功的 admit 一一对应
+    void release() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        running_--;
+        grant_locked();
+    }
+
+#ifdef STREAM_DAG_WITH_BTHREAD_TAG
+    // 优先级为 priority 的请求，节点在 tag 上的 worker 里执行
+    void set_tag(RequestPriority priority, bthread_tag_t tag) {
+        attrs_[priority] = BTHREAD_ATTR_NORMAL;
+        attrs_[priority].tag = tag;
+        has_attr_[priority] = true;
+    }
+
+    const bthread_attr_t* bthread_attr(RequestPriority priority) const {
+        return has_attr_[priority] ? &attrs_[priority] : nullptr;
+    }
+#endif
+
+    json inspect() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return json({
+            {"max_running", max_running_.load(std::memory_order_relaxed)},
+            {"running", running_},
+            {"queued", {
+                {"interactive", queued_[kPriorityInteractive]},
+                {"normal", queued_[kPriorityNormal]},
+                {"batch", queued_[kPriorityBatch]},
+            }},
+        });
+    }
+
+private:
+    struct Waiter {
+        RequestPriority priority;
+        int64_t deadline_us;
+        uint64_t seq;
+        int64_t enqueue_us = butil::gettimeofday_us();
+        bool granted = false;
+        bthread::ConditionVariable cond;
+    };
+
+    struct WaiterLess {
+        bool operator()(const Waiter* a, const Waiter* b) const {
+            return std::tie(a->priority, a->deadline_us, a->seq) < std::tie(b->priority, b->deadline_us, b->seq);
+        }
+    };
+
+    // 有空闲名额时按顺序放行排在最前面的
+    void grant_locked() {
+        int max_running = max_running_.load(std::memory_order_relaxed);
+        while (!queue_.empty() && (max_running == 0 || running_ < max_running)) {
+            Waiter* waiter = *queue_.begin();
+            queue_.erase(queue_.begin());
+            queued_[waiter->priority]--;
+            running_++;
+            waiter->granted = true;
+            waiter->cond.notify_one();
+        }
+    }
+
+    bthread::Mutex mutex_;
+    // 只在持锁时修改，enabled 不加锁读取
+    std::atomic<int> max_running_{0};
+    int running_ = 0;
+    uint64_t seq_ = 0;
+    std::set<Waiter*, WaiterLess> queue_;
+    int queued_[kPriorityCount] = {0};
+#ifdef STREAM_DAG_WITH_BTHREAD_TAG
+    bthread_attr_t attrs_[kPriorityCount];
+    bool has_attr_[kPriorityCount] = {false};
+#endif
+};
+
+// 执行期间占着一个名额，析构时归还
+class SchedulerSlot {
+public:
+    SchedulerSlot(RequestScheduler& scheduler) : scheduler_(scheduler) {}
+    ~SchedulerSlot() { scheduler_.release(); }
+private:
+    RequestScheduler& scheduler_;
+};
+
+}
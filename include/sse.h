@@ -0,0 +1,277 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "stream-dag.h"
+#include "byte_stream.h"
+#include "coalesce.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// text/event-stream 的一个事件
+struct SseEvent {
+    std::string event;
+    std::string data;
+    std::string id;
+
+    json to_json() const {
+        return json({{"event", event}, {"data", data}, {"id", id}});
+    }
+};
+
+// 模型流式输出的一个 token
+struct LLMToken {
+    std::string text;
+    int64_t index = 0;
+    bool finished = false;
+
+    json to_json() const {
+        return json({{"text", text}, {"index", index}, {"finished", finished}});
+    }
+};
+
+template<>
+struct coalesce_traits<LLMToken> {
+    static size_t size(const LLMToken& value) { return value.text.size(); }
+    static void merge(LLMToken& to, LLMToken&& from) {
+        to.text += from.text;
+        to.index = from.index;
+        to.finished = to.finished || from.finished;
+    }
+};
+
+// 找到第一个 '\n' 或 '\r'，找不到返回 end. 一次比较 16/32 字节
+inline const char* find_eol(const char* p, const char* end) {
+#if defined(__AVX2__)
+    const __m256i lf32 = _mm256_set1_epi8('\n');
+    const __m256i cr32 = _mm256_set1_epi8('\r');
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, lf32), _mm256_cmpeq_epi8(v, cr32)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; p < end; ++p) {
+        if (*p == '\n' || *p == '\r') {
+            return p;
+        }
+    }
+    return end;
+}
+
+// 增量 SSE 解析器
+//   chunk 边界和事件边界无关。完整的行直接在 IOBuf block 上处理，
+//   只有跨 chunk 的半行才拷贝到 line_ 里，不会缓存整个 body
+//   支持 \n、\r\n、\r 三种换行
+class SseParser {
+public:
+    template<class Callback>
+    void feed(const butil::IOBuf& chunk, Callback&& on_event) {
+        size_t block_num = chunk.backing_block_num();
+        for (size_t i = 0; i < block_num; i++) {
+            butil::StringPiece block = chunk.backing_block(i);
+            feed(block.data(), block.size(), on_event);
+        }
+    }
+
+    template<class Callback>
+    void feed(const char* p, size_t length, Callback&& on_event) {
+        const char* end = p + length;
+        if (p < end && skip_lf_) {
+            // 上一个 chunk 以 '\r' 结尾，'\r\n' 被拆开了
+            if (*p == '\n') {
+                ++p;
+            }
+            skip_lf_ = false;
+        }
+        while (p < end) {
+            const char* eol = find_eol(p, end);
+            if (eol == end) {
+                line_.append(p, end - p);
+                return;
+            }
+            if (line_.empty()) {
+                process_line(std::string_view(p, eol - p), on_event);
+            } else {
+                line_.append(p, eol - p);
+                process_line(std::string_view(line_), on_event);
+                line_.clear();
+            }
+            p = eol + 1;
+            if (*eol == '\r') {
+                if (p == end) {
+                    skip_lf_ = true;
+                } else if (*p == '\n') {
+                    ++p;
+                }
+            }
+        }
+    }
+
+    // 流结束。很多服务最后一个事件后面不带空行，这里把它也派发出去
+    template<class Callback>
+    void finish(Callback&& on_event) {
+        if (!line_.empty()) {
+            process_line(std::string_view(line_), on_event);
+            line_.clear();
+        }
+        dispatch(on_event);
+    }
+
+private:
+    template<class Callback>
+    void process_line(std::string_view line, Callback& on_event) {
+        if (line.empty()) {
+            dispatch(on_event);
+            return;
+        }
+        if (line[0] == ':') {
+            return; // 注释
+        }
+        std::string_view field = line, value;
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos) {
+            field = line.substr(0, colon);
+            value = line.substr(colon + 1);
+            if (!value.empty() && value[0] == ' ') {
+                value.remove_prefix(1);
+            }
+        }
+        if (field == "data") {
+            if (has_data_) {
+                event_.data.push_back('\n');
+            }
+            event_.data.append(value.data(), value.size());
+            has_data_ = true;
+        } else if (field == "event") {
+            event_.event.assign(value.data(), value.size());
+        } else if (field == "id") {
+            event_.id.assign(value.data(), value.size());
+        }
+    }
+
+    template<class Callback>
+    void dispatch(Callback& on_event) {
+        if (has_data_) {
+            on_event(event_);
+        }
+        event_.event.clear();
+        event_.data.clear();
+        has_data_ = false;
+    }
+
+    std::string line_;
+    SseEvent event_;
+    bool has_data_ = false;
+    bool skip_lf_ = false;
+};
+
+// 解析模型的 SSE 输出，每个 data 事件转换成一个 LLMToken
+// 配置:
+//   text_pointer: token 文本在 data json 里的 json pointer. 为空时依次尝试
+//                 /token/text (TGI) /choices/0/delta/content /choices/0/text (OpenAI)
+//   done_marker:  结束标记，默认 "[DONE]"
+class SseParserNode : public BaseNode {
+public:
+    Status init(json& option) {
+        std::string pointer = option.value("text_pointer", "");
+        if (!pointer.empty()) {
+            pointers_ = {json::json_pointer(pointer)};
+        }
+        done_marker_ = option.value("done_marker", "[DONE]");
+        return Status::OK();
+    }
+
+    Status run(ByteStream& body, Stream<LLMToken>& tokens) {
+        SseParser parser;
+        int64_t index = 0;
+        bool finished = false;
+        auto on_event = [&](SseEvent& event) {
+            if (finished) {
+                return;
+            }
+            LLMToken token;
+            token.index = index++;
+            if (event.data == done_marker_) {
+                token.finished = true;
+            } else {
+                parse_token(event.data, token);
+            }
+            finished = token.finished;
+            tokens.append(std::move(token));
+        };
+
+        while (true) {
+            butil::IOBuf chunk;
+            Status status = body.read(chunk);
+            if (status.error_code() == 1) {
+                break;
+            }
+            if (!status.ok()) {
+                return status;
+            }
+            parser.feed(chunk, on_event);
+        }
+        parser.finish(on_event);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(body, ByteStream),
+        OUTPUT(tokens, Stream<LLMToken>),
+    );
+
+private:
+    void parse_token(const std::string& data, LLMToken& token) {
+        json value = json::parse(data, nullptr, false);
+        if (value.is_discarded()) {
+            token.text = data; // 不是 json 就把原文当作 token
+            return;
+        }
+        for (auto& pointer : pointers_) {
+            if (value.contains(pointer) && value[pointer].is_string()) {
+                token.text = value[pointer].get<std::string>();
+                break;
+            }
+        }
+        // TGI 最后一个事件带 generated_text; OpenAI 带 finish_reason
+        auto generated_text = value.find("generated_text");
+        if (generated_text != value.end() && !generated_text->is_null()) {
+            token.finished = true;
+        }
+        static const json::json_pointer finish_reason("/choices/0/finish_reason");
+        if (value.contains(finish_reason) && !value[finish_reason].is_null()) {
+            token.finished = true;
+        }
+    }
+
+    std::vector<json::json_pointer> pointers_ = {
+        json::json_pointer("/token/text"),
+        json::json_pointer("/choices/0/delta/content"),
+        json::json_pointer("/choices/0/text"),
+    };
+    std::string done_marker_ = "[DONE]";
+};
+REGISTER_CLASS(SseParserNode);
+
+using TokenCoalesce = CoalesceNode<LLMToken>;
+REGISTER_CLASS(TokenCoalesce);
+
+}
@@ -0,0 +1,468 @@
+#pragma once
+#include <array>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "brpc_utils.h"
+#include "metrics.h"
+#include "node.h"
+
+namespace stream_dag {
+
+// 编译期连接的图
+//   节点和边都是类型，端口不存在、方向不对、两端流类型不一致、一个端口连了两次，都在编译期报错
+//   每个请求的流放在 StaticGraph::Streams 的 tuple 里，执行时节点参数按下标取，不查表、不做 any_cast
+//   端口用 DECLARE_PARAMS 生成的 ports 枚举指定; 适合写死在程序里的图，从配置加载的图仍然用 StreamGraph
+//
+//   using Graph = StaticGraph<
+//       Nodes<Source, HttpNode, SseParserNode>,
+//       Edge<0, Source::ports::request, 1, HttpNode::ports::request_>,
+//       Edge<1, HttpNode::ports::stream_body, 2, SseParserNode::ports::body>,
+//       Sink<2, SseParserNode::ports::tokens>>;
+//   Graph g({"source", "http", "parser"});
+//   Graph::Streams streams(ctx, g);
+//   Status status = g.run(ctx, streams);
+//   auto& tokens = streams.get<2, SseParserNode::ports::tokens>();
+
+template<class... N> struct Nodes {};
+
+// 第 From 个节点的输出端口 Out 连到第 To 个节点的输入端口 In，下标是节点在 Nodes 里的位置
+template<size_t From, size_t Out, size_t To, size_t In> struct Edge {};
+
+// 第 Node 个节点的输出端口 Out 是 sink 流，计入请求时延
+template<size_t Node, size_t Out> struct Sink {};
+
+namespace static_graph_detail {
+
+enum PortKind { kOther, kInput, kOutput, kCallee };
+
+template<class W> struct port_traits {
+    static constexpr PortKind kind = kOther;
+    using data_type = void;
+};
+
+template<class T> struct port_traits<NodeInputWrppper<T>> {
+    static constexpr PortKind kind = kInput;
+    using data_type = T;
+};
+
+template<class T> struct port_traits<NodeOutputWrppper<T>> {
+    static constexpr PortKind kind = kOutput;
+    using data_type = T;
+};
+
+template<class T> struct port_traits<NodeCalleeWrapper<T>> {
+    static constexpr PortKind kind = kCallee;
+    using data_type = void;
+};
+
+template<class N>
+using wrappers_t = decltype(std::declval<N&>().wrappers);
+
+template<class N>
+constexpr size_t port_count = std::tuple_size_v<wrappers_t<N>>;
+
+template<class N, size_t P>
+using port_t = port_traits<std::remove_reference_t<std::tuple_element_t<P, wrappers_t<N>>>>;
+
+struct ItemInfo {
+    bool edge = false;
+    bool sink = false;
+    size_t from = 0, out = 0, to = 0, in = 0;
+};
+
+template<class Item> struct item_traits {
+    static constexpr ItemInfo info{};
+};
+
+template<size_t From, size_t Out, size_t To, size_t In> struct item_traits<Edge<From, Out, To, In>> {
+    static constexpr ItemInfo info{true, false, From, Out, To, In};
+};
+
+template<size_t Node, size_t Out> struct item_traits<Sink<Node, Out>> {
+    static constexpr ItemInfo info{false, true, Node, Out, 0, 0};
+};
+
+// 节点对象. 节点不能移动，在 tuple 里原地构造
+template<class N>
+struct NodeHolder {
+    NodeHolder(const std::string& name) : node(name, typeid(N).name()) {}
+    N node;
+};
+
+struct SlotInit {
+    BaseContext& ctx;
+    const std::string& name;
+};
+
+// 一个流. 连到上游的输入端口和子节点端口不占流，用 NoSlot 占位
+template<class T>
+struct Slot {
+    Slot(const SlotInit& init) : value(init.ctx, init.name, typeid(T).name()) {}
+    T value;
+};
+
+struct NoSlot {
+    NoSlot(const SlotInit&) {}
+};
+
+}
+
+template<class NodeList, class... Items>
+class StaticGraph;
+
+template<class... N, class... Items>
+class StaticGraph<Nodes<N...>, Items...> {
+    template<class W> using port_traits = static_graph_detail::port_traits<W>;
+    using ItemInfo = static_graph_detail::ItemInfo;
+    using PortKind = static_graph_detail::PortKind;
+
+public:
+    static constexpr size_t kNodes = sizeof...(N);
+
+    template<size_t I>
+    using node_t = std::tuple_element_t<I, std::tuple<N...>>;
+
+private:
+    static constexpr std::array<size_t, kNodes + 1> offsets() {
+        std::array<size_t, kNodes + 1> result{};
+        size_t counts[] = {static_graph_detail::port_count<N>..., 0};
+        for (size_t i = 0; i < kNodes; i++) {
+            result[i + 1] = result[i] + counts[i];
+        }
+        return result;
+    }
+
+    static constexpr std::array<size_t, kNodes + 1> kOffsets = offsets();
+    static constexpr size_t kPorts = kOffsets[kNodes];
+    static constexpr std::array<ItemInfo, sizeof...(Items)> kItems = {static_graph_detail::item_traits<Items>::info...};
+
+    // 端口按节点顺序展开后的下标
+    static constexpr size_t flat(size_t node, size_t port) { return kOffsets[node] + port; }
+
+    static constexpr size_t node_of(size_t f) {
+        size_t node = 0;
+        while (kOffsets[node + 1] <= f) {
+            node++;
+        }
+        return node;
+    }
+
+    static constexpr size_t port_of(size_t f) { return f - kOffsets[node_of(f)]; }
+
+    template<size_t F>
+    using flat_port_t = static_graph_detail::port_t<node_t<node_of(F)>, port_of(F)>;
+
+    template<size_t I, size_t P>
+    static constexpr bool valid_port() {
+        if constexpr (I >= kNodes) {
+            return false;
+        } else {
+            return P < static_graph_detail::port_count<node_t<I>>;
+        }
+    }
+
+    template<class Item>
+    static constexpr bool check_item() {
+        constexpr ItemInfo info = static_graph_detail::item_traits<Item>::info;
+        static_assert(info.edge || info.sink, "StaticGraph 的参数只能是 Edge 或 Sink");
+        if constexpr (info.edge || info.sink) {
+            static_assert(valid_port<info.from, info.out>(), "边的起点不存在");
+            if constexpr (valid_port<info.from, info.out>()) {
+                using From = static_graph_detail::port_t<node_t<info.from>, info.out>;
+                static_assert(From::kind == static_graph_detail::kOutput, "边的起点必须是 OUTPUT 端口");
+                if constexpr (info.edge) {
+                    static_assert(valid_port<info.to, info.in>(), "边的终点不存在");
+                    if constexpr (valid_port<info.to, info.in>()) {
+                        using To = static_graph_detail::port_t<node_t<info.to>, info.in>;
+                        static_assert(To::kind == static_graph_detail::kInput, "边的终点必须是 INPUT 端口");
+                        static_assert(std::is_same<typename From::data_type, typename To::data_type>::value,
+                                      "边两端的流类型不一致");
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    template<class T>
+    static constexpr bool check_node() {
+        static_assert(std::is_base_of<BaseNode, T>::value, "节点需要继承 BaseNode");
+        return true;
+    }
+
+    template<size_t... F>
+    static constexpr bool check_ports(std::index_sequence<F...>) {
+        static_assert(((flat_port_t<F>::kind != static_graph_detail::kOther) && ...),
+                      "节点端口只能是 INPUT / OUTPUT / DEPEND");
+        static_assert(((flat_port_t<F>::kind != static_graph_detail::kOutput && flat_port_t<F>::kind != static_graph_detail::kInput
+                        || std::is_base_of<PipeStreamBase, typename flat_port_t<F>::data_type>::value) && ...),
+                      "静态图的端口只支持 PipeStream、ByteStream 这类流");
+        return true;
+    }
+
+    // 每个输入最多一条边，每个输出最多一个下游
+    static constexpr bool unique_ends() {
+        for (size_t i = 0; i < kItems.size(); i++) {
+            for (size_t j = i + 1; j < kItems.size(); j++) {
+                if (kItems[i].edge && kItems[j].edge) {
+                    if (kItems[i].to == kItems[j].to && kItems[i].in == kItems[j].in) {
+                        return false;
+                    }
+                    if (kItems[i].from == kItems[j].from && kItems[i].out == kItems[j].out) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    static_assert((check_node<N>() && ...));
+    static_assert((check_item<Items>() && ...));
+    static_assert(check_ports(std::make_index_sequence<kPorts>{}));
+    static_assert(unique_ends(), "一个输入端口只能连一条边，一个输出端口只能有一个下游");
+
+    // 端口实际使用的流: 连了边的输入端口用上游输出的流，其它端口用自己的
+    static constexpr size_t source(size_t f) {
+        for (auto& item : kItems) {
+            if (item.edge && flat(item.to, item.in) == f) {
+                return flat(item.from, item.out);
+            }
+        }
+        return f;
+    }
+
+    static constexpr bool is_sink(size_t f) {
+        for (auto& item : kItems) {
+            if (item.sink && flat(item.from, item.out) == f) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<size_t F>
+    static constexpr bool owns_slot() {
+        constexpr PortKind kind = flat_port_t<F>::kind;
+        return kind == static_graph_detail::kOutput || (kind == static_graph_detail::kInput && source(F) == F);
+    }
+
+    template<size_t F>
+    using slot_t = std::conditional_t<owns_slot<F>(),
+        static_graph_detail::Slot<typename flat_port_t<F>::data_type>, static_graph_detail::NoSlot>;
+
+    template<class Seq> struct slots;
+    template<size_t... F> struct slots<std::index_sequence<F...>> {
+        using type = std::tuple<slot_t<F>...>;
+    };
+
+public:
+    // 一个请求的所有流. 没有连边的输入端口也有自己的流，调用方在 run 之前写入，执行开始时半关闭
+    class Streams {
+    public:
+        Streams(BaseContext& ctx, StaticGraph& g) : Streams(ctx, g, std::make_index_sequence<kPorts>{}) {}
+
+        Streams(const Streams&) = delete;
+        Streams& operator=(const Streams&) = delete;
+
+        // 第 I 个节点端口 P 上的流
+        template<size_t I, size_t P>
+        auto& get() {
+            static_assert(valid_port<I, P>(), "端口不存在");
+            static_assert(flat_port_t<flat(I, P)>::kind != static_graph_detail::kCallee, "DEPEND 端口没有流");
+            return std::get<source(flat(I, P))>(slots_).value;
+        }
+
+        // 第 I 个节点的返回值
+        const Status& status(size_t i) const { return status_[i]; }
+
+    private:
+        friend class StaticGraph;
+
+        template<size_t... F>
+        Streams(BaseContext& ctx, StaticGraph& g, std::index_sequence<F...>)
+            : slots_(static_graph_detail::SlotInit{ctx, g.port_name<F>()}...) {}
+
+        typename slots<std::make_index_sequence<kPorts>>::type slots_;
+        std::array<Status, kNodes> status_;
+    };
+
+    // names 是各节点的名字，和 StreamGraph 里一样是流名的前缀
+    StaticGraph(const std::array<std::string, kNodes>& names) : StaticGraph(names, std::make_index_sequence<kNodes>{}) {}
+    StaticGraph() : StaticGraph(default_names()) {}
+
+    StaticGraph(const StaticGraph&) = delete;
+    StaticGraph& operator=(const StaticGraph&) = delete;
+
+    void set_name(const std::string& name) { name_ = name; }
+    const std::string& name() const { return name_; }
+
+    template<size_t I>
+    node_t<I>& node() { return std::get<I>(nodes_).node; }
+
+    // 每个节点在自己的 bthread 里执行，全部结束后返回. 返回第一个失败节点的状态
+    //   节点通过 DEPEND 调用的子节点仍然登记在 ctx 里
+    Status run(BaseContext& ctx, Streams& streams) {
+        int64_t run_start = butil::gettimeofday_us();
+        ctx.latency().admit(run_start);
+
+        Status status = prepare(ctx, streams, std::make_index_sequence<kNodes>{});
+        if (!status.ok()) {
+            return status;
+        }
+        prepare_streams(streams, std::make_index_sequence<kPorts>{});
+
+        std::array<Task, kNodes> tasks;
+        std::array<BThread, kNodes> threads;
+        for (size_t i = 0; i < kNodes; i++) {
+            tasks[i] = Task{this, &ctx, &streams};
+            threads[i] = BThread::start(kRunners[i], &tasks[i]);
+        }
+        for (size_t i = 0; i < kNodes; i++) {
+            if (threads[i].join() != 0) {
+                return Status(-1, "Internal error bthread join failed");
+            }
+        }
+
+        int64_t run_stop = butil::gettimeofday_us();
+        RequestLatency& latency = ctx.latency();
+        latency.finish(run_stop);
+        if (MetricsRegistry::is_enabled()) {
+            GraphMetrics* metrics = MetricsRegistry::graph(name_);
+            metrics->run << run_stop - run_start;
+            if (latency.elements() > 0) {
+                metrics->ttft << latency.ttft_us();
+                for (int64_t gap : latency.itl()) {
+                    metrics->itl << gap;
+                }
+                metrics->tokens_per_second << (int64_t) latency.tokens_per_second();
+            }
+        }
+
+        for (auto& node_status : streams.status_) {
+            if (!node_status.ok()) {
+                return node_status;
+            }
+        }
+        return Status::OK();
+    }
+
+private:
+    struct Task {
+        StaticGraph* graph = nullptr;
+        BaseContext* ctx = nullptr;
+        Streams* streams = nullptr;
+    };
+
+    template<size_t... I>
+    StaticGraph(const std::array<std::string, kNodes>& names, std::index_sequence<I...>)
+        : nodes_(names[I]...) {}
+
+    static std::array<std::string, kNodes> default_names() {
+        std::array<std::string, kNodes> names;
+        for (size_t i = 0; i < kNodes; i++) {
+            names[i] = "n" + std::to_string(i);
+        }
+        return names;
+    }
+
+    template<size_t F>
+    const std::string& port_name() {
+        return std::get<port_of(F)>(node<node_of(F)>().wrappers).fullname();
+    }
+
+    template<size_t... I>
+    Status prepare(BaseContext& ctx, Streams& streams, std::index_sequence<I...>) {
+        Status status;
+        // 按节点顺序初始化，遇到失败停止
+        ((status.ok() ? (void) (status = prepare_node(ctx, node<I>())) : (void) 0), ...);
+        return status;
+    }
+
+    static Status prepare_node(BaseContext& ctx, BaseNode& node) {
+        Status status = node.ensure_init();
+        if (!status.ok() || node.list_depend().empty()) {
+            return status;
+        }
+        return node.init_callees(ctx);
+    }
+
+    template<size_t... F>
+    void prepare_streams(Streams& streams, std::index_sequence<F...>) {
+        (prepare_stream<F>(streams), ...);
+    }
+
+    template<size_t F>
+    void prepare_stream(Streams& streams) {
+        constexpr PortKind kind = flat_port_t<F>::kind;
+        if constexpr (kind == static_graph_detail::kOutput && is_sink(F)) {
+            std::get<F>(streams.slots_).value.mark_sink();
+        } else if constexpr (kind == static_graph_detail::kInput && source(F) == F) {
+            std::get<F>(streams.slots_).value.half_close();
+        }
+    }
+
+    // 节点第 P 个参数: 流按下标取，子节点从 ctx 取
+    template<size_t I, size_t P>
+    decltype(auto) param(BaseContext& ctx, Streams& streams) {
+        constexpr size_t f = flat(I, P);
+        if constexpr (flat_port_t<f>::kind == static_graph_detail::kCallee) {
+            return ctx.get(std::get<P>(node<I>().wrappers));
+        } else {
+            return (std::get<source(f)>(streams.slots_).value);
+        }
+    }
+
+    template<size_t I, size_t... P>
+    Status call(BaseContext& ctx, Streams& streams, std::index_sequence<P...>) {
+        return node<I>().run(param<I, P>(ctx, streams)...);
+    }
+
+    template<size_t I, size_t... P>
+    void close_outputs(BaseContext& ctx, Streams& streams, std::index_sequence<P...>) {
+        (close_output<I, P>(ctx, streams), ...);
+    }
+
+    template<size_t I, size_t P>
+    void close_output(BaseContext& ctx, Streams& streams) {
+        constexpr size_t f = flat(I, P);
+        if constexpr (flat_port_t<f>::kind == static_graph_detail::kOutput) {
+            std::get<f>(streams.slots_).value.auto_close();
+            if constexpr (is_sink(f)) {
+                ctx.latency().on_close(butil::gettimeofday_us());
+            }
+        }
+    }
+
+    template<size_t I>
+    static void* run_node_in_bthread(void* arg) {
+        Task& task = *static_cast<Task*>(arg);
+        StaticGraph& g = *task.graph;
+        using Ports = std::make_index_sequence<static_graph_detail::port_count<node_t<I>>>;
+        Status status;
+        try {
+            status = run_node<node_t<I>>([&] {
+                return g.template call<I>(*task.ctx, *task.streams, Ports{});
+            });
+        } catch (const std::exception& e) {
+            status = Status(-1, e.what());
+        }
+        task.streams->status_[I] = status;
+        g.template close_outputs<I>(*task.ctx, *task.streams, Ports{});
+        return nullptr;
+    }
+
+    template<size_t... I>
+    static constexpr std::array<void* (*)(void*), kNodes> runners(std::index_sequence<I...>) {
+        return {&run_node_in_bthread<I>...};
+    }
+
+    static constexpr std::array<void* (*)(void*), kNodes> kRunners = runners(std::make_index_sequence<kNodes>{});
+
+    std::string name_ = "static_graph";
+    std::tuple<static_graph_detail::NodeHolder<N>...> nodes_;
+};
+
+}
@@ -1,11 +1,13 @@
 #pragma once
 #include "context.h"
 #include "stream.h"
+#include "byte_stream.h"
 #include "node.h"
 #include "executor.h"
 #include "graph.h"
 #include "factory.h"
 #include "when_any.h"
+#include "context_pool.h"
 
 namespace stream_dag {
 
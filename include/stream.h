@@ -1,9 +1,12 @@
 #pragma once
 #include "context.h"
 #include "to_json.h"
+#include "metrics.h"
+#include "node_state.h"
 #include "bthread/butex.h"
 #include "bthread/condition_variable.h"
 #include <memory>
+#include <memory_resource>
 #include <tuple>
 #include <nlohmann/json.hpp>
 
@@ -204,7 +207,12 @@ enum class StreamStatus {
 class PipeStreamBase {
 public:
     PipeStreamBase(BaseContext& ctx, const std::string& name, const std::string& type) : ctx_(ctx), name_(name), type_(type) {}
-    virtual ~PipeStreamBase() = default;
+    virtual ~PipeStreamBase() {
+        // 没读走的元素不再计入 backlog
+        if (metrics_ && backlog_ != 0) {
+            metrics_->backlog << -backlog_;
+        }
+    }
 
     void close() {
         std::unique_lock<bthread::Mutex> lock_(mutex_);
@@ -215,6 +223,10 @@ public:
         // }
         lock_.unlock();
         cond_.notify_one();
+        // 转换边上读端阻塞在下游流上，一起关闭
+        if (downstream_) {
+            downstream_->close();
+        }
     }
 
     bool is_close() {
@@ -226,16 +238,21 @@ public:
     void half_close(Status status=Status::OK()) {
         std::unique_lock<bthread::Mutex> lock_(mutex_);
 
-        json trace_info;
-        trace_info["code"] = status.error_code();
-        trace_info["msg"] = status.error_str();
-        trace("PipeStreamBase::half_close", trace_info);
+        if (ctx_.trace_enabled()) {
+            json trace_info;
+            trace_info["code"] = status.error_code();
+            trace_info["msg"] = status.error_str();
+            trace("PipeStreamBase::half_close", trace_info);
+        }
         half_closed_ = true;
         // for (auto& it : callback_) {
         //     it.second(Status(1, "half_close"));
         // }
         lock_.unlock();
         cond_.notify_one();
+        if (downstream_) {
+            downstream_->half_close(status);
+        }
     }
 
     void set_auto_close(bool enable=true) {
@@ -253,11 +270,130 @@ public:
         return half_closed_;
     }
 
-    void trace(const std::string& event, json value) {
-        ctx_.trace_stream(name_, type_, event, value);
+    // 没开 trace 时直接返回，读写路径上不构造 event 字符串
+    void trace(const char* event, const json& value) {
+        if (ctx_.trace_enabled()) {
+            ctx_.trace_stream(name_, type_, event, value);
+        }
+    }
+
+    // 绑定指标，open_us 是写这个流的节点开始执行的时间
+    void bind_metrics(StreamMetrics* metrics, int64_t open_us) {
+        // 转换边上数据都在下游流里，指标也记在下游
+        if (downstream_) {
+            return downstream_->bind_metrics(metrics, open_us);
+        }
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        metrics_ = metrics;
+        open_us_ = open_us;
+        last_append_us_ = 0;
+    }
+
+    const std::string& name() const { return name_; }
+
+    // 流所属的 ctx
+    BaseContext& context() const { return ctx_; }
+
+    // 当前状态，给 inspector 用
+    json inspect() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        return json({
+            {"name", name_},
+            {"pending", pending_locked()},
+            {"half_closed", half_closed_},
+            {"closed", closed_},
+        });
+    }
+
+    // 标记为 sink 流，写入时记录到 ctx 的请求时延里
+    void mark_sink() {
+        if (downstream_) {
+            return downstream_->mark_sink();
+        }
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        sink_ = true;
+    }
+
+    // 等到有数据可读或者写端关闭，不取走数据. 在线程池执行的节点先在 bthread 里等输入就绪，再占线程
+    void wait_readable() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        while (pending_locked() == 0 && !closed_ && !half_closed_) {
+            cond_.wait_for(lock_, 1000000);
+        }
+    }
+
+    // 没有下游也不是 sink 的输出，写入直接丢弃，不占缓冲区. 由图的执行计划决定
+    void set_discard() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        discard_ = true;
+    }
+
+    // 复用 ctx 时重置为刚创建的状态. 缓冲区保留容量，下一个请求不需要重新分配
+    void reset() {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        if (metrics_ && backlog_ != 0) {
+            metrics_->backlog << -backlog_;
+        }
+        half_closed_ = false;
+        closed_ = false;
+        enable_auto_close_ = true;
+        metrics_ = nullptr;
+        open_us_ = 0;
+        last_append_us_ = 0;
+        backlog_ = 0;
+        sink_ = false;
+        discard_ = false;
+        reset_locked();
+        lock_.unlock();
+        // 转换边的下游流不是节点的输出，跟着上游一起重置. 连接关系保留
+        if (downstream_) {
+            downstream_->reset();
+        }
     }
 
 protected:
+    // 以下函数需要持有 mutex_
+    // 还没读走的元素数
+    virtual size_t pending_locked() const { return 0; }
+    // 清空缓冲区
+    virtual void reset_locked() {}
+
+    void record_append(size_t bytes) {
+        if (metrics_ == nullptr && !sink_) {
+            return;
+        }
+        int64_t now = butil::gettimeofday_us();
+        if (sink_) {
+            ctx_.latency().on_output(now);
+        }
+        if (metrics_ == nullptr) {
+            return;
+        }
+        int64_t first_output = now - open_us_;
+        int64_t output_gap = now - last_append_us_;
+        bool first = last_append_us_ == 0;
+        metrics_->node.record([&](NodeMetrics& m) {
+            if (first) {
+                m.first_output << first_output;
+            } else {
+                m.output_gap << output_gap;
+            }
+            m.elements << 1;
+            m.bytes << (int64_t) bytes;
+        });
+        last_append_us_ = now;
+        backlog_ += 1;
+        metrics_->backlog << 1;
+    }
+
+    void record_read() {
+        if (metrics_ == nullptr) {
+            return;
+        }
+        backlog_ -= 1;
+        metrics_->backlog << -1;
+    }
+
     BaseContext& ctx_;
     std::string name_, type_;
 
@@ -265,6 +401,17 @@ protected:
     bool closed_ = false;
     bool enable_auto_close_ = true;
 
+    // 指标
+    StreamMetrics* metrics_ = nullptr;
+    int64_t open_us_ = 0;
+    int64_t last_append_us_ = 0;
+    int64_t backlog_ = 0;
+    bool sink_ = false;
+    bool discard_ = false;
+
+    // 转换边的下游流. 关闭、指标、重置都转给它
+    PipeStreamBase* downstream_ = nullptr;
+
     bthread::ConditionVariable cond_;
     bthread::Mutex mutex_;
 
@@ -275,14 +422,39 @@ protected:
 
 };
 
+// 转换边挂在上游流上的转发器，把写入的元素转换后写到下游流
+template<class T>
+class StreamForward {
+public:
+    virtual ~StreamForward() = default;
+    virtual Status forward(T& data) = 0;
+};
+
 template<class T>
 class PipeStream : public PipeStreamBase {
 public:
-    using PipeStreamBase::PipeStreamBase;
+    // 缓冲区从 ctx 的 arena 分配
+    PipeStream(BaseContext& ctx, const std::string& name, const std::string& type)
+        : PipeStreamBase(ctx, name, type), buf_(&ctx.arena()) {}
+
+    // 接到转换边上，之后写入的元素不进自己的缓冲区. 只在执行前连接时调用
+    void set_forward(std::shared_ptr<StreamForward<T>> forward, PipeStreamBase* downstream) {
+        forward_ = std::move(forward);
+        downstream_ = downstream;
+    }
 
     Status append(T&& data) {
+        if (forward_) {
+            return forward_->forward(data);
+        }
         std::unique_lock<bthread::Mutex> lock_(mutex_);
-        trace("PipeStreamBase::append", to_json(data));
+        if (discard_) {
+            return Status::OK();
+        }
+        if (ctx_.trace_enabled()) {
+            trace("PipeStreamBase::append", to_json(data));
+        }
+        record_append(byte_size(data));
         buf_.push_back(data);
         // for (auto& it : callback_) {
         //     it.second(Status::OK());
@@ -292,8 +464,17 @@ public:
         return Status::OK();
     }
     Status append(T& data) {
+        if (forward_) {
+            return forward_->forward(data);
+        }
         std::unique_lock<bthread::Mutex> lock_(mutex_);
-        trace("PipeStreamBase::append", data.to_json());
+        if (discard_) {
+            return Status::OK();
+        }
+        if (ctx_.trace_enabled()) {
+            trace("PipeStreamBase::append", to_json(data));
+        }
+        record_append(byte_size(data));
         buf_.push_back(data);
         // for (auto& it : callback_) {
         //     it.second(Status::OK());
@@ -305,6 +486,7 @@ public:
 
     Status read(T& result) {
         std::unique_lock<bthread::Mutex> lock_(mutex_);
+        BlockedScope blocked(name_, buf_.size() <= top_ && !closed_ && !half_closed_);
         while (buf_.size() <= top_ && !closed_ && !half_closed_) {
             trace("PipeStreamBase::read wait", json());
             int rc = cond_.wait_for(lock_, 1000000);
@@ -315,12 +497,13 @@ public:
             if (rc != 0) {
                 return Status(-1, "PipeStreamBase::read wait %s", berror(rc));
             }
-            trace("PipeStreamBase::read wake", json({{"rc", rc}}));
+            trace("PipeStreamBase::read wake", ctx_.trace_enabled() ? json({{"rc", rc}}) : json());
         }
         if (top_ < buf_.size()) {
             trace("PipeStreamBase::read buf", json());
             result = buf_[top_];
             top_ += 1;
+            record_read();
             return Status::OK();
         }
         if (closed_) {
@@ -339,8 +522,36 @@ public:
         return {status, result};
     }
 
+    // 带超时的读. deadline_us 是 gettimeofday_us 的绝对时间，超时返回错误码 3
+    Status read_until(T& result, int64_t deadline_us) {
+        std::unique_lock<bthread::Mutex> lock_(mutex_);
+        BlockedScope blocked(name_, buf_.size() <= top_ && !closed_ && !half_closed_);
+        while (buf_.size() <= top_ && !closed_ && !half_closed_) {
+            int64_t remain_us = deadline_us - butil::gettimeofday_us();
+            if (remain_us <= 0) {
+                return Status(3, "PipeStreamBase::read timeout");
+            }
+            int rc = cond_.wait_for(lock_, remain_us);
+            if (rc != 0 && rc != ETIMEDOUT) {
+                return Status(-1, "PipeStreamBase::read wait %s", berror(rc));
+            }
+        }
+        if (top_ < buf_.size()) {
+            trace("PipeStreamBase::read buf", json());
+            result = buf_[top_];
+            top_ += 1;
+            record_read();
+            return Status::OK();
+        }
+        if (closed_) {
+            return Status(2, "PipeStreamBase::read closed");
+        }
+        return Status(1, "PipeStreamBase::read half_closed");
+    }
+
     Status wait() {
         std::unique_lock<bthread::Mutex> lock_(mutex_);
+        BlockedScope blocked(name_, buf_.size() <= top_ && !closed_ && !half_closed_);
         while (buf_.size() <= top_ && !closed_ && !half_closed_) {
             trace("PipeStreamBase::wait wait", json());
             int rc = cond_.wait_for(lock_, 1000000);
@@ -374,10 +585,16 @@ public:
     }
 
 private:
+    size_t pending_locked() const { return buf_.size() - top_; }
 
+    void reset_locked() {
+        buf_.clear();
+        top_ = 0;
+    }
 
-    std::vector<T> buf_;
+    std::pmr::vector<T> buf_;
     int top_ = 0;
+    std::shared_ptr<StreamForward<T>> forward_;
 
 };
 
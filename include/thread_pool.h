@@ -0,0 +1,155 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bthread/bthread.h"
+#include "bthread/condition_variable.h"
+#include <nlohmann/json.hpp>
+
+namespace stream_dag {
+
+using json = nlohmann::json;
+
+// 节点的执行方式
+//   bthread: 默认，在自己的 bthread 里执行
+//   cpu_bound: 重计算（拼 json、安全匹配、分词），放到 cpu_bound 线程池，不占和 brpc IO 共用的 bthread worker
+//   blocking: 会阻塞在系统调用上，放到 blocking 线程池
+enum NodeExec {
+    kExecBthread = 0,
+    kExecCpuBound = 1,
+    kExecBlocking = 2,
+};
+
+inline const char* node_exec_name(NodeExec exec) {
+    switch (exec) {
+        case kExecBthread: return "bthread";
+        case kExecCpuBound: return "cpu_bound";
+        case kExecBlocking: return "blocking";
+    }
+    return "unknown";
+}
+
+inline bool node_exec_from_name(const std::string& name, NodeExec* exec) {
+    for (NodeExec e : {kExecBthread, kExecCpuBound, kExecBlocking}) {
+        if (name == node_exec_name(e)) {
+            *exec = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 固定线程数的 pthread 池
+//   调用方在 bthread 里时，等待期间只挂起这个 bthread，不占 bthread worker
+//   池里执行的节点读写流照常，流的锁和条件变量是 bthread 的，pthread 上也能用
+//   池里的线程在节点执行期间一直被占着. 池里的节点再用 FanOut 或者执行器跑同一个池的子图节点时，
+//   并发数超过线程数会互相等死，这种子图节点用 bthread 执行或者放到另一个池
+class NodeThreadPool {
+public:
+    // 线程数在第一次执行 cpu_bound / blocking 节点之前设置，之后不再生效
+    static void set_threads(NodeExec exec, int threads) {
+        if (exec == kExecCpuBound || exec == kExecBlocking) {
+            default_threads(exec).store(std::max(threads, 1), std::memory_order_relaxed);
+        }
+    }
+
+    // bthread 执行的节点返回 nullptr
+    static NodeThreadPool* of(NodeExec exec) {
+        if (exec == kExecCpuBound) {
+            static NodeThreadPool* pool = new NodeThreadPool(exec);
+            return pool;
+        }
+        if (exec == kExecBlocking) {
+            static NodeThreadPool* pool = new NodeThreadPool(exec);
+            return pool;
+        }
+        return nullptr;
+    }
+
+    // 在池里的线程上执行 fn(arg)，执行完后返回
+    void run(void (*fn)(void*), void* arg) {
+        std::call_once(start_once_, [this] { start(); });
+        Task task{fn, arg};
+        {
+            std::unique_lock<std::mutex> lock_(mutex_);
+            queue_.push_back(&task);
+        }
+        cond_.notify_one();
+        std::unique_lock<bthread::Mutex> lock_(task.mutex);
+        while (!task.done) {
+            task.cond.wait(lock_);
+        }
+    }
+
+    json inspect() {
+        std::unique_lock<std::mutex> lock_(mutex_);
+        return json({
+            {"exec", node_exec_name(exec_)},
+            {"threads", threads_.size()},
+            {"busy", busy_},
+            {"queued", queue_.size()},
+        });
+    }
+
+private:
+    struct Task {
+        void (*fn)(void*);
+        void* arg;
+        bthread::Mutex mutex;
+        bthread::ConditionVariable cond;
+        bool done = false;
+    };
+
+    explicit NodeThreadPool(NodeExec exec) : exec_(exec) {}
+
+    static std::atomic<int>& default_threads(NodeExec exec) {
+        static std::atomic<int> cpu_bound{std::max<int>(std::thread::hardware_concurrency(), 1)};
+        static std::atomic<int> blocking{64};
+        return exec == kExecCpuBound ? cpu_bound : blocking;
+    }
+
+    // 池和进程一样长，线程不退出
+    void start() {
+        int threads = default_threads(exec_).load(std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock_(mutex_);
+        for (int i = 0; i < threads; i++) {
+            threads_.emplace_back([this] { loop(); });
+            threads_.back().detach();
+        }
+    }
+
+    void loop() {
+        while (true) {
+            std::unique_lock<std::mutex> lock_(mutex_);
+            cond_.wait(lock_, [this] { return !queue_.empty(); });
+            Task* task = queue_.front();
+            queue_.pop_front();
+            busy_++;
+            lock_.unlock();
+
+            task->fn(task->arg);
+
+            lock_.lock();
+            busy_--;
+            lock_.unlock();
+            // task 在调用方的栈上，通知之后不能再访问
+            std::unique_lock<bthread::Mutex> task_lock(task->mutex);
+            task->done = true;
+            task->cond.notify_one();
+        }
+    }
+
+    NodeExec exec_;
+    std::once_flag start_once_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Task*> queue_;
+    std::vector<std::thread> threads_;
+    int busy_ = 0;
+};
+
+}
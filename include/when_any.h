@@ -65,8 +65,12 @@ std::tuple<std::optional<T1>, std::optional<T2>> when_any(Stream<T1>& t1, Stream
     }, &args2);
 
     std::unique_lock<bthread::Mutex> lock(mutex);
-    while (stop_flag == 0 && !t1.readable() && !t2.readable()) {
-        cond.wait(lock);
+    {
+        // inspector 里只显示第一个流
+        BlockedScope blocked(t1.name());
+        while (stop_flag == 0 && !t1.readable() && !t2.readable()) {
+            cond.wait(lock);
+        }
     }
     
     bthread_interrupt(bid1);
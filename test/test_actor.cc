@@ -0,0 +1,126 @@
+#include "include/stream-dag.h"
+#include "include/actor.h"
+#include <gflags/gflags.h>
+#include <cassert>
+#include <thread>
+
+using namespace stream_dag;
+
+// 有状态的 actor: 记住处理过多少批，一批的开销固定，攒批越多越省
+class Doubler : public ActorNode<int, int> {
+public:
+    using ActorNode::ActorNode;
+
+    Status process(std::vector<Item>& batch) {
+        batches_++;
+        max_batch_ = std::max(max_batch_.load(), (int) batch.size());
+        bthread_usleep(2000);
+        for (auto& item : batch) {
+            if (item.input() < 0) {
+                item.fail(Status(-1, "negative input"));
+                continue;
+            }
+            item.reply(item.input() * 2);
+        }
+        return Status::OK();
+    }
+
+    std::atomic<int> batches_{0}, max_batch_{0};
+};
+REGISTER_CLASS(Doubler);
+
+class Numbers : public BaseNode {
+public:
+    Status init(json& option) {
+        start_ = option.value("start", 0);
+        return Status::OK();
+    }
+
+    Status run(Stream<int>& out) {
+        for (int i = 0; i < 4; i++) {
+            out.append(start_ + i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+
+private:
+    int start_ = 0;
+};
+REGISTER_CLASS(Numbers);
+
+static std::vector<int> run_once(StreamGraph& g, Status* node_error = nullptr) {
+    BaseContext ctx;
+    BthreadExecutor executor;
+    assert(executor.run(g, ctx).ok());
+    if (node_error) {
+        *node_error = ctx.node_error();
+    }
+    std::vector<int> values;
+    int value = 0;
+    auto& out = ctx.get_output<Stream<int>>("doubler/out");
+    while (out.read(value).ok()) {
+        values.push_back(value);
+    }
+    return values;
+}
+
+void test_concurrent() {
+    StreamGraph g;
+    auto* numbers = g.add_node<Numbers>("numbers");
+    auto* doubler = g.add_node<Doubler>("doubler");
+    numbers->configure({{"start", 10}});
+    doubler->configure({{"workers", 1}, {"max_batch", 64}});
+    g.add_edge(numbers->out, doubler->in);
+    g.mark_sink(doubler->out);
+    assert(g.finalize().ok());
+
+    // 16 个请求同时执行，元素都交给同一个 worker
+    std::vector<std::thread> threads;
+    std::atomic<int> ok{0};
+    for (int i = 0; i < 16; i++) {
+        threads.emplace_back([&] {
+            // 每个请求拿到自己的输出，顺序不变
+            if (run_once(g) == std::vector<int>({20, 22, 24, 26})) {
+                ok++;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    printf("[ ] 64 elements in %d batches, max batch %d\n", doubler->batches_.load(), doubler->max_batch_.load());
+    assert(ok == 16);
+    // 跨请求攒批
+    assert(doubler->batches_ < 64 && doubler->max_batch_ > 4);
+}
+
+void test_error() {
+    StreamGraph g;
+    auto* numbers = g.add_node<Numbers>("numbers");
+    auto* doubler = g.add_node<Doubler>("doubler");
+    numbers->configure({{"start", -1}});
+    doubler->configure({{"workers", 2}, {"max_batch", 2}});
+    g.add_edge(numbers->out, doubler->in);
+    g.mark_sink(doubler->out);
+
+    Status status;
+    std::vector<int> values = run_once(g, &status);
+    printf("[ ] error %s\n", status.error_cstr());
+    assert(!status.ok());
+    // 失败的元素没有输出，其它元素照常输出
+    assert(values == std::vector<int>({0, 2, 4}));
+    assert(doubler->actor_options().workers == 2);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_concurrent();
+    test_error();
+    printf("[OK] test_actor\n");
+    return 0;
+}
@@ -59,7 +59,7 @@ int main(int argc, char* argv[])
     BingNode* bing = g.add_node<BingNode>("bing_node");
     SinkerNode* sinker = g.add_node<SinkerNode>("sinker");
 
-    bing->init(option);
+    bing->configure(option);
 // 
     // 
 
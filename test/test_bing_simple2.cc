@@ -61,7 +61,7 @@ int main(int argc, char* argv[])
     BingNode* bing = g.add_node<BingNode>("bing_node");
     SinkerNode* sinker = g.add_node<SinkerNode>("sinker");
 
-    bing->init(option);
+    bing->configure(option);
 
     g.add_edge(source->src, bing->bing_requests);
     g.add_edge(bing->bing_responses, sinker->result);
@@ -0,0 +1,154 @@
+#include "include/stream-dag.h"
+#include "include/coalesce.h"
+#include "include/sse.h"
+#include "source.h"
+#include "safety.h"
+#include "llm_model.h"
+#include "output.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+// 按配置写一串字符串
+//   delay_ms: 第一个元素之前等待, hold_ms: 写完之后等多久才结束（half_close）
+class Feeder : public BaseNode {
+public:
+    Status run(Stream<std::string>& out) {
+        bthread_usleep(option().value("delay_ms", 0) * 1000);
+        for (const auto& item : option().value("items", json::array())) {
+            out.append(item.get<std::string>());
+        }
+        bthread_usleep(option().value("hold_ms", 0) * 1000);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<std::string>),
+    );
+};
+REGISTER_CLASS(Feeder);
+
+using StringCoalesce = CoalesceNode<std::string>;
+REGISTER_CLASS(StringCoalesce);
+
+struct Chunk {
+    std::string text;
+    int64_t at_ms;
+};
+
+static std::vector<Chunk> g_chunks;
+static int g_probe_code = 0;
+
+// 记录每次合并输出和距离开始的时间
+class Collector : public BaseNode {
+public:
+    Status run(Stream<std::string>& in) {
+        int64_t start = butil::gettimeofday_us();
+        if (option().value("probe", false)) {
+            std::string value;
+            g_probe_code = in.read_until(value, start + 10000).error_code();
+        }
+        std::string value;
+        while (in.read(value).ok()) {
+            g_chunks.push_back({value, (butil::gettimeofday_us() - start) / 1000});
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<std::string>),
+    );
+};
+REGISTER_CLASS(Collector);
+
+void run_case(const char* name, const json& feeder_opt, const json& coalesce_opt, const json& collector_opt = json::object()) {
+    g_chunks.clear();
+    StreamGraph g;
+    Feeder* feeder = g.add_node<Feeder>("feeder");
+    StringCoalesce* coalesce = g.add_node<StringCoalesce>("coalesce");
+    Collector* collector = g.add_node<Collector>("collector");
+    feeder->configure(feeder_opt);
+    coalesce->configure(coalesce_opt);
+    collector->configure(collector_opt);
+    g.add_edge(feeder->out, coalesce->in);
+    g.add_edge(coalesce->out, collector->in);
+
+    BthreadExecutor executor;
+    BaseContext ctx;
+    Status status = executor.run(g, ctx);
+    assert(status.ok());
+    for (auto& chunk : g_chunks) {
+        printf("[ ] %s \"%s\" at %ldms\n", name, chunk.text.c_str(), chunk.at_ms);
+    }
+}
+
+// 攒够 max_items 个立即输出，剩下的在上游结束时输出，不等 max_delay
+void test_max_items() {
+    run_case("max_items",
+        {{"items", {"a", "b", "c", "d", "e"}}, {"hold_ms", 200}},
+        {{"max_items", 2}, {"max_delay_ms", 1000}});
+    assert(g_chunks.size() == 3);
+    assert(g_chunks[0].text == "ab" && g_chunks[0].at_ms < 100);
+    assert(g_chunks[1].text == "cd" && g_chunks[1].at_ms < 100);
+    assert(g_chunks[2].text == "e" && g_chunks[2].at_ms >= 150 && g_chunks[2].at_ms < 800);
+}
+
+// 字节数达到 max_bytes 立即输出，超出的部分不拆开
+void test_max_bytes() {
+    run_case("max_bytes",
+        {{"items", {"xxx", "yyy", "zz", "w"}}, {"hold_ms", 200}},
+        {{"max_bytes", 5}, {"max_delay_ms", 1000}});
+    assert(g_chunks.size() == 2);
+    assert(g_chunks[0].text == "xxxyyy" && g_chunks[0].at_ms < 100);
+    assert(g_chunks[1].text == "zzw" && g_chunks[1].at_ms >= 150 && g_chunks[1].at_ms < 800);
+}
+
+// 上游一直不结束，第一个元素之后 max_delay 输出. 读超时返回 3
+void test_max_delay() {
+    run_case("max_delay",
+        {{"items", {"a", "b"}}, {"delay_ms", 50}, {"hold_ms", 400}},
+        {{"max_delay_ms", 50}},
+        {{"probe", true}});
+    assert(g_probe_code == 3);
+    assert(g_chunks.size() == 1);
+    assert(g_chunks[0].text == "ab" && g_chunks[0].at_ms >= 90 && g_chunks[0].at_ms < 300);
+}
+
+// 上游 half_close 时缓存的立即输出
+void test_half_close() {
+    run_case("half_close",
+        {{"items", {"a", "b", "c"}}},
+        {{"max_delay_ms", 1000}});
+    assert(g_chunks.size() == 1);
+    assert(g_chunks[0].text == "abc" && g_chunks[0].at_ms < 300);
+}
+
+void test_traits() {
+    LLMToken token{"你", 1, false};
+    coalesce_traits<LLMToken>::merge(token, LLMToken{"好", 2, true});
+    assert(token.text == "你好" && token.index == 2 && token.finished);
+    assert(coalesce_traits<LLMToken>::size(token) == std::string("你好").size());
+    // finished 合并后不会被后面的元素清掉
+    coalesce_traits<LLMToken>::merge(token, LLMToken{"!", 3, false});
+    assert(token.text == "你好!" && token.index == 3 && token.finished);
+
+    Response response("hello");
+    coalesce_traits<Response>::merge(response, Response(" world"));
+    assert(response.data_ == "hello world");
+    assert(coalesce_traits<Response>::size(response) == 11);
+    printf("[ ] test_traits ok\n");
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    test_traits();
+    test_max_items();
+    test_max_bytes();
+    test_max_delay();
+    test_half_close();
+    printf("[OK] test_coalesce\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "include/stream-dag.h"
+#include "bthread/countdown_event.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+class Counter : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 1; i <= 3; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Counter);
+
+class Summer : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& sum) {
+        int value = 0, total = 0;
+        while (in.read(value).ok()) {
+            total += value;
+        }
+        sum.append(total);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(sum, Stream<int>),
+    );
+};
+REGISTER_CLASS(Summer);
+
+static bthread::CountdownEvent hang_release(1);
+
+// 等到测试放行才结束，用来让执行器超时
+class Hang : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        hang_release.wait();
+        out.append(1);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Hang);
+
+void test_reuse() {
+    StreamGraph g;
+    g.add_node<Counter>("counter");
+    g.add_node<Summer>("summer");
+    g.add_edge("counter/out", "summer/in");
+
+    ContextPool pool(g);
+    BaseContext* first = nullptr;
+    for (int round = 0; round < 3; round++) {
+        auto ctx = pool.acquire();
+        if (round == 0) {
+            first = ctx.get();
+        } else {
+            // 归还的 ctx 给下一个请求
+            assert(ctx.get() == first);
+        }
+        // 上一个请求的状态已经清空
+        assert(ctx->prepared_for(round == 0 ? nullptr : &g));
+        assert(ctx->running_cnt.load() == 0 && ctx->node_error().ok() && !ctx->is_cancelled());
+        BthreadExecutor executor;
+        assert(executor.run(g, *ctx).ok());
+        // 流重置过，不会读到上一个请求的数据
+        int sum = 0;
+        assert(ctx->get_output<Stream<int>>("summer/sum").read(sum).ok());
+        assert(sum == 6);
+        ctx->cancel();
+    }
+    printf("[ ] reuse %s\n", pool.to_json().dump().c_str());
+    assert(pool.to_json()["created"] == 1);
+    assert(pool.to_json()["reused"] == 2);
+    assert(pool.idle() == 1 && pool.in_use() == 0);
+}
+
+void test_concurrent() {
+    StreamGraph g;
+    g.add_node<Counter>("counter");
+    g.add_node<Summer>("summer");
+    g.add_edge("counter/out", "summer/in");
+
+    // 同时借出的 ctx 各不相同
+    ContextPool pool(g);
+    {
+        auto a = pool.acquire();
+        auto b = pool.acquire();
+        assert(a.get() != b.get());
+        assert(pool.in_use() == 2);
+    }
+    assert(pool.idle() == 2 && pool.in_use() == 0);
+}
+
+void test_timeout_release() {
+    StreamGraph g;
+    g.add_node<Hang>("hang");
+
+    // 超时返回时节点还在运行，ctx 不复用. 归还后由节点 bthread 在退出时释放
+    ContextPool pool(g);
+    bthread::CountdownEvent freed(1);
+    {
+        auto ctx = pool.acquire();
+        BthreadExecutor executor;
+        executor.set_timeout_ms(10);
+        assert(!executor.run(g, *ctx).ok());
+        assert(ctx->timed_out());
+        ctx->keep_alive(std::shared_ptr<void>(nullptr, [&freed](void*) { freed.signal(); }));
+    }
+    printf("[ ] timeout %s\n", pool.to_json().dump().c_str());
+    assert(pool.to_json()["timed_out"] == 1);
+    assert(pool.idle() == 0 && pool.in_use() == 0);
+    hang_release.signal();
+    freed.wait();
+
+    // 之后的请求用新的 ctx
+    auto ctx = pool.acquire();
+    assert(!ctx->timed_out());
+    assert(pool.to_json()["created"] == 2);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_reuse();
+    test_concurrent();
+    test_timeout_release();
+    printf("[OK] test_context_pool\n");
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "include/stream-dag.h"
+#include "include/graph_binary.h"
+#include "include/context_pool.h"
+#include "bthread/countdown_event.h"
+#include <gflags/gflags.h>
+#include <cassert>
+#include <thread>
+
+using namespace stream_dag;
+
+class Counter : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 1; i <= 3; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Counter);
+
+class Joiner : public BaseNode {
+public:
+    Status run(Stream<std::string>& in, Stream<std::string>& text) {
+        std::string value, result;
+        while (in.read(value).ok()) {
+            result += value + ";";
+        }
+        text.append(result);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<std::string>),
+        OUTPUT(text, Stream<std::string>),
+    );
+};
+REGISTER_CLASS(Joiner);
+
+static bthread::CountdownEvent hanger_appended(1);
+static bthread::CountdownEvent hanger_release(1);
+static bthread::CountdownEvent joiner_done(1);
+
+// 写一个元素后一直等到测试放行，不理会取消
+class Hanger : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        out.append(7);
+        hanger_appended.signal();
+        hanger_release.wait();
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Hanger);
+
+// 和 Joiner 一样，输出后通知测试
+class SignalJoiner : public BaseNode {
+public:
+    Status run(Stream<std::string>& in, Stream<std::string>& text) {
+        std::string value, result;
+        while (in.read(value).ok()) {
+            result += value + ";";
+        }
+        text.append(result);
+        joiner_done.signal();
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<std::string>),
+        OUTPUT(text, Stream<std::string>),
+    );
+};
+REGISTER_CLASS(SignalJoiner);
+
+REGISTER_CONVERTOR(IntToText, int, std::string, [](const int& value) {
+    return "#" + std::to_string(value);
+});
+
+static std::string run_once(StreamGraph& g, BaseContext& ctx) {
+    BthreadExecutor executor;
+    Status status = executor.run(g, ctx);
+    assert(status.ok());
+    std::string text;
+    assert(ctx.get_output<Stream<std::string>>("joiner/text").read(text).ok());
+    return text;
+}
+
+void test_code() {
+    StreamGraph g;
+    g.set_name("test_convertor");
+    auto* counter = g.add_node<Counter>("counter");
+    auto* joiner = g.add_node<Joiner>("joiner");
+    g.add_edge(counter->out, joiner->in, [](const int& value) { return std::to_string(value * 10); });
+    g.mark_sink(joiner->text);
+    assert(g.finalize().ok());
+
+    // 复用 ctx 时下游流跟着上游一起重置
+    ContextPool pool(g);
+    for (int round = 0; round < 3; round++) {
+        auto ctx = pool.acquire();
+        std::string text = run_once(g, *ctx);
+        printf("[ ] round %d %s\n", round, text.c_str());
+        assert(text == "10;20;30;");
+    }
+    // 代码里创建的转换函数没有名字，dump 不输出
+    assert(!g.to_json()["edges"][0].contains("convertor"));
+}
+
+static json make_graph() {
+    return json::parse(R"({
+        "name": "convertor_test",
+        "nodes": [
+            {"name": "counter", "type": ")" + std::string(typeid(Counter).name()) + R"("},
+            {"name": "joiner", "type": ")" + std::string(typeid(Joiner).name()) + R"("}
+        ],
+        "edges": [{"from": "counter/out", "to": "joiner/in", "convertor": "IntToText"}],
+        "sinks": ["joiner/text"]
+    })");
+}
+
+void test_json() {
+    StreamGraph g;
+    assert(g.load_json(make_graph()).ok());
+    assert(g.to_json()["edges"][0]["convertor"] == "IntToText");
+    BaseContext ctx;
+    std::string text = run_once(g, ctx);
+    printf("[ ] json %s\n", text.c_str());
+    assert(text == "#1;#2;#3;");
+
+    json unknown = make_graph();
+    unknown["edges"][0]["convertor"] = "NoSuchConvertor";
+    StreamGraph bad;
+    assert(!bad.load_json(unknown).ok());
+}
+
+void test_binary() {
+    std::string binary;
+    assert(GraphBinary::from_json(make_graph(), &binary).ok());
+    json back;
+    assert(GraphBinary::to_json(binary.data(), binary.size(), &back).ok());
+    assert(back["edges"] == make_graph()["edges"]);
+
+    StreamGraph g;
+    assert(GraphBinary::load(g, binary.data(), binary.size()).ok());
+    BaseContext ctx;
+    assert(run_once(g, ctx) == "#1;#2;#3;");
+}
+
+void test_reject() {
+    // 转换函数的输入类型和上游流不一致
+    StreamGraph g;
+    g.add_node<Counter>("counter");
+    g.add_node<Joiner>("joiner");
+    g.add_edge("counter/out", "joiner/in", std::make_shared<Convertor<double, std::string>>(
+        [](const double& value) { return std::to_string(value); }));
+    Status status = g.finalize();
+    printf("[ ] reject %s\n", status.error_cstr());
+    assert(!status.ok());
+}
+
+void test_cancel() {
+    // 读端阻塞在转换边的下游流上，取消时关闭上游流也要能唤醒它
+    StreamGraph g;
+    auto* hanger = g.add_node<Hanger>("hanger");
+    auto* joiner = g.add_node<SignalJoiner>("joiner");
+    g.add_edge(hanger->out, joiner->in, [](const int& value) { return std::to_string(value); });
+    g.mark_sink(joiner->text);
+    assert(g.finalize().ok());
+
+    BaseContext ctx;
+    Status run_status;
+    std::thread runner([&] {
+        BthreadExecutor executor;
+        run_status = executor.run(g, ctx);
+    });
+    // hanger 写完之后通过卡死检测取消. 阈值为 0 时每个执行中的请求都算卡死
+    hanger_appended.wait();
+    StallOptions options;
+    options.threshold_ms = 0;
+    options.cancel = true;
+    assert(StallDetector::check(options) == 1);
+
+    // hanger 还没结束，joiner 已经读到 closed 并输出
+    joiner_done.wait();
+    std::string text;
+    Status status = ctx.get_output<Stream<std::string>>("joiner/text").read(text);
+    printf("[ ] cancel %s\n", text.c_str());
+    assert(status.ok() && text == "7;");
+    hanger_release.signal();
+    runner.join();
+    assert(run_status.ok() && ctx.is_cancelled());
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    test_code();
+    MetricsRegistry::enable(false);
+    test_json();
+    test_binary();
+    test_reject();
+    test_cancel();
+    printf("[OK] test_convertor\n");
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include "include/stream-dag.h"
+#include "include/fan_out.h"
+#include <gflags/gflags.h>
+#include <cassert>
+#include <algorithm>
+
+using namespace stream_dag;
+
+// 子图: square -> label. 输入越小睡得越久，完成顺序和输入顺序相反
+class Square : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& out) {
+        int value = 0;
+        if (!in.read(value).ok()) {
+            return Status(-1, "no input");
+        }
+        if (value < 0) {
+            return Status(-1, "negative input");
+        }
+        int now = ++running_;
+        int peak = peak_.load();
+        while (now > peak && !peak_.compare_exchange_weak(peak, now)) {}
+        bthread_usleep((10 - value) * 2000);
+        running_--;
+        out.append(value * value);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(out, Stream<int>),
+    );
+
+    static std::atomic<int> running_, peak_;
+};
+std::atomic<int> Square::running_{0}, Square::peak_{0};
+REGISTER_CLASS(Square);
+
+class Label : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<std::string>& out) {
+        int value = 0;
+        while (in.read(value).ok()) {
+            out.append(std::to_string(value));
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(out, Stream<std::string>),
+    );
+};
+REGISTER_CLASS(Label);
+
+// 父图里展开子图的节点
+class Expand : public BaseNode {
+public:
+    Status run(Stream<int>& numbers, Stream<std::string>& labels) {
+        return fan_out_->run(numbers, labels);
+    }
+
+    DECLARE_PARAMS (
+        INPUT(numbers, Stream<int>),
+        OUTPUT(labels, Stream<std::string>),
+    );
+
+    static FanOut<int, std::string>* fan_out_;
+};
+FanOut<int, std::string>* Expand::fan_out_ = nullptr;
+REGISTER_CLASS(Expand);
+
+class Numbers : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 1; i <= 6; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Numbers);
+
+static void build_subgraph(StreamGraph& sub) {
+    sub.set_name("test_fan_out_sub");
+    auto* square = sub.add_node<Square>("square");
+    auto* label = sub.add_node<Label>("label");
+    sub.add_edge(square->out, label->in);
+}
+
+static std::vector<std::string> drain(Stream<std::string>& stream) {
+    stream.half_close();
+    std::vector<std::string> result;
+    std::string value;
+    while (stream.read(value).ok()) {
+        result.push_back(value);
+    }
+    return result;
+}
+
+void test_ordered() {
+    StreamGraph sub;
+    build_subgraph(sub);
+    FanOut<int, std::string> fan_out(sub, "square/in", "label/out", {2, true});
+    Expand::fan_out_ = &fan_out;
+
+    StreamGraph g;
+    auto* numbers = g.add_node<Numbers>("numbers");
+    auto* expand = g.add_node<Expand>("expand");
+    g.add_edge(numbers->out, expand->numbers);
+    g.mark_sink(expand->labels);
+    assert(g.finalize().ok());
+
+    for (int round = 0; round < 2; round++) {
+        Square::peak_ = 0;
+        BaseContext ctx;
+        BthreadExecutor executor;
+        assert(executor.run(g, ctx).ok());
+        assert(ctx.node_error().ok());
+        std::vector<std::string> labels;
+        std::string value;
+        auto& out = ctx.get_output<Stream<std::string>>("expand/labels");
+        while (out.read(value).ok()) {
+            labels.push_back(value);
+        }
+        printf("[ ] ordered peak %d:", Square::peak_.load());
+        for (auto& label : labels) {
+            printf(" %s", label.c_str());
+        }
+        printf("\n");
+        assert(labels == std::vector<std::string>({"1", "4", "9", "16", "25", "36"}));
+        assert(Square::peak_ <= 2);
+    }
+}
+
+void test_unordered() {
+    StreamGraph sub;
+    build_subgraph(sub);
+    FanOut<int, std::string> fan_out(sub, "square/in", "label/out", {8, false});
+    BaseContext ctx;
+    Stream<std::string> out(ctx, "test/out", "string");
+    Status status = fan_out.run(std::vector<int>{1, 2, 3, 4}, out);
+    assert(status.ok());
+    std::vector<std::string> labels = drain(out);
+    printf("[ ] unordered %s %s %s %s\n", labels[0].c_str(), labels[1].c_str(), labels[2].c_str(), labels[3].c_str());
+    // 输入大的先完成
+    assert(labels[0] == "16");
+    std::sort(labels.begin(), labels.end());
+    assert(labels == std::vector<std::string>({"1", "16", "4", "9"}));
+}
+
+void test_error() {
+    StreamGraph sub;
+    build_subgraph(sub);
+    FanOut<int, std::string> fan_out(sub, "square/in", "label/out");
+    BaseContext ctx;
+    Stream<std::string> out(ctx, "test/out", "string");
+    Status status = fan_out.run(std::vector<int>{3, -1, 2}, out);
+    printf("[ ] error %s\n", status.error_cstr());
+    assert(!status.ok());
+    // 失败的份没有输出，其它份照常输出
+    assert(drain(out) == std::vector<std::string>({"9", "4"}));
+
+    // 调用方取消后不再启动新的份
+    BaseContext cancelled;
+    cancelled.cancel();
+    Stream<std::string> none(cancelled, "test/none", "string");
+    assert(fan_out.run(std::vector<int>{1, 2}, none).ok());
+    assert(drain(none).empty());
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_ordered();
+    test_unordered();
+    test_error();
+    printf("[OK] test_fan_out\n");
+    return 0;
+}
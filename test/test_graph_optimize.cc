@@ -0,0 +1,194 @@
+#include "include/stream-dag.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+class Counter : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 0; i < 5; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Counter);
+
+// 同一份数据写两路
+class Split : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& left, Stream<int>& right) {
+        int value = 0;
+        while (in.read(value).ok()) {
+            left.append(value);
+            right.append(value);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(left, Stream<int>),
+        OUTPUT(right, Stream<int>),
+    );
+};
+REGISTER_CLASS(Split);
+
+class Summer : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& sum, Stream<std::string>& debug) {
+        int value = 0, total = 0;
+        while (in.read(value).ok()) {
+            total += value;
+            debug.append(std::to_string(value));
+        }
+        sum.append(total);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(sum, Stream<int>),
+        OUTPUT(debug, Stream<std::string>),
+    );
+};
+REGISTER_CLASS(Summer);
+
+static void build(StreamGraph& g) {
+    g.add_node<Counter>("counter");
+    g.add_node<Split>("split");
+    g.add_node<Summer>("summer");
+    g.add_node<Summer>("unused");
+    g.add_edge("counter/out", "split/in");
+    g.add_edge("split/left", "summer/in");
+    g.add_edge("split/right", "unused/in");
+}
+
+void test_optimize() {
+    StreamGraph g;
+    g.set_name("test_graph_optimize");
+    build(g);
+    g.mark_sink("summer/sum");
+    Status status = g.finalize();
+    assert(status.ok());
+    printf("[ ] report %s\n", g.optimize_report().dump().c_str());
+
+    // unused 到不了 sink，被删掉. split/right 和 summer/debug 没有下游
+    assert(g.list_node().size() == 3);
+    assert(g.list_edge().count("split/right") == 0);
+    auto& removed = g.optimize_report()["removed_nodes"];
+    assert(removed.size() == 1 && removed[0] == "unused");
+    assert(g.optimize_report()["discarded_outputs"].size() == 2);
+    auto& plan = g.exec_plan();
+    assert(plan[1].discard_outputs.size() == 2 && !plan[1].discard_outputs[0] && plan[1].discard_outputs[1]);
+    assert(g.finalize().ok());
+
+    for (int round = 0; round < 2; round++) {
+        BaseContext ctx;
+        BthreadExecutor executor;
+        assert(executor.run(g, ctx).ok());
+        int sum = 0;
+        assert(ctx.get_output<Stream<int>>("summer/sum").read(sum).ok());
+        assert(sum == 10);
+        // 丢弃的输出不缓存数据
+        std::string text;
+        assert(!ctx.get_output<Stream<std::string>>("summer/debug").read(text).ok());
+        int value = 0;
+        assert(!ctx.get_output<Stream<int>>("split/right").read(value).ok());
+    }
+}
+
+void test_no_sink() {
+    // 没有 sink 时只做校验，执行后所有输出都能读
+    StreamGraph g;
+    build(g);
+    assert(g.finalize().ok());
+    assert(g.list_node().size() == 4);
+    assert(g.optimize_report()["discarded_outputs"].empty());
+
+    BaseContext ctx;
+    BthreadExecutor executor;
+    assert(executor.run(g, ctx).ok());
+    int sum = 0;
+    assert(ctx.get_output<Stream<int>>("unused/sum").read(sum).ok());
+    assert(sum == 10);
+}
+
+static void expect_error(StreamGraph& g) {
+    Status status = g.finalize();
+    printf("[ ] reject %s\n", status.error_cstr());
+    assert(!status.ok());
+}
+
+void test_reject() {
+    {
+        // 类型不一致
+        StreamGraph g;
+        build(g);
+        g.add_node<Summer>("typed");
+        g.add_edge("summer/debug", "typed/in");
+        expect_error(g);
+        // 校验失败时图不变
+        assert(g.list_node().size() == 5);
+    }
+    {
+        // 输入没有连
+        StreamGraph g;
+        build(g);
+        g.add_node<Summer>("alone");
+        expect_error(g);
+    }
+    {
+        // 一个输入连了两条边
+        StreamGraph g;
+        build(g);
+        g.add_edge("summer/sum", "unused/in");
+        expect_error(g);
+    }
+    {
+        // 边的终点不是输入
+        StreamGraph g;
+        build(g);
+        g.add_edge("summer/sum", "unused/sum");
+        expect_error(g);
+    }
+    {
+        // sink 不存在
+        StreamGraph g;
+        build(g);
+        g.mark_sink("summer/total");
+        expect_error(g);
+    }
+    {
+        // 同步依赖和边成环
+        StreamGraph g;
+        build(g);
+        std::vector<std::string> deps = {"summer"};
+        g.add_node_dep("counter", deps, "true");
+        expect_error(g);
+    }
+    {
+        // 执行过的图不能再 finalize
+        StreamGraph g;
+        build(g);
+        BaseContext ctx;
+        BthreadExecutor executor;
+        assert(executor.run(g, ctx).ok());
+        expect_error(g);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_optimize();
+    test_no_sink();
+    test_reject();
+    printf("[OK] test_graph_optimize\n");
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "include/stream-dag.h"
+#include "include/graph_registry.h"
+#include <gflags/gflags.h>
+#include <cassert>
+#include <thread>
+
+using namespace stream_dag;
+
+class Counter : public BaseNode {
+public:
+    Status init(json& option) {
+        count_ = option.value("count", 0);
+        return Status::OK();
+    }
+
+    Status run(Stream<int>& out) {
+        for (int i = 1; i <= count_; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+
+private:
+    int count_ = 0;
+};
+REGISTER_CLASS(Counter);
+
+class Summer : public BaseNode {
+public:
+    Status init(json& option) {
+        inits_++;
+        return Status::OK();
+    }
+
+    Status run(Stream<int>& in, Stream<int>& sum) {
+        int value = 0, total = 0;
+        while (in.read(value).ok()) {
+            total += value;
+        }
+        sum.append(total);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(sum, Stream<int>),
+    );
+
+    static std::atomic<int> inits_;
+};
+std::atomic<int> Summer::inits_{0};
+REGISTER_CLASS(Summer);
+
+static json make_graph(int count) {
+    return json::parse(R"({
+        "nodes": [
+            {"name": "counter", "type": ")" + std::string(typeid(Counter).name()) + R"(", "option": {"count": )" + std::to_string(count) + R"(}},
+            {"name": "summer", "type": ")" + std::string(typeid(Summer).name()) + R"("}
+        ],
+        "edges": [{"from": "counter/out", "to": "summer/in"}],
+        "sinks": ["summer/sum"]
+    })");
+}
+
+static int run_once(GraphVersion& version) {
+    BthreadExecutor executor;
+    auto ctx = version.pool().acquire();
+    Status status = executor.run(version.graph(), *ctx);
+    assert(status.ok());
+    int sum = 0;
+    assert(ctx->get_output<Stream<int>>("summer/sum").read(sum).ok());
+    return sum;
+}
+
+void test_publish() {
+    GraphRegistry registry;
+    assert(registry.get("sum") == nullptr);
+    assert(registry.publish("sum", make_graph(3)).ok());
+    auto v1 = registry.get("sum");
+    assert(v1->version() == 1);
+    assert(run_once(*v1) == 6);
+
+    // 只改了 counter，summer 共用
+    assert(registry.publish("sum", make_graph(4)).ok());
+    auto v2 = registry.get("sum");
+    assert(v2->version() == 2 && v2->reused_nodes() == 1);
+    assert(v2->graph().share_node("summer") == v1->graph().share_node("summer"));
+    assert(v2->graph().share_node("counter") != v1->graph().share_node("counter"));
+    assert(Summer::inits_ == 1);
+
+    // 旧版本上正在执行的请求不受影响，放手后释放
+    assert(run_once(*v1) == 6);
+    assert(run_once(*v2) == 10);
+    std::weak_ptr<GraphVersion> old = v1;
+    v1.reset();
+    assert(old.expired());
+
+    // 发布失败时保留当前版本
+    json bad = make_graph(5);
+    bad["edges"] = json::array();
+    Status status = registry.publish("sum", bad);
+    printf("[ ] reject %s\n", status.error_cstr());
+    assert(!status.ok());
+    assert(registry.get("sum")->version() == 2);
+    printf("[ ] %s\n", registry.dump().dump().c_str());
+}
+
+// 默认的 finalize 会删掉到不了 sink 的节点，关掉优化后保留
+void test_options() {
+    json definition = make_graph(2);
+    definition["nodes"].push_back({{"name", "spare"}, {"type", typeid(Counter).name()}, {"option", {{"count", 1}}}});
+    GraphRegistry registry;
+    assert(registry.publish("sum", definition).ok());
+    assert(registry.get("sum")->graph().list_node().size() == 2);
+
+    GraphOptimizeOptions options;
+    options.eliminate_dead_nodes = false;
+    options.discard_unused_outputs = false;
+    assert(registry.publish("sum", definition, options).ok());
+    auto version = registry.get("sum");
+    assert(version->graph().list_node().size() == 3);
+    BthreadExecutor executor;
+    auto ctx = version->pool().acquire();
+    assert(executor.run(version->graph(), *ctx).ok());
+    int value = 0;
+    assert(ctx->get_output<Stream<int>>("spare/out").read(value).ok() && value == 1);
+}
+
+void test_concurrent() {
+    GraphRegistry registry;
+    assert(registry.publish("sum", make_graph(1)).ok());
+    std::atomic<bool> stop{false};
+    std::atomic<int> requests{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 4; i++) {
+        workers.emplace_back([&] {
+            while (!stop.load()) {
+                auto version = registry.get("sum");
+                // 第 n 个版本 count 为 n
+                int count = version->version();
+                assert(run_once(*version) == count * (count + 1) / 2);
+                requests++;
+            }
+        });
+    }
+    for (int count = 2; count <= 20; count++) {
+        assert(registry.publish("sum", make_graph(count)).ok());
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    printf("[ ] %d requests across 20 versions\n", requests.load());
+    assert(registry.get("sum")->version() == 20);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_publish();
+    test_options();
+    test_concurrent();
+    printf("[OK] test_graph_registry\n");
+    return 0;
+}
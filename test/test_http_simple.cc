@@ -68,7 +68,7 @@ int main(int argc, char* argv[])
     HttpNode* http = g.add_node<HttpNode>("http_node");
     SinkerNode* sinker = g.add_node<SinkerNode>("sinker");
 
-    http->init(option);
+    http->configure(option);
 // bing_search.search(query, result)
     // 
 
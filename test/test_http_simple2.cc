@@ -30,13 +30,13 @@ REGISTER_CLASS(SourceNode);
 
 class SinkerNode : public BaseNode {
 public:
-    Status run(Stream<HttpResponse>& result, Stream<std::string>& stream_body) {
+    Status run(Stream<HttpResponse>& result, ByteStream& stream_body) {
         
         HttpResponse res;
         result.read(res);
 
         while(stream_body.readable()) {
-            std::string body;
+            butil::IOBuf body;
             stream_body.read(body);
 
             std::cout << body << std::endl;
@@ -47,7 +47,7 @@ public:
 
     DECLARE_PARAMS (
         INPUT(result, Stream<HttpResponse>),
-        INPUT(stream_body, Stream<std::string>),
+        INPUT(stream_body, ByteStream),
     );
 };
 
@@ -69,7 +69,7 @@ int main(int argc, char* argv[])
     HttpNode* http = g.add_node<HttpNode>("http_node");
     SinkerNode* sinker = g.add_node<SinkerNode>("sinker");
 
-    http->init(option);
+    http->configure(option);
 
     g.add_edge(source->src, http->request_);
     g.add_edge(http->response_, sinker->result);
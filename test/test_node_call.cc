@@ -0,0 +1,190 @@
+#include "include/stream-dag.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+// 被调用方: 把输入的数都加上 offset，读到输入关闭为止
+class Adder : public BaseNode {
+public:
+    Status init(json& option) {
+        offset_ = option.value("offset", 0);
+        inits_++;
+        return Status::OK();
+    }
+
+    Status run(Stream<int>& in, Stream<int>& out) {
+        int running = running_.fetch_add(1) + 1;
+        int peak = max_running_.load();
+        while (running > peak && !max_running_.compare_exchange_weak(peak, running)) {
+        }
+        Status status = add(in, out);
+        running_--;
+        return status;
+    }
+
+    Status add(Stream<int>& in, Stream<int>& out) {
+        int value = 0;
+        while (in.read(value).ok()) {
+            if (value < 0) {
+                return Status(-1, "negative input");
+            }
+            bthread_usleep(5000);
+            out.append(value + offset_);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(out, Stream<int>),
+    );
+
+    static std::atomic<int> inits_;
+    // 同时在执行的调用数和它的最大值
+    static std::atomic<int> running_;
+    static std::atomic<int> max_running_;
+
+private:
+    int offset_ = 0;
+};
+std::atomic<int> Adder::inits_{0};
+std::atomic<int> Adder::running_{0};
+std::atomic<int> Adder::max_running_{0};
+REGISTER_CLASS(Adder);
+
+class Caller : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& out, Node<Adder> adder) {
+        std::vector<int> values;
+        int value = 0;
+        while (in.read(value).ok()) {
+            values.push_back(value);
+        }
+        // 同步调用
+        int first = 0;
+        Status status = adder.Call(values[0], first);
+        assert(status.ok());
+        out.append(first);
+
+        // 异步调用，同时发出再按顺序 join
+        std::vector<int> results(values.size());
+        std::vector<CallHandle<Adder, int, int>> calls;
+        for (size_t i = 1; i < values.size(); i++) {
+            calls.push_back(adder.CallAsync(values[i], results[i]));
+        }
+        for (size_t i = 1; i < values.size(); i++) {
+            status = calls[i - 1].join();
+            if (!status.ok()) {
+                return status;
+            }
+            out.append(results[i]);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(out, Stream<int>),
+        DEPEND(adder, Adder),
+    );
+};
+REGISTER_CLASS(Caller);
+
+class Numbers : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 0; i < 8; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Numbers);
+
+void test_graph() {
+    StreamGraph g;
+    auto* numbers = g.add_node<Numbers>("numbers");
+    auto* caller = g.add_node<Caller>("caller");
+    caller->configure({{"adder", {{"offset", 100}}}});
+    g.add_edge(numbers->out, caller->in);
+    g.mark_sink(caller->out);
+    assert(g.finalize().ok());
+
+    for (int round = 0; round < 3; round++) {
+        BaseContext ctx;
+        BthreadExecutor executor;
+        Adder::max_running_ = 0;
+        assert(executor.run(g, ctx).ok());
+        std::vector<int> values;
+        int value = 0;
+        auto& out = ctx.get_output<Stream<int>>("caller/out");
+        while (out.read(value).ok()) {
+            values.push_back(value);
+        }
+        printf("[ ] round %d max running %d\n", round, Adder::max_running_.load());
+        assert(values == std::vector<int>({100, 101, 102, 103, 104, 105, 106, 107}));
+        // 子节点的参数流在调用时的帧里，ctx 里没有它的输出流
+        bool created = true;
+        try {
+            ctx.get_output("caller/adder/out");
+        } catch (const std::out_of_range&) {
+            created = false;
+        }
+        assert(!created);
+        // 异步调用并行执行
+        assert(Adder::max_running_ > 1);
+    }
+    // 子节点实例在请求间共用，只 init 一次
+    assert(Adder::inits_ == 1);
+}
+
+void test_direct() {
+    Adder adder("adder", typeid(Adder).name());
+    BaseContext ctx;
+    Node<Adder> node(adder, ctx);
+
+    // 没有输出时不阻塞
+    int in = -1, out = 0;
+    Status status = node.Call(in, out);
+    printf("[ ] error %s\n", status.error_cstr());
+    assert(!status.ok() && out == 0);
+
+    // 不带参数时输入直接关闭
+    assert(node.Call().ok());
+
+    // 没 join 的句柄析构时等待执行结束
+    {
+        int a = 1, b = 0;
+        auto call = node.CallAsync(a, b);
+    }
+    int a = 2, b = 0;
+    auto call = node.CallAsync(a, b);
+    assert(call.join().ok() && b == 2);
+    assert(!call.join().ok());
+
+    // 一次写入多个元素时直接用帧
+    CallFrame<Adder> frame(adder, ctx);
+    frame.get<Adder::ports::in>().append(a);
+    frame.get<Adder::ports::in>().append(a);
+    frame.write();
+    assert(frame.run().ok());
+    int sum = 0, value = 0;
+    while (frame.get<Adder::ports::out>().read(value).ok()) {
+        sum += value;
+    }
+    assert(sum == 4);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_graph();
+    test_direct();
+    printf("[OK] test_node_call\n");
+    return 0;
+}
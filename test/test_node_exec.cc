@@ -0,0 +1,160 @@
+#include "include/stream-dag.h"
+#include "include/graph_binary.h"
+#include <gflags/gflags.h>
+#include <cassert>
+#include <thread>
+#include <unistd.h>
+
+using namespace stream_dag;
+
+class Source : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 1; i <= 5; i++) {
+            bthread_usleep(1000);
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Source);
+
+// 重计算的节点，记下在哪个线程上执行
+class Hog : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& out) {
+        thread_ = std::this_thread::get_id();
+        int value = 0;
+        while (in.read(value).ok()) {
+            volatile int64_t sum = 0;
+            for (int i = 0; i < 100000; i++) {
+                sum += i;
+            }
+            out.append(value * 10);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(out, Stream<int>),
+    );
+
+    std::thread::id thread_;
+};
+REGISTER_CLASS(Hog);
+
+// 阻塞在系统调用上的节点
+class Sleeper : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        usleep(20000);
+        out.append(1);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Sleeper);
+
+static std::vector<int> read_all(Stream<int>& stream) {
+    std::vector<int> values;
+    int value = 0;
+    while (stream.read(value).ok()) {
+        values.push_back(value);
+    }
+    return values;
+}
+
+void test_pool() {
+    // 只有一个线程，两个 cpu_bound 节点首尾相连也不会互相等死
+    NodeThreadPool::set_threads(kExecCpuBound, 1);
+    StreamGraph g;
+    // 下游先加入，先被调度
+    auto* hog2 = g.add_node<Hog>("hog2");
+    auto* hog1 = g.add_node<Hog>("hog1");
+    auto* source = g.add_node<Source>("source");
+    auto* sleeper = g.add_node<Sleeper>("sleeper");
+    hog2->set_exec(kExecCpuBound);
+    hog1->set_exec(kExecCpuBound);
+    sleeper->set_exec(kExecBlocking);
+    g.add_edge(source->out, hog1->in);
+    g.add_edge(hog1->out, hog2->in);
+    g.mark_sink(hog2->out);
+    g.mark_sink(sleeper->out);
+    assert(g.finalize().ok());
+
+    std::thread::id pool_thread;
+    for (int round = 0; round < 3; round++) {
+        BaseContext ctx;
+        BthreadExecutor executor;
+        assert(executor.run(g, ctx).ok());
+        assert(ctx.node_error().ok());
+        // 流跨过线程池照常工作
+        assert(read_all(ctx.get_output<Stream<int>>("hog2/out")) == std::vector<int>({100, 200, 300, 400, 500}));
+        assert(read_all(ctx.get_output<Stream<int>>("sleeper/out")) == std::vector<int>({1}));
+        // 都在 cpu_bound 池唯一的线程上执行
+        if (round == 0) {
+            pool_thread = hog1->thread_;
+        }
+        assert(hog1->thread_ == pool_thread && hog2->thread_ == pool_thread);
+    }
+    printf("[ ] %s\n", NodeThreadPool::of(kExecCpuBound)->inspect().dump().c_str());
+    assert(NodeThreadPool::of(kExecBthread) == nullptr);
+}
+
+static json make_graph(const std::string& exec) {
+    return json::parse(R"({
+        "nodes": [
+            {"name": "source", "type": ")" + std::string(typeid(Source).name()) + R"("},
+            {"name": "hog", "type": ")" + std::string(typeid(Hog).name()) + R"(", "exec": ")" + exec + R"("}
+        ],
+        "edges": [{"from": "source/out", "to": "hog/in"}],
+        "sinks": ["hog/out"]
+    })");
+}
+
+void test_load() {
+    StreamGraph g;
+    assert(g.load_json(make_graph("cpu_bound")).ok());
+    assert(g.share_node("hog")->exec() == kExecCpuBound);
+    assert(g.share_node("source")->exec() == kExecBthread);
+    assert(g.to_json()["nodes"][1]["exec"] == "cpu_bound");
+    assert(!g.to_json()["nodes"][0].contains("exec"));
+
+    // 执行方式变了的节点不和上一个版本共用
+    StreamGraph next;
+    assert(next.load_json(make_graph("blocking"), &g).ok());
+    assert(next.share_node("hog") != g.share_node("hog"));
+    assert(next.share_node("source") == g.share_node("source"));
+
+    StreamGraph bad;
+    Status status = bad.load_json(make_graph("gpu"));
+    printf("[ ] reject %s\n", status.error_cstr());
+    assert(!status.ok());
+
+    std::string binary;
+    assert(GraphBinary::from_json(make_graph("blocking"), &binary).ok());
+    json back;
+    assert(GraphBinary::to_json(binary.data(), binary.size(), &back).ok());
+    assert(back["nodes"][1]["exec"] == "blocking");
+    StreamGraph loaded;
+    assert(GraphBinary::load(loaded, binary.data(), binary.size()).ok());
+    assert(loaded.share_node("hog")->exec() == kExecBlocking);
+    assert(!GraphBinary::from_json(make_graph("gpu"), &binary).ok());
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_pool();
+    test_load();
+    printf("[OK] test_node_exec\n");
+    return 0;
+}
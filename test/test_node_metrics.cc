@@ -0,0 +1,82 @@
+#include "include/stream-dag.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+// 等 2ms 后输出 3 个元素
+class Producer : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        bthread_usleep(2000);
+        for (int i = 0; i < 3; i++) {
+            out.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Producer);
+
+// 只读一个元素，剩下的留在流里
+class TakeOne : public BaseNode {
+public:
+    Status run(Stream<int>& in) {
+        int value = 0;
+        in.read(value);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+    );
+};
+REGISTER_CLASS(TakeOne);
+
+void test_node_metrics() {
+    StreamGraph g;
+    g.set_name("test_node_metrics");
+    auto* producer = g.add_node<Producer>("producer");
+    auto* take = g.add_node<TakeOne>("take");
+    g.add_edge(producer->out, take->in);
+
+    NodeMetricsRef ref = MetricsRegistry::node("test_node_metrics", "producer", producer->type());
+    NodeMetrics* by_node = ref.by_node;
+    NodeMetrics* by_type = ref.by_type;
+    StreamMetrics* out = MetricsRegistry::stream("test_node_metrics", "producer/out", ref);
+    // 时延按秒采样，第一个采样点之前的数据取不到，先等一个采样周期
+    bthread_usleep(1200 * 1000);
+    {
+        BaseContext ctx;
+        BthreadExecutor executor;
+        assert(executor.run(g, ctx).ok());
+        // 计数和 backlog 立即可读
+        assert(by_node->exec.count() == 1 && by_node->launch_delay.count() == 1);
+        assert(by_node->first_output.count() == 1 && by_node->output_gap.count() == 2);
+        assert(by_node->elements.get_value() == 3);
+        assert(by_node->bytes.get_value() == 3 * (int64_t) sizeof(int));
+        assert(by_type->elements.get_value() == 3);
+        // 读走一个，还剩两个
+        assert(out->backlog.get_value() == 2);
+    }
+    // ctx 释放时流里剩下的元素从 backlog 里减掉
+    assert(out->backlog.get_value() == 0);
+
+    // 等采样线程取到这次执行
+    bthread_usleep(2200 * 1000);
+    printf("[ ] producer first_output %ldus exec %ldus\n",
+           by_node->first_output.max_latency(), by_node->exec.max_latency());
+    assert(by_node->first_output.max_latency() >= 2000);
+    assert(by_node->first_output.latency() >= 2000);
+    assert(by_node->exec.max_latency() >= 2000);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    test_node_metrics();
+    printf("[OK] test_node_metrics\n");
+    return 0;
+}
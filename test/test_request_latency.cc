@@ -0,0 +1,76 @@
+#include "include/stream-dag.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+class Tokens : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        for (int i = 0; i < 3; i++) {
+            out.append(i);
+            bthread_usleep(1000);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Tokens);
+
+void test_record() {
+    RequestLatency latency;
+    assert(latency.ttft_us() == -1 && latency.itl_percentile(0.5) == -1);
+    latency.admit(100);
+    // 只记第一次 admit
+    latency.admit(150);
+    latency.on_output(130);
+    latency.on_output(140);
+    latency.on_output(160);
+    latency.on_close(170);
+    latency.finish(200);
+    assert(latency.elements() == 3);
+    assert(latency.ttft_us() == 30);
+    assert((latency.itl() == std::vector<int64_t>{10, 20}));
+    assert(latency.itl_percentile(0.99) == 20);
+    // 有 sink 关闭时不用结束时间
+    assert(latency.total_us() == 70);
+
+    latency.reset();
+    assert(latency.elements() == 0 && latency.ttft_us() == -1);
+    assert(latency.itl().empty());
+    printf("[ ] record %s\n", latency.to_json().dump().c_str());
+}
+
+void test_reuse() {
+    StreamGraph g;
+    auto* tokens = g.add_node<Tokens>("tokens");
+    g.mark_sink(tokens->out);
+
+    ContextPool pool(g);
+    for (int round = 0; round < 2; round++) {
+        auto ctx = pool.acquire();
+        BthreadExecutor executor;
+        assert(executor.run(g, *ctx).ok());
+        // 复用的 ctx 不带上一个请求的元素和间隔
+        RequestLatency& latency = ctx->latency();
+        printf("[ ] reuse round %d %s\n", round, latency.to_json().dump().c_str());
+        assert(latency.elements() == 3);
+        assert(latency.itl().size() == 2);
+        assert(latency.ttft_us() >= 0);
+        for (int64_t gap : latency.itl()) {
+            assert(gap >= 1000);
+        }
+    }
+    assert(pool.to_json()["reused"] == 1);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    test_record();
+    test_reuse();
+    printf("[OK] test_request_latency\n");
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "include/stream-dag.h"
+#include "workers/source.h"
+#include "workers/safety.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+void test_automaton() {
+    AhoCorasick ac({"he", "she", "his", "hers", "违禁词"}, true);
+
+    std::vector<std::string> hits;
+    auto on_match = [&](int32_t id) { hits.push_back(ac.pattern(id)); return true; };
+
+    int32_t state = ac.scan(AhoCorasick::kRoot, "uSHErs", 6, on_match);
+    assert((hits == std::vector<std::string>{"she", "he", "hers"}));
+
+    // 跨元素匹配: "违禁词" 被切在 UTF-8 字符中间
+    hits.clear();
+    std::string text = "这是违禁词";
+    state = AhoCorasick::kRoot;
+    for (size_t pos = 0; pos < text.size(); pos += 4) {
+        std::string part = text.substr(pos, 4);
+        state = ac.scan(state, part.data(), part.size(), on_match);
+    }
+    assert((hits == std::vector<std::string>{"违禁词"}));
+    printf("[ ] test_automaton ok\n");
+}
+
+class TokenSource : public BaseNode {
+public:
+    Status run(Stream<LLMToken>& tokens) {
+        for (auto text : {"今天", "天气", "不错，违", "禁", "词出现了"}) {
+            tokens.append(LLMToken{text});
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS(
+        OUTPUT(tokens, Stream<LLMToken>)
+    )
+};
+REGISTER_CLASS(TokenSource);
+
+// 收集所有状态
+class StatusSinker : public BaseNode {
+public:
+    Status run(Stream<SafetyStatus>& result) {
+        SafetyStatus status;
+        while (result.read(status).ok()) {
+            printf("[ ] safety status %d safe_bytes %ld hit %s\n", status.status, status.safe_bytes, status.hit.c_str());
+            statuses_.push_back(status);
+        }
+        return Status::OK();
+    }
+
+    static std::vector<SafetyStatus> statuses_;
+
+    DECLARE_PARAMS(
+        INPUT(result, Stream<SafetyStatus>)
+    )
+};
+std::vector<SafetyStatus> StatusSinker::statuses_;
+REGISTER_CLASS(StatusSinker);
+
+static Status run_graph(const std::string& dictionary, Status* node_error) {
+    StreamGraph g;
+    TokenSource* source = g.add_node<TokenSource>("source");
+    StreamSafety* safety = g.add_node<StreamSafety>("safety");
+    StatusSinker* sinker = g.add_node<StatusSinker>("sinker");
+    safety->configure({{"dictionary", dictionary}});
+
+    g.add_edge(source->tokens, safety->tokens);
+    g.add_edge(safety->out, sinker->result);
+
+    StatusSinker::statuses_.clear();
+    BthreadExecutor executor;
+    BaseContext ctx;
+    Status status = executor.run(g, ctx);
+    *node_error = ctx.node_error();
+    return status;
+}
+
+void test_stream() {
+    Status node_error;
+    assert(run_graph("default", &node_error).ok() && node_error.ok());
+    auto& statuses = StatusSinker::statuses_;
+    // 每个 token 一个状态. "违" 和 "违禁" 可能是词的开头，扣住不放；命中后不再放行
+    //   "今天" 6 字节，"天气" 6 字节，"不错，" 9 字节
+    std::vector<int64_t> safe_bytes;
+    for (size_t i = 0; i + 1 < statuses.size(); i++) {
+        assert(statuses[i].status == 0);
+        safe_bytes.push_back(statuses[i].safe_bytes);
+    }
+    assert((safe_bytes == std::vector<int64_t>{6, 12, 21, 21}));
+    assert(statuses.back().status == SafetyStatus::kBlock && statuses.back().hit == "违禁词");
+}
+
+void test_missing_dictionary() {
+    // 词表不存在时不放行
+    Status node_error;
+    assert(run_graph("missing", &node_error).ok());
+    printf("[ ] missing dictionary %s\n", node_error.error_cstr());
+    assert(!node_error.ok());
+    auto& statuses = StatusSinker::statuses_;
+    assert(statuses.size() == 1 && statuses[0].status == SafetyStatus::kBlock);
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    test_automaton();
+
+    SafetyDictionary::update("default", {"违禁词", "blocked phrase"});
+    test_stream();
+    test_missing_dictionary();
+    printf("[OK] test_safety_matcher\n");
+    return 0;
+}
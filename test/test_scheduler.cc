@@ -0,0 +1,159 @@
+#include "include/stream-dag.h"
+#include <gflags/gflags.h>
+#include <cassert>
+#include <thread>
+
+using namespace stream_dag;
+
+static bthread::Mutex order_mutex;
+static std::vector<int> order;
+static std::vector<int64_t> deadlines;
+
+// 记下执行顺序，然后占着名额一段时间
+class Work : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        BaseContext& ctx = out.context();
+        {
+            std::unique_lock<bthread::Mutex> lock_(order_mutex);
+            order.push_back(ctx.priority());
+            deadlines.push_back(ctx.deadline_us());
+        }
+        // 被取消时提前退出
+        for (int i = 0; i < 10 && !ctx.is_cancelled(); i++) {
+            bthread_usleep(2000);
+        }
+        out.append(1);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Work);
+
+// 互相读对方的输出，谁也不写，只能靠关闭流唤醒. 不检查 is_cancelled
+class Reader : public BaseNode {
+public:
+    Status run(Stream<int>& in, Stream<int>& out) {
+        int value = 0;
+        if (in.read(value).ok()) {
+            out.append(value);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Reader);
+
+static Status run_request(StreamGraph& g, RequestPriority priority, int64_t deadline_us = 0, Status* node_error = nullptr) {
+    BaseContext ctx;
+    ctx.set_priority(priority);
+    ctx.set_deadline_us(deadline_us);
+    BthreadExecutor executor;
+    Status status = executor.run(g, ctx);
+    if (node_error) {
+        *node_error = ctx.node_error();
+    }
+    return status;
+}
+
+void test_priority() {
+    StreamGraph g;
+    g.add_node<Work>("work");
+    RequestScheduler::instance().set_max_running(1);
+    order.clear();
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] { assert(run_request(g, kPriorityNormal).ok()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    // 先到的离线任务排在后到的在线请求后面
+    for (auto priority : {kPriorityBatch, kPriorityBatch, kPriorityInteractive, kPriorityInteractive}) {
+        threads.emplace_back([&g, priority] { assert(run_request(g, priority).ok()); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    printf("[ ] %s\n", RequestScheduler::instance().inspect().dump().c_str());
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    printf("[ ] order");
+    for (int priority : order) {
+        printf(" %d", priority);
+    }
+    printf("\n");
+    assert(order == std::vector<int>({kPriorityNormal, kPriorityInteractive, kPriorityInteractive, kPriorityBatch, kPriorityBatch}));
+    RequestScheduler::instance().set_max_running(0);
+}
+
+void test_deadline() {
+    StreamGraph g;
+    g.add_node<Work>("work");
+    RequestScheduler::instance().set_max_running(1);
+    order.clear();
+    deadlines.clear();
+
+    std::vector<std::thread> threads;
+    std::atomic<int> expired{0};
+    threads.emplace_back([&] { assert(run_request(g, kPriorityNormal).ok()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int64_t now = butil::gettimeofday_us();
+    // 同一优先级按截止时间放行. 第一个在排队时就过了截止时间
+    for (int64_t deadline_ms : {5, 300, 200}) {
+        threads.emplace_back([&g, &expired, deadline_ms, now] {
+            Status status = run_request(g, kPriorityBatch, now + deadline_ms * 1000);
+            if (!status.ok()) {
+                printf("[ ] %s\n", status.error_cstr());
+                expired++;
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    assert(expired == 1);
+    assert(deadlines == std::vector<int64_t>({0, now + 200000, now + 300000}));
+    RequestScheduler::instance().set_max_running(0);
+
+    // 执行中过了截止时间，节点被取消
+    Status node_error;
+    int64_t start = butil::gettimeofday_us();
+    assert(run_request(g, kPriorityInteractive, start + 3000, &node_error).ok());
+    int64_t cost = butil::gettimeofday_us() - start;
+    printf("[ ] cancelled after %ldus: %s\n", cost, node_error.error_cstr());
+    assert(!node_error.ok() && cost < 15000);
+}
+
+// 阻塞在 read 上的节点过了截止时间也会退出，不用等执行器超时
+void test_deadline_blocked() {
+    StreamGraph g;
+    auto* ping = g.add_node<Reader>("ping");
+    auto* pong = g.add_node<Reader>("pong");
+    g.add_edge(ping->out, pong->in);
+    g.add_edge(pong->out, ping->in);
+
+    BaseContext ctx;
+    ctx.set_deadline_us(butil::gettimeofday_us() + 3000);
+    BthreadExecutor executor;
+    // 没有取消时会在这里超时
+    executor.set_timeout_ms(10000);
+    Status status = executor.run(g, ctx);
+    printf("[ ] blocked reader: %s, %s\n", status.error_cstr(), ctx.node_error().error_cstr());
+    assert(status.ok());
+    assert(!ctx.node_error().ok());
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_priority();
+    test_deadline();
+    test_deadline_blocked();
+    printf("[OK] test_scheduler\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "include/stream-dag.h"
+#include "include/sse.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+// 模拟 HttpNode 的 stream_body：事件故意在任意位置被切开
+class ChunkSource : public BaseNode {
+public:
+    Status run(ByteStream& body) {
+        std::string raw =
+            "data:{\"token\":{\"id\":1,\"text\":\"你\",\"special\":false},\"generated_text\":null}\n\n"
+            ": keep-alive\r\n\r\n"
+            "data: {\"choices\":[{\"delta\":{\"content\":\"好\"},\"finish_reason\":null}]}\r\n\r\n"
+            "event: message\n"
+            "data:{\"token\":{\"id\":2,\"text\":\"!\",\"special\":false},\"generated_text\":\"你好!\"}\n\n"
+            "data: [DONE]";
+        for (size_t pos = 0; pos < raw.size(); pos += 7) {
+            body.append(raw.substr(pos, 7));
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(body, ByteStream),
+    );
+};
+REGISTER_CLASS(ChunkSource);
+
+class TokenSinker : public BaseNode {
+public:
+    Status run(Stream<LLMToken>& tokens) {
+        std::vector<LLMToken> result;
+        while (tokens.readable()) {
+            LLMToken token;
+            if (!tokens.read(token).ok()) {
+                break;
+            }
+            printf("[ ] token %s\n", token.to_json().dump().c_str());
+            result.push_back(token);
+        }
+        assert(result.size() == 3);
+        assert(result[0].text == "你");
+        assert(result[1].text == "好");
+        assert(result[2].text == "!" && result[2].finished);
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(tokens, Stream<LLMToken>),
+    );
+};
+REGISTER_CLASS(TokenSinker);
+
+void test_parser() {
+    SseParser parser;
+    std::vector<SseEvent> events;
+    auto on_event = [&](SseEvent& event) { events.push_back(event); };
+
+    // '\r\n' 被拆在两个 chunk 里；多行 data 用 '\n' 拼接
+    parser.feed("data: a\r", 8, on_event);
+    parser.feed("\ndata: b\r\n\r\n", 12, on_event);
+    parser.feed("id: 7\ndata:c\n", 13, on_event);
+    parser.finish(on_event);
+
+    assert(events.size() == 2);
+    assert(events[0].data == "a\nb");
+    assert(events[1].data == "c" && events[1].id == "7");
+    printf("[ ] test_parser ok\n");
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    test_parser();
+
+    StreamGraph g;
+    ChunkSource* source = g.add_node<ChunkSource>("source");
+    SseParserNode* parser = g.add_node<SseParserNode>("sse_parser");
+    TokenSinker* sinker = g.add_node<TokenSinker>("sinker");
+
+    g.add_edge(source->body, parser->body);
+    g.add_edge(parser->tokens, sinker->tokens);
+
+    BthreadExecutor executor;
+    BaseContext ctx;
+    auto status = executor.run(g, ctx);
+    if (!status.ok()) {
+        printf("run err: %s\n", status.error_cstr());
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "include/stream-dag.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+// 在 BlockedScope 里一直等到请求被取消. external 为 true 时模拟一次不返回的 RPC
+class Hang : public BaseNode {
+public:
+    Status run(Stream<int>& out) {
+        static const std::string what = "http://hang";
+        BlockedScope blocked(what, true, option().value("external", false));
+        while (!out.context().is_cancelled()) {
+            bthread_usleep(1000);
+        }
+        return Status(-1, "cancelled");
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(out, Stream<int>),
+    );
+};
+REGISTER_CLASS(Hang);
+
+class Reader : public BaseNode {
+public:
+    Status run(Stream<int>& in) {
+        int value = 0;
+        while (in.read(value).ok()) {
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(in, Stream<int>),
+    );
+};
+REGISTER_CLASS(Reader);
+
+// 请求挂住后检测一次，返回死锁判断和卡死的请求数. 检测时取消请求，run 随后返回
+static int run_hang(bool external, bool* deadlocked) {
+    StreamGraph g;
+    g.set_name("test_stall_detector");
+    auto* hang = g.add_node<Hang>("hang");
+    auto* reader = g.add_node<Reader>("reader");
+    hang->configure({{"external", external}});
+    g.add_edge(hang->out, reader->in);
+
+    BaseContext ctx;
+    Status status;
+    BThread runner([&] {
+        BthreadExecutor executor;
+        status = executor.run(g, ctx);
+    });
+    bthread_usleep(50 * 1000);
+
+    int requests = 0;
+    InflightRegistry::for_each([&](InflightRequest& request) {
+        requests += 1;
+        *deadlocked = request.deadlocked();
+    });
+    assert(requests == 1);
+
+    StallOptions options;
+    options.threshold_ms = 20;
+    options.cancel = true;
+    int stalled = StallDetector::check(options);
+    runner.join();
+    // 节点的失败记在 ctx 上
+    assert(status.ok() && ctx.is_cancelled() && !ctx.node_error().ok());
+    printf("[ ] external %d stalled %d deadlocked %d: %s\n", external, stalled, *deadlocked, ctx.node_error().error_cstr());
+    return stalled;
+}
+
+// 两个节点都在等图里的流，判为死锁；检测到卡死并取消
+void test_deadlock() {
+    bool deadlocked = false;
+    assert(run_hang(false, &deadlocked) == 1);
+    assert(deadlocked);
+}
+
+// 上游在等外部 IO，不是死锁，但阻塞超过阈值仍然算卡死并取消
+void test_external() {
+    bool deadlocked = true;
+    assert(run_hang(true, &deadlocked) == 1);
+    assert(!deadlocked);
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_deadlock();
+    test_external();
+    assert(InflightRegistry::dump().empty());
+    printf("[OK] test_stall_detector\n");
+    return 0;
+}
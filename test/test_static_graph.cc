@@ -0,0 +1,118 @@
+#include "include/stream-dag.h"
+#include "include/static_graph.h"
+#include <gflags/gflags.h>
+#include <cassert>
+
+using namespace stream_dag;
+
+class Numbers : public BaseNode {
+public:
+    Status run(Stream<int>& numbers) {
+        for (int i = 1; i <= 5; i++) {
+            numbers.append(i);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        OUTPUT(numbers, Stream<int>),
+    );
+};
+
+// 两路输入相加. 第二路由调用方在执行前写入
+class Add : public BaseNode {
+public:
+    Status run(Stream<int>& left, Stream<int>& right, Stream<int>& sum) {
+        int a = 0, b = 0;
+        while (left.read(a).ok()) {
+            if (!right.read(b).ok()) {
+                b = 0;
+            }
+            sum.append(a + b);
+        }
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(left, Stream<int>),
+        INPUT(right, Stream<int>),
+        OUTPUT(sum, Stream<int>),
+    );
+};
+
+class Collect : public BaseNode {
+public:
+    Status run(Stream<int>& values, Stream<std::string>& text) {
+        std::string result;
+        int value = 0;
+        while (values.read(value).ok()) {
+            result += std::to_string(value) + ",";
+        }
+        text.append(result);
+        return result.empty() ? Status(-1, "no input") : Status::OK();
+    }
+
+    DECLARE_PARAMS (
+        INPUT(values, Stream<int>),
+        OUTPUT(text, Stream<std::string>),
+    );
+};
+
+using Graph = StaticGraph<
+    Nodes<Numbers, Add, Collect>,
+    Edge<0, Numbers::ports::numbers, 1, Add::ports::left>,
+    Edge<1, Add::ports::sum, 2, Collect::ports::values>,
+    Sink<2, Collect::ports::text>>;
+
+// 以下连法都在编译期报错
+// Edge<0, Numbers::ports::numbers, 2, Collect::ports::text>      终点不是 INPUT
+// Edge<2, Collect::ports::text, 1, Add::ports::right>            流类型不一致
+// Edge<0, Numbers::ports::numbers, 1, Add::ports::left> 写两次      一个输入连了两条边
+
+void test_run() {
+    Graph g({"numbers", "add", "collect"});
+    g.set_name("test_static_graph");
+    for (int round = 0; round < 3; round++) {
+        BaseContext ctx;
+        Graph::Streams streams(ctx, g);
+        auto& right = streams.get<1, Add::ports::right>();
+        for (int i = 0; i < 3; i++) {
+            right.append(10);
+        }
+        Status status = g.run(ctx, streams);
+        assert(status.ok());
+
+        std::string text;
+        auto& output = streams.get<2, Collect::ports::text>();
+        assert(output.read(text).ok());
+        printf("[ ] round %d %s\n", round, text.c_str());
+        assert(text == "11,12,13,4,5,");
+        assert(ctx.latency().elements() == 1);
+        // 输入端口和上游输出端口是同一个流
+        auto& left = streams.get<1, Add::ports::left>();
+        auto& numbers = streams.get<0, Numbers::ports::numbers>();
+        assert(&left == &numbers);
+    }
+}
+
+// 节点失败时 run 返回它的状态
+using EmptyGraph = StaticGraph<Nodes<Collect>>;
+
+void test_error() {
+    EmptyGraph g;
+    BaseContext ctx;
+    EmptyGraph::Streams streams(ctx, g);
+    Status status = g.run(ctx, streams);
+    assert(!status.ok());
+    assert(streams.status(0).error_code() == -1);
+    printf("[ ] error %s\n", status.error_cstr());
+}
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    MetricsRegistry::enable(false);
+    test_run();
+    test_error();
+    printf("[OK] test_static_graph\n");
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**********
+ * JSON 图和二进制图互转
+ *   xmake run graph_convert --input=graph.json --output=graph.sdag
+ *   xmake run graph_convert --input=graph.sdag --output=graph.json
+ * 转成二进制时要创建节点来确定端口下标，图里用到的节点类型都要链接进来
+ * **********
+*/
+#include "include/stream-dag.h"
+#include "include/graph_binary.h"
+#include "include/http.h"
+#include "include/sse.h"
+
+#include "source.h"
+#include "safety.h"
+#include "llm_model.h"
+#include "output.h"
+
+#include <gflags/gflags.h>
+#include <fstream>
+#include <sstream>
+
+DEFINE_string(input, "", "输入文件，按内容判断是 JSON 还是二进制");
+DEFINE_string(output, "", "输出文件");
+DEFINE_bool(verify, true, "转成二进制后加载一遍并校验，确认节点类型、端口和边都能对上");
+
+using namespace stream_dag;
+
+int main(int argc, char* argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    if (FLAGS_input.empty() || FLAGS_output.empty()) {
+        printf("usage: graph_convert --input=<file> --output=<file>\n");
+        return -1;
+    }
+
+    std::ifstream in(FLAGS_input, std::ios::binary);
+    if (!in.is_open()) {
+        printf("open %s failed\n", FLAGS_input.c_str());
+        return -1;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string input = buffer.str();
+
+    std::string output;
+    if (GraphBinary::is_binary(input.data(), input.size())) {
+        json graph;
+        Status status = GraphBinary::to_json(input.data(), input.size(), &graph);
+        if (!status.ok()) {
+            printf("%s\n", status.error_cstr());
+            return -1;
+        }
+        output = graph.dump(4);
+    } else {
+        json graph = json::parse(input, nullptr, false);
+        if (graph.is_discarded()) {
+            printf("%s is neither json nor graph binary\n", FLAGS_input.c_str());
+            return -1;
+        }
+        Status status = GraphBinary::from_json(graph, &output);
+        if (status.ok() && FLAGS_verify) {
+            StreamGraph g;
+            status = GraphBinary::load(g, output.data(), output.size());
+            if (status.ok()) {
+                // 只校验，不删节点
+                status = g.finalize(GraphOptimizeOptions{false, false});
+            }
+        }
+        if (!status.ok()) {
+            printf("%s\n", status.error_cstr());
+            return -1;
+        }
+    }
+
+    std::ofstream out(FLAGS_output, std::ios::binary);
+    out.write(output.data(), output.size());
+    if (!out.good()) {
+        printf("write %s failed\n", FLAGS_output.c_str());
+        return -1;
+    }
+    printf("%s -> %s, %zu bytes\n", FLAGS_input.c_str(), FLAGS_output.c_str(), output.size());
+    return 0;
+}
@@ -34,9 +34,8 @@ public:
         subscription_key_ = option.value("subscription_key", "");
 
         json& http_node_option = option["http_node"];
-        http_node_ = new HttpNode("http_node", "HttpNode");
-        http_node_->init(http_node_option);
-        return Status::OK();
+        http_node_ = std::make_unique<HttpNode>("http_node", "HttpNode");
+        return http_node_->configure(http_node_option);
     }
 
     Status run(Stream<BingRequest>& bing_request_, Stream<BingResponse>& bing_response_) {
@@ -58,7 +57,7 @@ public:
         BaseContext ctx;
         Stream<HttpRequest> http_req_stream(ctx, "http_req_stream", "HttpRequest");
         Stream<HttpResponse> http_rsp_stream(ctx, "http_rsp_stream", "HttpResponse");
-        Stream<std::string> http_rsp_body(ctx, "http_rsp_body", "HttpResponseBody");
+        ByteStream http_rsp_body(ctx, "http_rsp_body", "HttpResponseBody");
         http_req_stream.append(http_req);
         http_node_->run(http_req_stream, http_rsp_stream, http_rsp_body);
         http_rsp_stream.read(http_rsp);
@@ -77,7 +76,7 @@ public:
     );
 
 private:
-    HttpNode* http_node_ = nullptr;
+    std::unique_ptr<HttpNode> http_node_;
     std::string subscription_key_;
 };
 REGISTER_CLASS(BingNode);
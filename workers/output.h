@@ -1,5 +1,6 @@
 #pragma once
 #include "stream-dag.h"
+#include "coalesce.h"
 #include <tuple>
 using namespace stream_dag;
 
@@ -15,6 +16,14 @@ public:
     }
 };
 
+namespace stream_dag {
+template<>
+struct coalesce_traits<Response> {
+    static size_t size(const Response& value) { return value.data_.size(); }
+    static void merge(Response& to, Response&& from) { to.data_ += from.data_; }
+};
+}
+
 
 
 
@@ -63,3 +72,7 @@ public:
     );
 };
 REGISTER_CLASS(OutputNode);
+
+// 合并 OutputNode 的逐 token 输出，减少下游的写次数
+using ResponseCoalesce = CoalesceNode<Response>;
+REGISTER_CLASS(ResponseCoalesce);
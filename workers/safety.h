@@ -1,6 +1,8 @@
 
 #pragma once
 #include "stream-dag.h"
+#include "sse.h"
+#include "aho_corasick.h"
 
 using namespace stream_dag;
 
@@ -10,6 +12,9 @@ using namespace stream_dag;
 class SafetyStatus {
 public:
     int status = 0;
+    std::string hit; // 命中的词
+    // StreamSafety 用: token 文本拼起来之后前面这么多字节已经确认安全，可以放给下游
+    int64_t safe_bytes = 0;
 
     static const int kBlock = -1;
     json to_json() {
@@ -34,3 +39,59 @@ public:
 };
 
 REGISTER_CLASS(PreSafety);
+
+
+// 流式安全检查. 在模型输出的 token 流上做多模式匹配，词可以跨 token
+//   每个 token 输出一个通过状态，safe_bytes 只扣住末尾可能是某个词开头的 depth(state) 个字节，
+//   下游按 safe_bytes 放出 token，不用等整个生成结束. 命中时输出一个 kBlock 并结束；流结束时 safe_bytes 为全部字节
+//   词表来自 SafetyDictionary，请求开始时取快照，热更新只影响之后的请求. 词表不存在时输出 kBlock 并返回错误
+// 配置:
+//   dictionary: 词表名
+class StreamSafety : public BaseNode {
+public:
+    Status init(json& option) {
+        dictionary_ = option.value("dictionary", "default");
+        return Status::OK();
+    }
+
+    Status run(Stream<LLMToken>& tokens, Stream<SafetyStatus>& out) {
+        std::shared_ptr<const AhoCorasick> automaton = SafetyDictionary::get(dictionary_);
+        if (automaton == nullptr) {
+            // 检查不了就不放行
+            out.append(SafetyStatus{SafetyStatus::kBlock});
+            return Status(-1, "safety dictionary %s not found", dictionary_.c_str());
+        }
+        int32_t state = AhoCorasick::kRoot;
+        int64_t total_bytes = 0;
+        while (tokens.readable()) {
+            LLMToken token;
+            Status status = tokens.read(token);
+            if (!status.ok()) {
+                break;
+            }
+            int32_t hit = -1;
+            state = automaton->scan(state, token.text.data(), token.text.size(), [&](int32_t id) {
+                hit = id;
+                return false;
+            });
+            if (hit >= 0) {
+                out.append(SafetyStatus{SafetyStatus::kBlock, automaton->pattern(hit)});
+                return Status::OK();
+            }
+            total_bytes += token.text.size();
+            out.append(SafetyStatus{0, "", total_bytes - automaton->depth(state)});
+        }
+        out.append(SafetyStatus{0, "", total_bytes});
+        return Status::OK();
+    }
+
+    DECLARE_PARAMS(
+        INPUT(tokens, Stream<LLMToken>),
+        OUTPUT(out, Stream<SafetyStatus>)
+    )
+
+private:
+    std::string dictionary_ = "default";
+};
+
+REGISTER_CLASS(StreamSafety);
@@ -4,6 +4,7 @@ add_rules("mode.debug")
 set_languages("c++17")
 
 add_requires("protobuf-cpp", "gflags", "brpc", "glog", "pybind11")
+add_requires("benchmark")
 
 target("dag-demo")
     set_kind("binary")
@@ -12,6 +13,7 @@ target("dag-demo")
     add_packages("protobuf-cpp")
     add_packages("brpc")
     add_rules("c++")
+    add_includedirs(".")
     add_includedirs("include")
     add_includedirs("workers")
     -- add_files("workers/*.cc")
@@ -110,4 +112,260 @@ target("chat")
     add_packages("protobuf-cpp")
     add_packages("brpc")
     add_rules("c++")
-    add_files("ChatLogic.cc")
\ No newline at end of file
+    add_files("ChatLogic.cc")
+
+target("test_sse_parser")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_files("test/test_sse_parser.cc")
+
+target("test_coalesce")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_includedirs("workers")
+    add_files("test/test_coalesce.cc")
+
+target("test_safety_matcher")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_safety_matcher.cc")
+
+target("test_context_pool")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_context_pool.cc")
+
+target("test_request_latency")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_request_latency.cc")
+
+target("test_node_metrics")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_node_metrics.cc")
+
+target("test_stall_detector")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_stall_detector.cc")
+
+target("test_static_graph")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_static_graph.cc")
+
+target("test_graph_binary")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_graph_binary.cc")
+
+target("test_graph_optimize")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_graph_optimize.cc")
+
+target("test_convertor")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_convertor.cc")
+
+target("test_graph_registry")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_graph_registry.cc")
+
+target("test_fan_out")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_fan_out.cc")
+
+target("test_node_call")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_node_call.cc")
+
+target("test_actor")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_actor.cc")
+
+target("test_node_exec")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_node_exec.cc")
+
+target("test_scheduler")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("test/test_scheduler.cc")
+
+-- xmake run graph_convert --input=graph.json --output=graph.sdag
+target("graph_convert")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_includedirs("workers")
+    add_files("tools/graph_convert.cc")
+
+-- xmake run micro_benchmark --benchmark_format=json --benchmark_out=micro.json
+target("micro_benchmark")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_packages("benchmark")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("bench/micro_benchmark.cc")
+
+-- xmake run graph_benchmark --node_counts=50,100,200,500 --concurrency_list=4,8,16
+target("graph_benchmark")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("bench/graph_benchmark.cc")
+
+-- 模拟模型服务，见 bench/mock_llm_server.h
+target("mock_llm_server")
+    set_kind("binary")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_rules("protobuf.cpp")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("bench/mock_llm.proto", {proto_rootdir = "bench"})
+    add_files("bench/mock_llm_server.cc")
+
+-- xmake run http_benchmark --mode=graph --qps=200
+target("http_benchmark")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_packages("gflags")
+    add_packages("glog")
+    add_packages("protobuf-cpp")
+    add_packages("brpc")
+    add_rules("c++")
+    add_rules("protobuf.cpp")
+    add_includedirs(".")
+    add_includedirs("include")
+    add_files("bench/mock_llm.proto", {proto_rootdir = "bench"})
+    add_files("bench/http_benchmark.cc")